@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+// Builtins to load with "enable -f libExampleBuiltins.so kvget counter", which save
+// running a utility for what's often done in a loop:
+//
+//   kvget FILE KEY [NAME]     Sets NAME (or KEY) to the value of the first "KEY=value"
+//                             line in FILE. Returns 1 if there's none.
+//   counter NAME [AMOUNT]     Adds AMOUNT (or 1) to the number in NAME, where unset
+//                             counts as 0.
+
+#include <BuiltinABI.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int kvget(struct ratsh_builtin_context const* context, int argc, char const* const* argv)
+{
+    if (argc < 3 || argc > 4) {
+        dprintf(context->stderr_fd, "kvget: usage: kvget FILE KEY [NAME]\n");
+        return 2;
+    }
+
+    FILE* file = fopen(argv[1], "re");
+    if (file == NULL) {
+        dprintf(context->stderr_fd, "kvget: %s: %s\n", argv[1], strerror(errno));
+        return 2;
+    }
+
+    size_t key_length = strlen(argv[2]);
+    char* line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    int rc = 1;
+
+    while ((length = getline(&line, &capacity, file)) >= 0) {
+        if ((size_t)length <= key_length || strncmp(line, argv[2], key_length) != 0 || line[key_length] != '=')
+            continue;
+        if (line[length - 1] == '\n')
+            line[length - 1] = '\0';
+
+        char const* name = argc == 4 ? argv[3] : argv[2];
+        if (context->set_variable(context->shell, name, line + key_length + 1) < 0) {
+            dprintf(context->stderr_fd, "kvget: %s: not a valid identifier\n", name);
+            rc = 2;
+        } else {
+            rc = 0;
+        }
+        break;
+    }
+
+    free(line);
+    fclose(file);
+    return rc;
+}
+
+static int counter(struct ratsh_builtin_context const* context, int argc, char const* const* argv)
+{
+    if (argc < 2 || argc > 3) {
+        dprintf(context->stderr_fd, "counter: usage: counter NAME [AMOUNT]\n");
+        return 2;
+    }
+
+    char const* value = context->get_variable(context->shell, argv[1]);
+    int64_t total = value != NULL ? strtoll(value, NULL, 10) : 0;
+    total += argc == 3 ? strtoll(argv[2], NULL, 10) : 1;
+
+    char text[32];
+    snprintf(text, sizeof(text), "%" PRId64, total);
+    if (context->set_variable(context->shell, argv[1], text) < 0) {
+        dprintf(context->stderr_fd, "counter: %s: not a valid identifier\n", argv[1]);
+        return 2;
+    }
+    return 0;
+}
+
+static struct ratsh_builtin const builtins[] = {
+    { .name = "kvget", .function = kvget },
+    { .name = "counter", .function = counter },
+};
+
+struct ratsh_builtin_table const ratsh_builtins = {
+    .abi_version = RATSH_BUILTIN_ABI_VERSION,
+    .count = sizeof(builtins) / sizeof(builtins[0]),
+    .builtins = builtins,
+};
@@ -20,7 +20,11 @@ std::shared_ptr<Value> SyntaxError::eval() const
 std::shared_ptr<Value> Execute::eval() const
 {
     auto command = std::make_shared<CommandValue>();
+    command->assignments = assignments();
     command->argv = argv();
+    command->line = line();
+    for (auto const& [index, node] : process_substitutions())
+        command->process_substitutions.emplace_back(index, std::static_pointer_cast<ProcessSubstitutionValue>(node->eval()));
     return command;
 }
 
@@ -43,7 +47,11 @@ std::shared_ptr<Value> PathRedirection::eval() const
         break;
     }
 
-    auto path_data = RedirectionValue::PathData { .path = path(), .flags = open_flags };
+    std::shared_ptr<ProcessSubstitutionValue> substitution;
+    if (process_substitution())
+        substitution = std::static_pointer_cast<ProcessSubstitutionValue>(process_substitution()->eval());
+
+    auto path_data = RedirectionValue::PathData { .path = path(), .flags = open_flags, .process_substitution = std::move(substitution) };
     return std::make_shared<RedirectionValue>(fd(), path_data);
 }
 
@@ -61,18 +69,22 @@ std::shared_ptr<Value> DupRedirection::eval() const
 
 std::shared_ptr<Value> Pipeline::eval() const
 {
-    auto left = m_left->eval();
-    assert(left->is_command());
-
-    auto cmd = std::static_pointer_cast<CommandValue>(left);
-
-    auto right = m_right->eval();
-    assert(right->is_command());
-
-    auto right_cmd = std::static_pointer_cast<CommandValue>(right);
-    cmd->next_in_pipeline = right_cmd;
+    std::shared_ptr<CommandValue> first;
+    std::shared_ptr<CommandValue> last;
+
+    for (auto const& stage : stages()) {
+        auto value = stage->eval();
+        assert(value->is_command());
+
+        auto cmd = std::static_pointer_cast<CommandValue>(value);
+        if (last)
+            last->next_in_pipeline = cmd;
+        else
+            first = cmd;
+        last = std::move(cmd);
+    }
 
-    return cmd;
+    return first;
 }
 
 std::shared_ptr<Value> ConcatenateListToCommand::eval() const
@@ -84,7 +96,10 @@ std::shared_ptr<Value> ConcatenateListToCommand::eval() const
 
         if (value->is_command()) {
             auto other_command = static_pointer_cast<CommandValue>(value);
+            command->assignments = move(other_command->assignments);
             command->argv = move(other_command->argv);
+            command->process_substitutions = move(other_command->process_substitutions);
+            command->line = other_command->line;
         }
         if (value->is_redirection()) {
             auto redirection = static_pointer_cast<RedirectionValue>(value);
@@ -95,27 +110,99 @@ std::shared_ptr<Value> ConcatenateListToCommand::eval() const
     return command;
 }
 
-std::shared_ptr<Value> AndOrIf::eval() const
+std::shared_ptr<Value> CompoundCommand::eval() const
 {
-    auto and_or = std::make_shared<AndOrListValue>();
+    auto command = std::make_shared<CommandValue>();
+    command->compound = m_body->eval();
+    command->line = line();
+
+    for (auto const& node : redirections()) {
+        auto value = node->eval();
+        assert(value->is_redirection());
+        command->redirections.push_back(static_pointer_cast<RedirectionValue>(value));
+    }
 
-    auto left = m_left->eval();
-    assert(left->is_command());
+    return command;
+}
+
+std::shared_ptr<Value> Subshell::eval() const
+{
+    auto subshell = std::make_shared<SubshellValue>();
+    subshell->body = m_body->eval();
+    return subshell;
+}
+
+std::shared_ptr<Value> ProcessSubstitution::eval() const
+{
+    auto substitution = std::make_shared<ProcessSubstitutionValue>();
+    substitution->direction = m_direction;
+    substitution->body = m_body->eval();
+    return substitution;
+}
+
+std::shared_ptr<Value> BraceGroup::eval() const
+{
+    auto group = std::make_shared<BraceGroupValue>();
+    group->body = m_body->eval();
+    return group;
+}
 
-    auto cmd = std::static_pointer_cast<CommandValue>(left);
-    cmd->op = m_type == Type::AndIf ? CommandValue::WithOp::AndIf : CommandValue::WithOp::OrIf;
-    and_or->commands.push_back(cmd);
+std::shared_ptr<Value> FunctionDefinition::eval() const
+{
+    auto body = m_body->eval();
+    assert(body->is_command());
+
+    auto definition = std::make_shared<FunctionDefinitionValue>();
+    definition->name = name();
+    definition->body = std::static_pointer_cast<CommandValue>(body);
+
+    auto command = std::make_shared<CommandValue>();
+    command->compound = definition;
+    return command;
+}
+
+std::shared_ptr<Value> ForLoop::eval() const
+{
+    auto loop = std::make_shared<ForLoopValue>();
+    loop->name = name();
+    loop->words = words();
+    loop->body = m_body->eval();
+    return loop;
+}
+
+std::shared_ptr<Value> WhileLoop::eval() const
+{
+    auto loop = std::make_shared<WhileLoopValue>();
+    loop->condition = m_condition->eval();
+    loop->body = m_body->eval();
+    loop->is_until = type() == Type::Until;
+    return loop;
+}
+
+std::shared_ptr<Value> List::eval() const
+{
+    auto list = std::make_shared<ListValue>();
+
+    for (auto const& node : nodes())
+        list->items.push_back(node->eval());
+
+    return list;
+}
+
+std::shared_ptr<Value> AndOrIf::eval() const
+{
+    auto and_or = std::make_shared<AndOrListValue>();
+    and_or->commands.reserve(commands().size());
 
-    auto right = m_right->eval();
-    assert(right->is_command() || right->is_and_or_list());
+    for (size_t i = 0; i < commands().size(); i++) {
+        auto value = commands()[i]->eval();
+        assert(value->is_command());
 
-    if (right->is_command()) {
-        auto right_cmd = std::static_pointer_cast<CommandValue>(right);
-        and_or->commands.push_back(right_cmd);
-    } else {
-        auto other_and_or = std::static_pointer_cast<AndOrListValue>(right);
-        auto& other_cmds = other_and_or->commands;
-        and_or->commands.insert(and_or->commands.end(), other_cmds.begin(), other_cmds.end());
+        // Each command carries the operator that follows it.
+        auto cmd = std::static_pointer_cast<CommandValue>(value);
+        if (i < operators().size())
+            cmd->op = operators()[i] == Type::AndIf ? CommandValue::WithOp::AndIf : CommandValue::WithOp::OrIf;
+        and_or->commands.push_back(std::move(cmd));
     }
 
     return and_or;
@@ -10,6 +10,7 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace RatShell::AST {
@@ -18,11 +19,19 @@ class Node {
 public:
     enum class Kind {
         AndOrIf,
+        BraceGroup,
+        CompoundCommand,
         DupRedirection,
         Execute,
+        ForLoop,
+        FunctionDefinition,
+        List,
         PathRedirection,
         Pipeline,
+        ProcessSubstitution,
+        Subshell,
         SyntaxError,
+        WhileLoop,
 
         // The following are considered "convenience" nodes.
         ConcatenateListToCommand
@@ -38,8 +47,9 @@ public:
 
 class SyntaxError final : public Node {
 public:
-    SyntaxError(std::string error_message)
+    SyntaxError(std::string error_message, size_t line = 0)
         : m_error_message(std::move(error_message))
+        , m_line(line)
     {
     }
 
@@ -49,15 +59,22 @@ public:
     virtual bool is_syntax_error() const override { return true; };
 
     std::string const& error_message() const { return m_error_message; }
+    // The line the error was found on, counting from 1, or 0 if it isn't known.
+    size_t line() const { return m_line; }
 
 private:
     std::string m_error_message;
+    size_t m_line { 0 };
 };
 
 class Execute final : public Node {
 public:
-    Execute(std::vector<std::string> argv)
-        : m_argv(std::move(argv))
+    // The words of argv at the positions of the process substitutions are left empty.
+    Execute(std::vector<std::string> assignments, std::vector<std::string> argv, size_t line = 0, std::vector<std::pair<size_t, std::shared_ptr<Node>>> process_substitutions = {})
+        : m_assignments(std::move(assignments))
+        , m_argv(std::move(argv))
+        , m_line(line)
+        , m_process_substitutions(std::move(process_substitutions))
     {
     }
 
@@ -66,10 +83,16 @@ public:
     virtual std::shared_ptr<Value> eval() const override;
     virtual Kind kind() const override { return Kind::Execute; }
 
+    std::vector<std::string> const& assignments() const { return m_assignments; }
     std::vector<std::string> const& argv() const { return m_argv; }
+    size_t line() const { return m_line; }
+    std::vector<std::pair<size_t, std::shared_ptr<Node>>> const& process_substitutions() const { return m_process_substitutions; }
 
 private:
+    std::vector<std::string> m_assignments;
     std::vector<std::string> m_argv;
+    size_t m_line { 0 };
+    std::vector<std::pair<size_t, std::shared_ptr<Node>>> m_process_substitutions;
 };
 
 class PathRedirection final : public Node {
@@ -81,10 +104,11 @@ public:
         WriteAppend
     };
 
-    PathRedirection(std::string path, int fd, Flags flag)
+    PathRedirection(std::string path, int fd, Flags flag, std::shared_ptr<Node> process_substitution = nullptr)
         : m_path(std::move(path))
         , m_fd(fd)
         , m_flags(flag)
+        , m_process_substitution(std::move(process_substitution))
     {
     }
 
@@ -96,11 +120,14 @@ public:
     std::string const& path() const { return m_path; }
     int fd() const { return m_fd; }
     Flags flags() const { return m_flags; }
+    // Set when the target is a process substitution rather than a path.
+    std::shared_ptr<Node> const& process_substitution() const { return m_process_substitution; }
 
 private:
     std::string m_path;
     int m_fd { -1 };
     Flags m_flags;
+    std::shared_ptr<Node> m_process_substitution;
 };
 
 class DupRedirection final : public Node {
@@ -134,9 +161,8 @@ private:
 
 class Pipeline final : public Node {
 public:
-    Pipeline(std::shared_ptr<AST::Node> left, std::shared_ptr<AST::Node> right)
-        : m_left(std::move(left))
-        , m_right(std::move(right))
+    Pipeline(std::vector<std::shared_ptr<AST::Node>> stages)
+        : m_stages(std::move(stages))
     {
     }
 
@@ -145,12 +171,10 @@ public:
     virtual std::shared_ptr<Value> eval() const override;
     virtual Kind kind() const override { return Kind::Pipeline; }
 
-    std::shared_ptr<AST::Node> const& left() { return m_left; }
-    std::shared_ptr<AST::Node> const& right() { return m_right; }
+    std::vector<std::shared_ptr<AST::Node>> const& stages() const { return m_stages; }
 
 private:
-    std::shared_ptr<AST::Node> m_left;
-    std::shared_ptr<AST::Node> m_right;
+    std::vector<std::shared_ptr<AST::Node>> m_stages;
 };
 
 class ConcatenateListToCommand final : public Node {
@@ -169,6 +193,165 @@ private:
     std::vector<std::shared_ptr<AST::Node>> m_nodes;
 };
 
+// A compound command together with the redirections that apply to all of it.
+class CompoundCommand final : public Node {
+public:
+    CompoundCommand(std::shared_ptr<AST::Node> body, std::vector<std::shared_ptr<AST::Node>> redirections, size_t line = 0)
+        : m_body(std::move(body))
+        , m_redirections(std::move(redirections))
+        , m_line(line)
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::CompoundCommand; }
+
+    std::shared_ptr<AST::Node> const& body() const { return m_body; }
+    std::vector<std::shared_ptr<AST::Node>> const& redirections() const { return m_redirections; }
+    size_t line() const { return m_line; }
+
+private:
+    std::shared_ptr<AST::Node> m_body;
+    std::vector<std::shared_ptr<AST::Node>> m_redirections;
+    size_t m_line { 0 };
+};
+
+class Subshell final : public Node {
+public:
+    Subshell(std::shared_ptr<AST::Node> body)
+        : m_body(std::move(body))
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::Subshell; }
+
+    std::shared_ptr<AST::Node> const& body() const { return m_body; }
+
+private:
+    std::shared_ptr<AST::Node> m_body;
+};
+
+// https://www.gnu.org/software/bash/manual/html_node/Process-Substitution.html
+class ProcessSubstitution final : public Node {
+public:
+    ProcessSubstitution(std::shared_ptr<AST::Node> body, ProcessSubstitutionValue::Direction direction)
+        : m_body(std::move(body))
+        , m_direction(direction)
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::ProcessSubstitution; }
+
+    std::shared_ptr<AST::Node> const& body() const { return m_body; }
+    ProcessSubstitutionValue::Direction direction() const { return m_direction; }
+
+private:
+    std::shared_ptr<AST::Node> m_body;
+    ProcessSubstitutionValue::Direction m_direction;
+};
+
+class BraceGroup final : public Node {
+public:
+    BraceGroup(std::shared_ptr<AST::Node> body)
+        : m_body(std::move(body))
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::BraceGroup; }
+
+    std::shared_ptr<AST::Node> const& body() const { return m_body; }
+
+private:
+    std::shared_ptr<AST::Node> m_body;
+};
+
+class FunctionDefinition final : public Node {
+public:
+    FunctionDefinition(std::string name, std::shared_ptr<AST::Node> body)
+        : m_name(std::move(name))
+        , m_body(std::move(body))
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::FunctionDefinition; }
+
+    std::string const& name() const { return m_name; }
+    std::shared_ptr<AST::Node> const& body() const { return m_body; }
+
+private:
+    std::string m_name;
+    std::shared_ptr<AST::Node> m_body;
+};
+
+class ForLoop final : public Node {
+public:
+    ForLoop(std::string name, std::optional<std::vector<std::string>> words, std::shared_ptr<AST::Node> body)
+        : m_name(std::move(name))
+        , m_words(std::move(words))
+        , m_body(std::move(body))
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::ForLoop; }
+
+    std::string const& name() const { return m_name; }
+    std::optional<std::vector<std::string>> const& words() const { return m_words; }
+    std::shared_ptr<AST::Node> const& body() const { return m_body; }
+
+private:
+    std::string m_name;
+    std::optional<std::vector<std::string>> m_words;
+    std::shared_ptr<AST::Node> m_body;
+};
+
+class WhileLoop final : public Node {
+public:
+    enum class Type {
+        While,
+        Until
+    };
+
+    WhileLoop(std::shared_ptr<AST::Node> condition, std::shared_ptr<AST::Node> body, Type type)
+        : m_condition(std::move(condition))
+        , m_body(std::move(body))
+        , m_type(type)
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::WhileLoop; }
+
+    std::shared_ptr<AST::Node> const& condition() const { return m_condition; }
+    std::shared_ptr<AST::Node> const& body() const { return m_body; }
+    Type type() const { return m_type; }
+
+private:
+    std::shared_ptr<AST::Node> m_condition;
+    std::shared_ptr<AST::Node> m_body;
+    Type m_type;
+};
+
+class List final : public Node {
+public:
+    List(std::vector<std::shared_ptr<AST::Node>> nodes)
+        : m_nodes(std::move(nodes))
+    {
+    }
+
+    virtual std::shared_ptr<Value> eval() const override;
+    virtual Kind kind() const override { return Kind::List; }
+
+    std::vector<std::shared_ptr<AST::Node>> const& nodes() const { return m_nodes; };
+
+private:
+    std::vector<std::shared_ptr<AST::Node>> m_nodes;
+};
+
 class AndOrIf final : public Node {
 public:
     enum class Type {
@@ -176,23 +359,22 @@ public:
         OrIf
     };
 
-    AndOrIf(std::shared_ptr<AST::Node> left, std::shared_ptr<AST::Node> right, Type type)
-        : m_left(std::move(left))
-        , m_right(std::move(right))
-        , m_type(type)
+    // The operators go between the commands, so there is one fewer of them.
+    AndOrIf(std::vector<std::shared_ptr<AST::Node>> commands, std::vector<Type> operators)
+        : m_commands(std::move(commands))
+        , m_operators(std::move(operators))
     {
     }
 
     virtual std::shared_ptr<Value> eval() const override;
     virtual Kind kind() const override { return Kind::AndOrIf; }
 
-    std::shared_ptr<AST::Node> left() const { return m_left; }
-    std::shared_ptr<AST::Node> right() const { return m_right; }
+    std::vector<std::shared_ptr<AST::Node>> const& commands() const { return m_commands; }
+    std::vector<Type> const& operators() const { return m_operators; }
 
 private:
-    std::shared_ptr<AST::Node> m_left;
-    std::shared_ptr<AST::Node> m_right;
-    Type m_type;
+    std::vector<std::shared_ptr<AST::Node>> m_commands;
+    std::vector<Type> m_operators;
 };
 
 } // namespace RatShell::AST
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ArgBatch.h"
+#include <sys/wait.h>
+
+namespace RatShell {
+
+size_t argument_size(std::string_view string)
+{
+    return string.size() + 1 + sizeof(char*);
+}
+
+std::optional<std::vector<ArgumentBatch>> split_into_batches(std::span<std::string const> fields, ArgumentBatch batched, size_t environment_size, size_t limit)
+{
+    auto [first_batched, end_batched] = batched;
+
+    // The arguments and the environment both end with a null pointer.
+    auto fixed_size = environment_size + 2 * sizeof(char*);
+    size_t batched_size = 0;
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (i >= first_batched && i < end_batched)
+            batched_size += argument_size(fields[i]);
+        else
+            fixed_size += argument_size(fields[i]);
+    }
+    if (fixed_size + batched_size <= limit)
+        return std::nullopt;
+
+    auto room = limit > fixed_size ? limit - fixed_size : 0;
+    std::vector<ArgumentBatch> batches;
+    for (auto start = first_batched; start < end_batched;) {
+        auto end = start + 1;
+        auto size = argument_size(fields[start]);
+        while (end < end_batched && size + argument_size(fields[end]) <= room)
+            size += argument_size(fields[end++]);
+        batches.emplace_back(start, end);
+        start = end;
+    }
+    return batches;
+}
+
+std::vector<std::string> fields_for_batch(std::span<std::string const> fields, ArgumentBatch batched, ArgumentBatch batch)
+{
+    auto [first_batched, end_batched] = batched;
+
+    std::vector<std::string> result;
+    result.reserve(fields.size() - (end_batched - first_batched) + (batch.second - batch.first));
+    result.insert(result.end(), fields.begin(), fields.begin() + first_batched);
+    result.insert(result.end(), fields.begin() + batch.first, fields.begin() + batch.second);
+    result.insert(result.end(), fields.begin() + end_batched, fields.end());
+    return result;
+}
+
+void BatchStatus::add(int wait_status)
+{
+    if (WIFSIGNALED(wait_status)) {
+        m_exit_status = 125;
+        m_should_stop = true;
+    } else if (WEXITSTATUS(wait_status) == 255) {
+        m_exit_status = 124;
+        m_should_stop = true;
+    } else if (WEXITSTATUS(wait_status) == 126 || WEXITSTATUS(wait_status) == 127) {
+        m_exit_status = WEXITSTATUS(wait_status);
+        m_should_stop = true;
+    } else if (WEXITSTATUS(wait_status) != 0 && m_exit_status == 0) {
+        m_exit_status = 123;
+    }
+}
+
+} // namespace RatShell
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace RatShell {
+
+// The fields from one up to another, as used by "set -o argbatch".
+using ArgumentBatch = std::pair<size_t, size_t>;
+
+// What execve(2) counts against ARG_MAX for an argument or environment string: the string
+// with its terminator, and a pointer to it.
+size_t argument_size(std::string_view);
+
+// Splits the fields from first_batched up to end_batched into batches that each fit in
+// limit bytes along with the fields around them and an environment of the given size.
+// Every batch takes at least one field, which is left to fail if it doesn't fit on its
+// own. Returns nothing if all the fields fit at once.
+std::optional<std::vector<ArgumentBatch>> split_into_batches(std::span<std::string const> fields, ArgumentBatch batched, size_t environment_size, size_t limit);
+
+// The fields for running one batch: the batch, with the fields that weren't batched before
+// and after it, e.g. "cp a.c b.c dir" for one batch of "cp *.c dir".
+std::vector<std::string> fields_for_batch(std::span<std::string const> fields, ArgumentBatch batched, ArgumentBatch batch);
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/xargs.html
+// The exit status xargs would give for the runs so far.
+class BatchStatus {
+public:
+    // Counts in the wait status of a run that's done.
+    void add(int wait_status);
+
+    // 123 when some run failed, 124 when one exited with 255, 125 when one was killed and
+    // 126 or 127 when the utility couldn't be run.
+    int exit_status() const { return m_exit_status; }
+    // Whether the runs that haven't started yet shouldn't, which is the case after all but
+    // an ordinary failure.
+    bool should_stop() const { return m_should_stop; }
+
+private:
+    int m_exit_status { 0 };
+    bool m_should_stop { false };
+};
+
+} // namespace RatShell
@@ -5,44 +5,95 @@
  */
 
 #include "ArgsParser.h"
+#include <algorithm>
 #include <iostream>
 #include <optional>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unistd.h>
 #include <vector>
 
-namespace {
-
-class OptionsParser {
-public:
-    struct Result {
-        int index { 0 };
-        int opt { -1 };
-        std::optional<std::string> arg;
-    };
-
-    static Result parse(int argc, char* const argv[], std::string const& optstring)
-    {
-        /// TODO: Support long names.
+namespace RatShell {
 
-        auto opt = getopt(argc, argv, optstring.c_str());
-        std::optional<std::string> arg;
+std::optional<size_t> parse_options(std::span<OptionSpec const> spec, std::span<std::string const> argv, std::span<ParsedOption> parsed)
+{
+    std::string_view utility = argv.empty() ? std::string_view {} : std::string_view { argv[0] };
+    size_t position = 0;
+    size_t index = 1;
+
+    for (; index < argv.size(); index++) {
+        std::string_view arg = argv[index];
+        if (arg == "--")
+            return index + 1;
+        if (arg.size() < 2 || arg[0] != '-')
+            break;
 
-        if (optarg != nullptr)
-            arg = optarg;
+        if (arg.starts_with("--")) {
+            auto name = arg.substr(2);
+            std::optional<std::string_view> argument;
+            if (auto equals = name.find('='); equals != std::string_view::npos) {
+                argument = name.substr(equals + 1);
+                name = name.substr(0, equals);
+            }
+
+            auto it = std::find_if(spec.begin(), spec.end(), [name](OptionSpec const& option) {
+                return !option.long_name.empty() && option.long_name == name;
+            });
+            if (it == spec.end()) {
+                std::cerr << utility << ": --" << name << ": invalid option\n";
+                return std::nullopt;
+            }
+
+            if (!it->has_argument && argument.has_value()) {
+                std::cerr << utility << ": --" << name << ": option doesn't allow an argument\n";
+                return std::nullopt;
+            }
+            if (it->has_argument && !argument.has_value()) {
+                if (index + 1 == argv.size()) {
+                    std::cerr << utility << ": --" << name << ": option requires an argument\n";
+                    return std::nullopt;
+                }
+                argument = argv[++index];
+            }
+
+            auto& option = parsed[it - spec.begin()];
+            option.position = ++position;
+            option.argument = argument.value_or(std::string_view {});
+            continue;
+        }
 
-        return Result {
-            .index = optind,
-            .opt = opt,
-            .arg = std::move(arg)
-        };
+        // A group of short options, where the first one taking an argument takes the
+        // rest of the group or, failing that, the next argument.
+        for (size_t i = 1; i < arg.size(); i++) {
+            auto short_name = arg[i];
+            auto it = std::find_if(spec.begin(), spec.end(), [short_name](OptionSpec const& option) {
+                return option.short_name != 0 && option.short_name == short_name;
+            });
+            if (it == spec.end()) {
+                std::cerr << utility << ": -" << short_name << ": invalid option\n";
+                return std::nullopt;
+            }
+
+            auto& option = parsed[it - spec.begin()];
+            option.position = ++position;
+            option.argument = {};
+            if (!it->has_argument)
+                continue;
+
+            if (i + 1 < arg.size()) {
+                option.argument = arg.substr(i + 1);
+            } else if (index + 1 < argv.size()) {
+                option.argument = argv[++index];
+            } else {
+                std::cerr << utility << ": -" << short_name << ": option requires an argument\n";
+                return std::nullopt;
+            }
+            break;
+        }
     }
-};
-
-} // namespace
 
-namespace RatShell {
+    return index;
+}
 
 void ArgsParser::add_option(bool& value, std::string help, std::string long_name, char short_name)
 {
@@ -75,16 +126,20 @@ void ArgsParser::add_option_argument(std::string& value, std::string help, std::
 
 void ArgsParser::add_option(Option&& option)
 {
-    if (!option.long_name.empty()) {
-        std::cerr << "FIXME: long names not supported yet\n";
+    if (option.short_name == 0 && option.long_name.empty()) {
+        std::cerr << "detected option without a name\n";
         exit_with_err();
     }
 
     for (auto const& existing_option : m_options) {
-        if (option.short_name == existing_option.short_name) {
+        if (option.short_name != 0 && option.short_name == existing_option.short_name) {
             std::cerr << "detected duplicate short name: " << option.short_name << "\n";
             exit_with_err();
         }
+        if (!option.long_name.empty() && option.long_name == existing_option.long_name) {
+            std::cerr << "detected duplicate long name: " << option.long_name << "\n";
+            exit_with_err();
+        }
     }
     m_options.push_back(std::move(option));
 }
@@ -119,60 +174,34 @@ void ArgsParser::add_operand(Operand&& operand)
 
 bool ArgsParser::parse(std::vector<std::string> const& argv)
 {
-    int argc = (int)argv.size();
-    char* c_argv[argc];
-
-    for (size_t i = 0; i < argv.size(); i++)
-        c_argv[i] = const_cast<char*>(argv[i].c_str());
-
-    return parse(argc, c_argv);
-}
-
-bool ArgsParser::parse(int argc, char* const argv[])
-{
-    if (argc < 1)
+    if (argv.empty())
         return true;
 
-    std::string opstring;
-
+    std::vector<OptionSpec> spec;
+    spec.reserve(m_options.size());
     for (auto const& option : m_options) {
-        if (option.short_name != 0) {
-            opstring += option.short_name;
-
-            if (option.is_optional_argument)
-                opstring += ':';
-        }
+        spec.push_back(OptionSpec {
+            .short_name = option.short_name,
+            .long_name = option.long_name,
+            .has_argument = option.is_optional_argument });
     }
 
-    // Parse options.
-    int option_idx = 1;
-
-    while (true) {
-        auto result = OptionsParser::parse(argc, argv, opstring);
-        auto opt = result.opt;
-
-        if (opt == -1) {
-            option_idx = result.index;
-            break;
-        }
-
-        if (opt == '?')
-            return false;
-
-        auto it = std::find_if(m_options.begin(), m_options.end(), [opt](Option const& option) {
-            return option.short_name == opt;
-        });
+    std::vector<ParsedOption> parsed(m_options.size());
+    auto first_operand = parse_options(spec, argv, parsed);
+    if (!first_operand.has_value())
+        return false;
 
-        if (it == m_options.end()) {
-            std::cerr << "we should not reach this\n";
-            exit_with_err();
-        }
-
-        auto option = *it;
-        auto arg = result.arg.value_or("");
-
-        option.accept_arg(arg);
+    // Options are accepted in the order they were last given.
+    std::vector<size_t> given;
+    for (size_t i = 0; i < parsed.size(); i++) {
+        if (parsed[i].is_present())
+            given.push_back(i);
     }
+    std::sort(given.begin(), given.end(), [&parsed](size_t a, size_t b) {
+        return parsed[a].position < parsed[b].position;
+    });
+    for (auto i : given)
+        m_options[i].accept_arg(parsed[i].argument);
 
     // Parse operands.
     size_t num_required_operands = 0;
@@ -181,22 +210,27 @@ bool ArgsParser::parse(int argc, char* const argv[])
             num_required_operands++;
     }
 
+    auto operand_idx = first_operand.value();
     for (auto& operand : m_operands) {
-        if (option_idx == argc)
+        if (operand_idx == argv.size())
             break;
-        auto* const op = argv[option_idx++];
-        operand.accept_operand(op);
+        operand.accept_operand(argv[operand_idx++]);
 
         if (operand.reqiured == Required::Yes)
             num_required_operands--;
     }
 
     if (num_required_operands != 0) {
-        std::cerr << argv[0] << "missing operands\n";
-        exit_with_err();
+        std::cerr << argv[0] << ": missing operands\n";
+        return false;
     }
 
     return true;
 }
 
-} // namespace RatShell
\ No newline at end of file
+bool ArgsParser::parse(int argc, char* const argv[])
+{
+    return parse(std::vector<std::string>(argv, argv + std::max(argc, 0)));
+}
+
+} // namespace RatShell
@@ -6,13 +6,87 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <functional>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 
 namespace RatShell {
 
+// https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap12.html#tag_12_02
+// An option a utility accepts. Either name may be left empty, and a long name is given
+// as "--name", "--name=argument" or "--name argument".
+struct OptionSpec {
+    char short_name { 0 };
+    std::string_view long_name {};
+    bool has_argument { false };
+};
+
+struct ParsedOption {
+    // Where the option was last given counting from 1 among all the options given, so
+    // that the later of two conflicting options can win, or 0 if it wasn't given.
+    size_t position { 0 };
+    // Points into argv, so it lives as long as argv does.
+    std::string_view argument;
+
+    bool is_present() const { return position != 0; }
+};
+
+// Parses the options at the start of argv in a single pass, where argv[0] names the
+// utility for error messages. Parsing stops at the first operand, at "-" or after "--",
+// and there is no global state nor any allocation unless an error is written out.
+// Returns the index of the first operand, or nothing if an option is unknown or is
+// missing its argument.
+std::optional<size_t> parse_options(std::span<OptionSpec const> spec, std::span<std::string const> argv, std::span<ParsedOption> parsed);
+
+template<size_t N>
+struct ParsedOptions {
+    std::array<ParsedOption, N> options {};
+    size_t first_operand { 0 };
+
+    ParsedOption const& operator[](size_t index) const { return options[index]; }
+};
+
+template<size_t N>
+consteval bool has_unique_names(std::array<OptionSpec, N> const& spec)
+{
+    for (size_t i = 0; i < N; i++) {
+        if (spec[i].short_name == 0 && spec[i].long_name.empty())
+            return false;
+        for (size_t j = i + 1; j < N; j++) {
+            if (spec[i].short_name != 0 && spec[i].short_name == spec[j].short_name)
+                return false;
+            if (!spec[i].long_name.empty() && spec[i].long_name == spec[j].long_name)
+                return false;
+        }
+    }
+    return true;
+}
+
+// Parses options against a static table, e.g.
+//
+//     constexpr std::array<OptionSpec, 1> options { { { 'f', "force" } } };
+//     auto parsed = parse_options<options>(argv);
+//
+// where the options found are indexed in the same order as the table.
+template<auto const& Spec>
+std::optional<ParsedOptions<Spec.size()>> parse_options(std::span<std::string const> argv)
+{
+    static_assert(has_unique_names(Spec), "every option needs a name, and no two options may share one");
+
+    ParsedOptions<Spec.size()> parsed;
+    auto first_operand = parse_options(Spec, argv, parsed.options);
+    if (!first_operand.has_value())
+        return std::nullopt;
+
+    parsed.first_operand = first_operand.value();
+    return parsed;
+}
+
 class ArgsParser {
 public:
     struct Option {
@@ -55,4 +129,4 @@ private:
     std::vector<Operand> m_operands;
 };
 
-} // namespace RatShell
\ No newline at end of file
+} // namespace RatShell
@@ -0,0 +1,734 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Arithmetic.h"
+#include "Variables.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+using Opcode = ArithmeticExpression::Opcode;
+
+constexpr size_t max_cached_expressions = 1024;
+constexpr size_t inline_stack_size = 32;
+
+// Longer operators come first so that the longest match wins.
+constexpr std::string_view operators[] = {
+    "<<=", ">>=",
+    "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "*=", "/=", "%=", "+=", "-=", "&=", "^=", "|=",
+    "+", "-", "*", "/", "%", "<", ">", "&", "^", "|",
+    "!", "~", "?", ":", "=", "(", ")"
+};
+
+struct BinaryOperator {
+    std::string_view text;
+    Opcode opcode;
+};
+
+// The binary operators from the loosest binding to the tightest, leaving out the logical
+// ones which need jumps.
+std::vector<BinaryOperator> const binary_operators[] = {
+    { { "|", Opcode::BitwiseOr } },
+    { { "^", Opcode::BitwiseXor } },
+    { { "&", Opcode::BitwiseAnd } },
+    { { "==", Opcode::Equal }, { "!=", Opcode::NotEqual } },
+    { { "<", Opcode::Less }, { "<=", Opcode::LessEqual }, { ">", Opcode::Greater }, { ">=", Opcode::GreaterEqual } },
+    { { "<<", Opcode::ShiftLeft }, { ">>", Opcode::ShiftRight } },
+    { { "+", Opcode::Add }, { "-", Opcode::Subtract } },
+    { { "*", Opcode::Multiply }, { "/", Opcode::Divide }, { "%", Opcode::Remainder } },
+};
+
+constexpr std::pair<std::string_view, Opcode> compound_assignments[] = {
+    { "*=", Opcode::Multiply },
+    { "/=", Opcode::Divide },
+    { "%=", Opcode::Remainder },
+    { "+=", Opcode::Add },
+    { "-=", Opcode::Subtract },
+    { "<<=", Opcode::ShiftLeft },
+    { ">>=", Opcode::ShiftRight },
+    { "&=", Opcode::BitwiseAnd },
+    { "^=", Opcode::BitwiseXor },
+    { "|=", Opcode::BitwiseOr },
+};
+
+// Signed overflow wraps around like two's complement rather than being undefined.
+int64_t wrap(uint64_t value)
+{
+    return static_cast<int64_t>(value);
+}
+
+// Returns nothing on a division by zero.
+std::optional<int64_t> apply_binary(Opcode opcode, int64_t lhs, int64_t rhs)
+{
+    switch (opcode) {
+    case Opcode::Multiply:
+        return wrap(static_cast<uint64_t>(lhs) * static_cast<uint64_t>(rhs));
+    case Opcode::Divide:
+        if (rhs == 0)
+            return std::nullopt;
+        if (rhs == -1)
+            return wrap(0 - static_cast<uint64_t>(lhs));
+        return lhs / rhs;
+    case Opcode::Remainder:
+        if (rhs == 0)
+            return std::nullopt;
+        if (rhs == -1)
+            return 0;
+        return lhs % rhs;
+    case Opcode::Add:
+        return wrap(static_cast<uint64_t>(lhs) + static_cast<uint64_t>(rhs));
+    case Opcode::Subtract:
+        return wrap(static_cast<uint64_t>(lhs) - static_cast<uint64_t>(rhs));
+    case Opcode::ShiftLeft:
+        return wrap(static_cast<uint64_t>(lhs) << (rhs & 63));
+    case Opcode::ShiftRight:
+        return lhs >> (rhs & 63);
+    case Opcode::Less:
+        return lhs < rhs;
+    case Opcode::LessEqual:
+        return lhs <= rhs;
+    case Opcode::Greater:
+        return lhs > rhs;
+    case Opcode::GreaterEqual:
+        return lhs >= rhs;
+    case Opcode::Equal:
+        return lhs == rhs;
+    case Opcode::NotEqual:
+        return lhs != rhs;
+    case Opcode::BitwiseAnd:
+        return lhs & rhs;
+    case Opcode::BitwiseXor:
+        return lhs ^ rhs;
+    case Opcode::BitwiseOr:
+        return lhs | rhs;
+    default:
+        return 0;
+    }
+}
+
+int64_t apply_unary(Opcode opcode, int64_t operand)
+{
+    switch (opcode) {
+    case Opcode::Negate:
+        return wrap(0 - static_cast<uint64_t>(operand));
+    case Opcode::LogicalNot:
+        return operand == 0;
+    case Opcode::BitwiseNot:
+        return ~operand;
+    default:
+        return operand;
+    }
+}
+
+// (1.1.2.1) Only the decimal, octal and hexadecimal constants of the ISO C standard are
+// required, along with an optional sign for variable values.
+std::optional<int64_t> parse_integer(std::string_view text)
+{
+    bool is_negative = false;
+    if (!text.empty() && (text[0] == '-' || text[0] == '+')) {
+        is_negative = text[0] == '-';
+        text.remove_prefix(1);
+    }
+    if (text.empty())
+        return std::nullopt;
+
+    unsigned base = 10;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        text.remove_prefix(2);
+    } else if (text.size() > 1 && text[0] == '0') {
+        base = 8;
+        text.remove_prefix(1);
+    }
+
+    uint64_t value = 0;
+    for (auto ch : text) {
+        unsigned digit = 0;
+        if (std::isdigit(static_cast<unsigned char>(ch)) != 0)
+            digit = ch - '0';
+        else if (std::isxdigit(static_cast<unsigned char>(ch)) != 0)
+            digit = std::tolower(static_cast<unsigned char>(ch)) - 'a' + 10;
+        else
+            return std::nullopt;
+
+        if (digit >= base)
+            return std::nullopt;
+        value = value * base + digit;
+    }
+
+    return wrap(is_negative ? 0 - value : value);
+}
+
+struct Token {
+    enum class Type {
+        Number,
+        Name,
+        Operator,
+        End
+    };
+
+    Type type { Type::End };
+    std::string_view text;
+};
+
+struct Node {
+    enum class Kind {
+        Constant,
+        Variable,
+        Unary,
+        Binary,
+        LogicalAnd,
+        LogicalOr,
+        Conditional,
+        Assignment
+    };
+
+    Kind kind { Kind::Constant };
+    int64_t value { 0 };
+    std::string_view name;
+    // The operator for unary and binary nodes, and compound assignments.
+    std::optional<Opcode> opcode;
+    std::unique_ptr<Node> operands[3];
+
+    bool is_constant() const { return kind == Kind::Constant; }
+};
+
+std::unique_ptr<Node> make_constant(int64_t value)
+{
+    auto node = std::make_unique<Node>();
+    node->value = value;
+    return node;
+}
+
+} // namespace
+
+// Parses an expression into a tree, folding constants on the way, and then lowers the
+// tree to bytecode.
+class ArithmeticCompiler {
+public:
+    explicit ArithmeticCompiler(std::string_view expression)
+        : m_expression(expression)
+    {
+    }
+
+    std::shared_ptr<ArithmeticExpression const> compile(std::string& error);
+
+private:
+    bool tokenize();
+
+    Token const& peek() const { return m_tokens[m_index]; }
+    bool peek_is(std::string_view text) const { return peek().type == Token::Type::Operator && peek().text == text; }
+    Token const& consume() { return m_tokens[m_index == m_tokens.size() - 1 ? m_index : m_index++]; }
+
+    std::unique_ptr<Node> parse_assignment();
+    std::unique_ptr<Node> parse_conditional();
+    std::unique_ptr<Node> parse_logical_or();
+    std::unique_ptr<Node> parse_logical_and();
+    std::unique_ptr<Node> parse_binary(size_t level);
+    std::unique_ptr<Node> parse_unary();
+    std::unique_ptr<Node> parse_primary();
+
+    std::unique_ptr<Node> fail(std::string message)
+    {
+        if (m_error.empty())
+            m_error = std::move(message);
+        return nullptr;
+    }
+
+    void emit(Node const&);
+    void emit(Opcode opcode, int64_t operand, int stack_effect);
+    size_t name_index(std::string_view name);
+
+    std::string_view m_expression;
+    std::vector<Token> m_tokens;
+    size_t m_index { 0 };
+    std::string m_error;
+
+    std::shared_ptr<ArithmeticExpression> m_result;
+    size_t m_stack_depth { 0 };
+};
+
+std::shared_ptr<ArithmeticExpression const> ArithmeticCompiler::compile(std::string& error)
+{
+    if (!tokenize()) {
+        error = m_error;
+        return nullptr;
+    }
+
+    auto root = parse_assignment();
+    if (root && peek().type != Token::Type::End)
+        fail("unexpected '" + std::string { peek().text } + "'");
+    if (!root || !m_error.empty()) {
+        error = m_error.empty() ? "expression expected" : m_error;
+        return nullptr;
+    }
+
+    m_result = std::make_shared<ArithmeticExpression>();
+    emit(*root);
+    return m_result;
+}
+
+bool ArithmeticCompiler::tokenize()
+{
+    auto text = m_expression;
+
+    while (true) {
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text[0])) != 0)
+            text.remove_prefix(1);
+        if (text.empty())
+            break;
+
+        auto ch = static_cast<unsigned char>(text[0]);
+        size_t length = 0;
+        auto type = Token::Type::Operator;
+
+        if (std::isdigit(ch) != 0) {
+            type = Token::Type::Number;
+            while (length < text.size() && std::isalnum(static_cast<unsigned char>(text[length])) != 0)
+                length++;
+        } else if (std::isalpha(ch) != 0 || ch == '_') {
+            type = Token::Type::Name;
+            while (length < text.size() && (std::isalnum(static_cast<unsigned char>(text[length])) != 0 || text[length] == '_'))
+                length++;
+        } else {
+            for (auto op : operators) {
+                if (text.starts_with(op)) {
+                    length = op.size();
+                    break;
+                }
+            }
+            if (length == 0) {
+                m_error = "unexpected '" + std::string { text.substr(0, 1) } + "'";
+                return false;
+            }
+        }
+
+        m_tokens.push_back({ type, text.substr(0, length) });
+        text.remove_prefix(length);
+    }
+
+    m_tokens.push_back({ Token::Type::End, {} });
+    return true;
+}
+
+std::unique_ptr<Node> ArithmeticCompiler::parse_assignment()
+{
+    // Assignments are right-associative and need a variable on their left.
+    if (peek().type == Token::Type::Name && m_tokens[m_index + 1].type == Token::Type::Operator) {
+        auto op = m_tokens[m_index + 1].text;
+        std::optional<Opcode> compound_opcode;
+        for (auto const& [text, opcode] : compound_assignments) {
+            if (op == text)
+                compound_opcode = opcode;
+        }
+
+        if (op == "=" || compound_opcode.has_value()) {
+            auto node = std::make_unique<Node>();
+            node->kind = Node::Kind::Assignment;
+            node->name = consume().text;
+            node->opcode = compound_opcode;
+            consume();
+
+            node->operands[0] = parse_assignment();
+            if (!node->operands[0])
+                return fail("expression expected after '" + std::string { op } + "'");
+            return node;
+        }
+    }
+
+    return parse_conditional();
+}
+
+std::unique_ptr<Node> ArithmeticCompiler::parse_conditional()
+{
+    auto condition = parse_logical_or();
+    if (!condition || !peek_is("?"))
+        return condition;
+    consume();
+
+    auto if_true = parse_assignment();
+    if (!if_true)
+        return nullptr;
+    if (!peek_is(":"))
+        return fail("expected ':' in conditional expression");
+    consume();
+
+    auto if_false = parse_conditional();
+    if (!if_false)
+        return nullptr;
+
+    if (condition->is_constant())
+        return condition->value != 0 ? std::move(if_true) : std::move(if_false);
+
+    auto node = std::make_unique<Node>();
+    node->kind = Node::Kind::Conditional;
+    node->operands[0] = std::move(condition);
+    node->operands[1] = std::move(if_true);
+    node->operands[2] = std::move(if_false);
+    return node;
+}
+
+std::unique_ptr<Node> ArithmeticCompiler::parse_logical_or()
+{
+    auto lhs = parse_logical_and();
+    while (lhs && peek_is("||")) {
+        consume();
+        auto rhs = parse_logical_and();
+        if (!rhs)
+            return fail("expression expected after '||'");
+
+        // The right-hand side isn't evaluated at all when the left one decides.
+        if (lhs->is_constant() && lhs->value != 0) {
+            lhs = make_constant(1);
+            continue;
+        }
+        if (lhs->is_constant() && rhs->is_constant()) {
+            lhs = make_constant(rhs->value != 0);
+            continue;
+        }
+
+        auto node = std::make_unique<Node>();
+        node->kind = Node::Kind::LogicalOr;
+        node->operands[0] = std::move(lhs);
+        node->operands[1] = std::move(rhs);
+        lhs = std::move(node);
+    }
+    return lhs;
+}
+
+std::unique_ptr<Node> ArithmeticCompiler::parse_logical_and()
+{
+    auto lhs = parse_binary(0);
+    while (lhs && peek_is("&&")) {
+        consume();
+        auto rhs = parse_binary(0);
+        if (!rhs)
+            return fail("expression expected after '&&'");
+
+        if (lhs->is_constant() && lhs->value == 0) {
+            lhs = make_constant(0);
+            continue;
+        }
+        if (lhs->is_constant() && rhs->is_constant()) {
+            lhs = make_constant(rhs->value != 0);
+            continue;
+        }
+
+        auto node = std::make_unique<Node>();
+        node->kind = Node::Kind::LogicalAnd;
+        node->operands[0] = std::move(lhs);
+        node->operands[1] = std::move(rhs);
+        lhs = std::move(node);
+    }
+    return lhs;
+}
+
+std::unique_ptr<Node> ArithmeticCompiler::parse_binary(size_t level)
+{
+    if (level == std::size(binary_operators))
+        return parse_unary();
+
+    auto lhs = parse_binary(level + 1);
+    while (lhs) {
+        std::optional<Opcode> opcode;
+        for (auto const& op : binary_operators[level]) {
+            if (peek_is(op.text))
+                opcode = op.opcode;
+        }
+        if (!opcode.has_value())
+            break;
+
+        auto op = consume().text;
+        auto rhs = parse_binary(level + 1);
+        if (!rhs)
+            return fail("expression expected after '" + std::string { op } + "'");
+
+        // A division by zero is left for evaluation to report.
+        if (lhs->is_constant() && rhs->is_constant()) {
+            if (auto value = apply_binary(opcode.value(), lhs->value, rhs->value); value.has_value()) {
+                lhs = make_constant(value.value());
+                continue;
+            }
+        }
+
+        auto node = std::make_unique<Node>();
+        node->kind = Node::Kind::Binary;
+        node->opcode = opcode;
+        node->operands[0] = std::move(lhs);
+        node->operands[1] = std::move(rhs);
+        lhs = std::move(node);
+    }
+    return lhs;
+}
+
+std::unique_ptr<Node> ArithmeticCompiler::parse_unary()
+{
+    std::optional<Opcode> opcode;
+    if (peek_is("-"))
+        opcode = Opcode::Negate;
+    else if (peek_is("!"))
+        opcode = Opcode::LogicalNot;
+    else if (peek_is("~"))
+        opcode = Opcode::BitwiseNot;
+    else if (!peek_is("+"))
+        return parse_primary();
+
+    auto op = consume().text;
+    auto operand = parse_unary();
+    if (!operand)
+        return fail("expression expected after '" + std::string { op } + "'");
+
+    // Unary plus changes nothing.
+    if (!opcode.has_value())
+        return operand;
+    if (operand->is_constant())
+        return make_constant(apply_unary(opcode.value(), operand->value));
+
+    auto node = std::make_unique<Node>();
+    node->kind = Node::Kind::Unary;
+    node->opcode = opcode;
+    node->operands[0] = std::move(operand);
+    return node;
+}
+
+std::unique_ptr<Node> ArithmeticCompiler::parse_primary()
+{
+    auto const& token = peek();
+
+    switch (token.type) {
+    case Token::Type::Number: {
+        auto value = parse_integer(token.text);
+        if (!value.has_value())
+            return fail("'" + std::string { token.text } + "' is not a valid number");
+        consume();
+        return make_constant(value.value());
+    }
+    case Token::Type::Name: {
+        auto node = std::make_unique<Node>();
+        node->kind = Node::Kind::Variable;
+        node->name = consume().text;
+        return node;
+    }
+    case Token::Type::Operator: {
+        if (token.text != "(")
+            return fail("unexpected '" + std::string { token.text } + "'");
+        consume();
+
+        auto node = parse_assignment();
+        if (!node)
+            return fail("expression expected after '('");
+        if (!peek_is(")"))
+            return fail("missing ')'");
+        consume();
+        return node;
+    }
+    case Token::Type::End:
+        return nullptr;
+    }
+
+    return nullptr;
+}
+
+void ArithmeticCompiler::emit(Opcode opcode, int64_t operand, int stack_effect)
+{
+    m_result->m_code.push_back({ opcode, operand });
+    m_stack_depth += stack_effect;
+    m_result->m_max_stack_depth = std::max(m_result->m_max_stack_depth, m_stack_depth);
+}
+
+size_t ArithmeticCompiler::name_index(std::string_view name)
+{
+    auto& names = m_result->m_names;
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name)
+            return i;
+    }
+
+    names.emplace_back(name);
+    return names.size() - 1;
+}
+
+void ArithmeticCompiler::emit(Node const& node)
+{
+    auto& code = m_result->m_code;
+
+    switch (node.kind) {
+    case Node::Kind::Constant:
+        emit(Opcode::Push, node.value, 1);
+        break;
+    case Node::Kind::Variable:
+        emit(Opcode::Load, name_index(node.name), 1);
+        break;
+    case Node::Kind::Unary:
+        emit(*node.operands[0]);
+        emit(node.opcode.value(), 0, 0);
+        break;
+    case Node::Kind::Binary:
+        emit(*node.operands[0]);
+        emit(*node.operands[1]);
+        emit(node.opcode.value(), 0, -1);
+        break;
+    case Node::Kind::LogicalAnd:
+    case Node::Kind::LogicalOr: {
+        // Either side can decide the result, which is then normalized to 0 or 1.
+        auto is_and = node.kind == Node::Kind::LogicalAnd;
+        auto jump = is_and ? Opcode::JumpIfZero : Opcode::JumpIfNotZero;
+
+        emit(*node.operands[0]);
+        auto first_jump = code.size();
+        emit(jump, 0, -1);
+        emit(*node.operands[1]);
+        auto second_jump = code.size();
+        emit(jump, 0, -1);
+        emit(Opcode::Push, is_and ? 1 : 0, 1);
+        auto end_jump = code.size();
+        emit(Opcode::Jump, 0, -1);
+
+        code[first_jump].operand = code[second_jump].operand = code.size();
+        emit(Opcode::Push, is_and ? 0 : 1, 1);
+        code[end_jump].operand = code.size();
+        break;
+    }
+    case Node::Kind::Conditional: {
+        emit(*node.operands[0]);
+        auto else_jump = code.size();
+        emit(Opcode::JumpIfZero, 0, -1);
+        emit(*node.operands[1]);
+        auto end_jump = code.size();
+        emit(Opcode::Jump, 0, -1);
+
+        code[else_jump].operand = code.size();
+        emit(*node.operands[2]);
+        code[end_jump].operand = code.size();
+        break;
+    }
+    case Node::Kind::Assignment: {
+        auto index = name_index(node.name);
+        if (node.opcode.has_value()) {
+            emit(Opcode::Load, index, 1);
+            emit(*node.operands[0]);
+            emit(node.opcode.value(), 0, -1);
+        } else {
+            emit(*node.operands[0]);
+        }
+        emit(Opcode::Store, index, 0);
+        break;
+    }
+    }
+}
+
+std::shared_ptr<ArithmeticExpression const> ArithmeticExpression::compile(std::string_view expression, std::string& error)
+{
+    return ArithmeticCompiler { expression }.compile(error);
+}
+
+std::optional<int64_t> ArithmeticExpression::evaluate(Variables& variables, std::string& error) const
+{
+    std::array<int64_t, inline_stack_size> inline_stack;
+    std::unique_ptr<int64_t[]> heap_stack;
+    auto* stack = inline_stack.data();
+    if (m_max_stack_depth > inline_stack_size) {
+        heap_stack = std::make_unique<int64_t[]>(m_max_stack_depth);
+        stack = heap_stack.get();
+    }
+
+    size_t sp = 0;
+    for (size_t pc = 0; pc < m_code.size();) {
+        auto const& instruction = m_code[pc++];
+
+        switch (instruction.opcode) {
+        case Opcode::Push:
+            stack[sp++] = instruction.operand;
+            break;
+        case Opcode::Load: {
+            auto const& name = m_names[instruction.operand];
+            auto const* variable = variables.find(name);
+
+            // An unset or null variable is taken to be zero.
+            int64_t value = 0;
+            if (variable != nullptr && variable->integer.has_value()) {
+                value = variable->integer.value();
+            } else if (variable != nullptr && !variable->value.empty()) {
+                auto integer = parse_integer(variable->value);
+                if (!integer.has_value()) {
+                    error = name + ": '" + variable->value + "' is not a valid integer";
+                    return std::nullopt;
+                }
+                value = variable->integer.emplace(integer.value());
+            }
+
+            stack[sp++] = value;
+            break;
+        }
+        case Opcode::Store:
+            variables.set_integer(m_names[instruction.operand], stack[sp - 1]);
+            break;
+        case Opcode::Jump:
+            pc = instruction.operand;
+            break;
+        case Opcode::JumpIfZero:
+            if (stack[--sp] == 0)
+                pc = instruction.operand;
+            break;
+        case Opcode::JumpIfNotZero:
+            if (stack[--sp] != 0)
+                pc = instruction.operand;
+            break;
+        case Opcode::Negate:
+        case Opcode::LogicalNot:
+        case Opcode::BitwiseNot:
+            stack[sp - 1] = apply_unary(instruction.opcode, stack[sp - 1]);
+            break;
+        default: {
+            auto rhs = stack[--sp];
+            auto result = apply_binary(instruction.opcode, stack[sp - 1], rhs);
+            if (!result.has_value()) {
+                error = "division by zero";
+                return std::nullopt;
+            }
+            stack[sp - 1] = result.value();
+            break;
+        }
+        }
+    }
+
+    return stack[0];
+}
+
+std::shared_ptr<ArithmeticExpression const> ArithmeticCache::get(std::string_view expression, std::string& error, bool* was_cached)
+{
+    auto it = m_expressions.find(expression);
+    if (was_cached != nullptr)
+        *was_cached = it != m_expressions.end();
+    if (it != m_expressions.end())
+        return it->second;
+
+    auto compiled = ArithmeticExpression::compile(expression, error);
+    if (!compiled)
+        return nullptr;
+
+    // Expressions made from expanded text may be different every time, so don't let
+    // them pile up.
+    if (m_expressions.size() >= max_cached_expressions)
+        m_expressions.clear();
+    m_expressions.emplace(expression, compiled);
+
+    return compiled;
+}
+
+} // namespace RatShell
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace RatShell {
+
+class Variables;
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06_04
+// An arithmetic expression compiled to the bytecode of a small stack machine. Subexpressions
+// made only of constants are folded while compiling, and variables are read and written
+// in place, so evaluating it needs no parsing at all.
+class ArithmeticExpression {
+public:
+    enum class Opcode : uint8_t {
+        Push,
+        Load,
+        Store,
+        Jump,
+        JumpIfZero,
+        JumpIfNotZero,
+
+        Negate,
+        LogicalNot,
+        BitwiseNot,
+
+        Multiply,
+        Divide,
+        Remainder,
+        Add,
+        Subtract,
+        ShiftLeft,
+        ShiftRight,
+        Less,
+        LessEqual,
+        Greater,
+        GreaterEqual,
+        Equal,
+        NotEqual,
+        BitwiseAnd,
+        BitwiseXor,
+        BitwiseOr,
+    };
+
+    struct Instruction {
+        Opcode opcode { Opcode::Push };
+        // A constant for Push, an index into the names for Load and Store, or the target
+        // of a jump.
+        int64_t operand { 0 };
+    };
+
+    // Returns nullptr and sets the error message if the expression is malformed.
+    static std::shared_ptr<ArithmeticExpression const> compile(std::string_view expression, std::string& error);
+
+    // Returns nothing and sets the error message if evaluation fails, e.g. because of a
+    // division by zero.
+    std::optional<int64_t> evaluate(Variables&, std::string& error) const;
+
+    // Whether the whole expression folded into a single constant.
+    bool is_constant() const { return m_code.size() == 1 && m_code.front().opcode == Opcode::Push; }
+
+    std::vector<Instruction> const& code() const { return m_code; }
+
+private:
+    friend class ArithmeticCompiler;
+
+    std::vector<Instruction> m_code;
+    std::vector<std::string> m_names;
+    size_t m_max_stack_depth { 0 };
+};
+
+// Compiled expressions keyed by their text, so that loops only compile each of them once.
+class ArithmeticCache {
+public:
+    // Says whether the expression was already compiled through was_cached, if given.
+    std::shared_ptr<ArithmeticExpression const> get(std::string_view expression, std::string& error, bool* was_cached = nullptr);
+    void clear() { m_expressions.clear(); }
+
+private:
+    struct Hash {
+        using is_transparent = void;
+        size_t operator()(std::string_view text) const { return std::hash<std::string_view> {}(text); }
+    };
+
+    std::unordered_map<std::string, std::shared_ptr<ArithmeticExpression const>, Hash, std::equal_to<>> m_expressions;
+};
+
+} // namespace RatShell
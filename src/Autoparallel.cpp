@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Autoparallel.h"
+#include <algorithm>
+#include <filesystem>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unordered_map>
+
+namespace RatShell {
+
+std::optional<std::string> file_effect_key(std::string_view path, std::string_view working_directory)
+{
+    std::filesystem::path absolute { path };
+    if (absolute.is_relative())
+        absolute = std::filesystem::path { working_directory } / absolute;
+    absolute = absolute.lexically_normal();
+
+    struct stat st {};
+    if (stat(absolute.c_str(), &st) < 0)
+        return absolute.string();
+
+    // Anything can be written to /dev/null at the same time, and nothing comes out of it.
+    if (S_ISCHR(st.st_mode) && st.st_rdev == makedev(1, 3))
+        return std::nullopt;
+    return "#" + std::to_string(st.st_dev) + ":" + std::to_string(st.st_ino);
+}
+
+std::string fd_effect_key(int fd)
+{
+    return "&" + std::to_string(fd);
+}
+
+std::vector<std::vector<size_t>> find_dependencies(std::span<CommandEffects const> commands)
+{
+    // Only the last writer of a key and the readers since then matter to the commands that
+    // come after, which keeps this linear in the number of keys.
+    struct KeyState {
+        std::optional<size_t> last_writer;
+        std::vector<size_t> readers;
+    };
+    std::unordered_map<std::string_view, KeyState> keys;
+    std::vector<std::vector<size_t>> dependencies(commands.size());
+
+    for (size_t i = 0; i < commands.size(); i++) {
+        auto& depends_on = dependencies[i];
+
+        for (auto const& key : commands[i].reads) {
+            if (auto it = keys.find(key); it != keys.end() && it->second.last_writer.has_value())
+                depends_on.push_back(it->second.last_writer.value());
+        }
+        for (auto const& key : commands[i].writes) {
+            auto it = keys.find(key);
+            if (it == keys.end())
+                continue;
+            if (it->second.last_writer.has_value())
+                depends_on.push_back(it->second.last_writer.value());
+            depends_on.insert(depends_on.end(), it->second.readers.begin(), it->second.readers.end());
+        }
+
+        std::sort(depends_on.begin(), depends_on.end());
+        depends_on.erase(std::unique(depends_on.begin(), depends_on.end()), depends_on.end());
+
+        for (auto const& key : commands[i].reads)
+            keys[key].readers.push_back(i);
+        for (auto const& key : commands[i].writes) {
+            auto& state = keys[key];
+            state.last_writer = i;
+            state.readers.clear();
+        }
+    }
+
+    return dependencies;
+}
+
+} // namespace RatShell
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RatShell {
+
+// What a command run by "set -o autoparallel" is known to touch, as keys for files and
+// file descriptors. Files are keyed by device and inode when they exist, so that every
+// name for a file gives the same key, and by absolute path when they don't exist yet.
+struct CommandEffects {
+    std::vector<std::string> reads;
+    std::vector<std::string> writes;
+};
+
+// The key for a file named in a redirection, or nothing for a file that can't be in
+// conflict with anything, i.e. /dev/null.
+std::optional<std::string> file_effect_key(std::string_view path, std::string_view working_directory);
+// The key for one of the shell's file descriptors.
+std::string fd_effect_key(int fd);
+
+// For each command, the earlier ones it has to wait for: those that write something it
+// reads or writes, and those that read something it writes. Each list is sorted.
+std::vector<std::vector<size_t>> find_dependencies(std::span<CommandEffects const> commands);
+
+} // namespace RatShell
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+// The interface to builtins loaded with "enable -f", kept to C so that a shared object
+// built by any compiler can provide them. It exports a ratsh_builtin_table under the
+// name ratsh_builtins, which the shell refuses unless its abi_version is the one the
+// shell was built with. Any change to the layout of these structures bumps the version.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RATSH_BUILTIN_ABI_VERSION 1
+#define RATSH_BUILTIN_TABLE_SYMBOL "ratsh_builtins"
+
+struct ratsh_shell;
+
+struct ratsh_builtin_context {
+    // The builtin's standard input, output and error, with its redirections applied.
+    int stdin_fd;
+    int stdout_fd;
+    int stderr_fd;
+
+    struct ratsh_shell* shell;
+    // The value of a shell variable, or NULL if it's unset. It stays valid until the
+    // variable is next changed.
+    char const* (*get_variable)(struct ratsh_shell*, char const* name);
+    // These return 0, or -1 if the name isn't a valid variable name.
+    int (*set_variable)(struct ratsh_shell*, char const* name, char const* value);
+    int (*unset_variable)(struct ratsh_shell*, char const* name);
+};
+
+// Returns the exit status. argv[0] is the builtin's name, and argv[argc] is NULL.
+typedef int (*ratsh_builtin_function)(struct ratsh_builtin_context const*, int argc, char const* const* argv);
+
+struct ratsh_builtin {
+    char const* name;
+    ratsh_builtin_function function;
+};
+
+struct ratsh_builtin_table {
+    uint32_t abi_version;
+    size_t count;
+    struct ratsh_builtin const* builtins;
+};
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,105 +5,1363 @@
  */
 
 #include "Builtins.h"
+#include "ArgsParser.h"
+#include "FileCopy.h"
+#include "LineReader.h"
+#include "LoadableBuiltins.h"
+#include "Shell.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdint>
 #include <cstring>
-#include <filesystem>
+#include <fcntl.h>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <optional>
+#include <poll.h>
 #include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
 #include <unistd.h>
+#include <utility>
 #include <vector>
 
 namespace RatShell {
 
+namespace {
+
+Builtin const builtins[] = {
+    { .name = ":", .function = builtin_true, .is_snapshot_safe = true, .is_side_effect_free = true, .is_special = true },
+    { .name = "break", .function = builtin_break, .is_special = true },
+    { .name = "cat", .function = builtin_cat, .is_snapshot_safe = true },
+    { .name = "cd", .function = builtin_cd, .is_snapshot_safe = true },
+    { .name = "compgen", .function = builtin_compgen, .is_snapshot_safe = true },
+    { .name = "continue", .function = builtin_continue, .is_special = true },
+    { .name = "dirs", .function = builtin_dirs, .is_snapshot_safe = true, .is_side_effect_free = true },
+    { .name = "echo", .function = builtin_echo, .is_snapshot_safe = true, .is_side_effect_free = true },
+    { .name = "enable", .function = builtin_enable },
+    { .name = "exec", .function = builtin_exec, .is_special = true },
+    { .name = "exit", .function = builtin_exit, .is_special = true },
+    { .name = "export", .function = builtin_export, .is_snapshot_safe = true, .is_special = true },
+    { .name = "false", .function = builtin_false, .is_snapshot_safe = true, .is_side_effect_free = true },
+    { .name = "history", .function = builtin_history },
+    { .name = "popd", .function = builtin_popd },
+    { .name = "pushd", .function = builtin_pushd },
+    { .name = "pwd", .function = builtin_pwd, .is_snapshot_safe = true, .is_side_effect_free = true },
+    { .name = "read", .function = builtin_read, .is_snapshot_safe = true },
+    { .name = "return", .function = builtin_return, .is_special = true },
+    { .name = "set", .function = builtin_set, .is_snapshot_safe = true, .is_special = true },
+    { .name = "shellstats", .function = builtin_shellstats },
+    { .name = "shift", .function = builtin_shift, .is_snapshot_safe = true, .is_special = true },
+    { .name = "tee", .function = builtin_tee, .is_snapshot_safe = true },
+    { .name = "timeout", .function = builtin_timeout },
+    { .name = "true", .function = builtin_true, .is_snapshot_safe = true, .is_side_effect_free = true },
+    { .name = "unset", .function = builtin_unset, .is_snapshot_safe = true, .is_special = true },
+};
+
+// Parses the optional count taken by break, continue and shift.
+std::optional<unsigned> parse_count(std::string_view utility, std::vector<std::string> const& argv, long minimum)
+{
+    if (argv.size() > 2) {
+        std::cerr << utility << ": too many arguments\n";
+        return std::nullopt;
+    }
+    if (argv.size() == 1)
+        return 1;
+
+    char* end = nullptr;
+    auto count = std::strtol(argv[1].c_str(), &end, 10);
+    if (argv[1].empty() || *end != '\0' || count < minimum) {
+        std::cerr << utility << ": " << argv[1] << ": count must be an integer no less than " << minimum << "\n";
+        return std::nullopt;
+    }
+
+    return static_cast<unsigned>(std::min<long>(count, std::numeric_limits<unsigned>::max()));
+}
+
+// Arms a timer to fire once after the duration, where 0 and the longest duration leave
+// it disarmed.
+bool arm_timer(int timer_fd, std::chrono::nanoseconds duration)
+{
+    struct itimerspec spec {};
+    if (duration != std::chrono::nanoseconds::max()) {
+        spec.it_value.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(duration).count();
+        spec.it_value.tv_nsec = (duration % std::chrono::seconds { 1 }).count();
+    }
+    return timerfd_settime(timer_fd, 0, &spec, nullptr) == 0;
+}
+
+enum DirectoryOption {
+    Logical,
+    Physical,
+};
+
+constexpr std::array<OptionSpec, 2> directory_options { {
+    { .short_name = 'L', .long_name = "logical" },
+    { .short_name = 'P', .long_name = "physical" },
+} };
+
+// Parses the -L and -P options taken by cd and pwd, returning the index of the first
+// operand and whether -P won.
+std::optional<std::pair<size_t, bool>> parse_directory_options(std::vector<std::string> const& argv)
+{
+    auto options = parse_options<directory_options>(argv);
+    if (!options.has_value())
+        return std::nullopt;
+
+    auto is_physical = (*options)[Physical].position > (*options)[Logical].position;
+    return std::pair { options->first_operand, is_physical };
+}
+
+// Opens the directory cd would change to (steps 3 through 8), leaving errno set if
+// there's no such directory.
+std::optional<WorkingDirectory> resolve_directory(Shell& shell, std::string const& operand, bool is_physical, bool& used_cdpath)
+{
+    auto const& current = shell.working_directory();
+
+    // With -L, dot-dot components are resolved against the logical pathname rather than
+    // the directory's real parent. Should the logical pathname have gone stale (e.g.
+    // because a directory was renamed), the directory that's still open is used instead.
+    auto open = [&](std::string const& path) -> std::optional<WorkingDirectory> {
+        if (!is_physical) {
+            auto logical_path = WorkingDirectory::canonicalize_lexically(path.starts_with('/') ? path : current.path() + "/" + path);
+            if (auto directory = current.open(logical_path, logical_path); directory.has_value())
+                return directory;
+        }
+        return current.open(path, std::nullopt);
+    };
+
+    if (operand.empty()) {
+        errno = ENOENT;
+        return std::nullopt;
+    }
+
+    // 4. If the first component of the directory operand is dot or dot-dot, the
+    // directory is found without CDPATH.
+    auto first_component = std::string_view { operand }.substr(0, operand.find('/'));
+    auto const* cdpath = shell.variables().find("CDPATH");
+
+    if (cdpath != nullptr && !operand.starts_with('/') && first_component != "." && first_component != "..") {
+        // 5. Try each of the pathnames in CDPATH in turn, where an empty one means the
+        // current directory.
+        std::string_view entries = cdpath->value;
+        while (true) {
+            auto colon = entries.find(':');
+            auto entry = entries.substr(0, colon);
+
+            std::string candidate { entry.empty() ? "." : entry };
+            if (!candidate.ends_with('/'))
+                candidate += '/';
+            candidate += operand;
+
+            if (auto directory = open(candidate); directory.has_value()) {
+                used_cdpath = !entry.empty();
+                return directory;
+            }
+
+            if (colon == std::string_view::npos)
+                break;
+            entries.remove_prefix(colon + 1);
+        }
+    }
+
+    return open(operand);
+}
+
+void print_directory_stack(Shell& shell)
+{
+    std::cout << shell.working_directory().path();
+
+    auto const& stack = shell.directory_stack();
+    for (auto it = stack.rbegin(); it != stack.rend(); it++)
+        std::cout << ' ' << it->path();
+    std::cout << "\n";
+}
+
+// The builtins above, along with those loaded since, by name. The nodes stay put, so a
+// builtin can be held on to while it runs even if it changes the others.
+std::map<std::string_view, Builtin, std::less<>>& registry()
+{
+    static auto registry = [] {
+        std::map<std::string_view, Builtin, std::less<>> registry;
+        for (auto const& builtin : builtins)
+            registry.emplace(builtin.name, builtin);
+        return registry;
+    }();
+    return registry;
+}
+
+} // namespace
+
+std::optional<int> parse_signal(std::string_view text)
+{
+    int number = 0;
+    if (auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), number); error == std::errc {} && end == text.data() + text.size())
+        return number > 0 && number < NSIG ? std::optional { number } : std::nullopt;
+
+    if (text.starts_with("SIG"))
+        text.remove_prefix(3);
+    for (int signal = 1; signal < NSIG; signal++) {
+        if (auto const* name = sigabbrev_np(signal); name != nullptr && text == name)
+            return signal;
+    }
+    return std::nullopt;
+}
+
+std::optional<std::chrono::nanoseconds> parse_duration(std::string_view text)
+{
+    double multiplier = 1;
+    if (!text.empty()) {
+        switch (text.back()) {
+        case 'd':
+            multiplier *= 24;
+            [[fallthrough]];
+        case 'h':
+            multiplier *= 60;
+            [[fallthrough]];
+        case 'm':
+            multiplier *= 60;
+            [[fallthrough]];
+        case 's':
+            text.remove_suffix(1);
+            break;
+        default:
+            break;
+        }
+    }
+
+    double seconds = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), seconds);
+    if (text.empty() || error != std::errc {} || end != text.data() + text.size() || !(seconds >= 0))
+        return std::nullopt;
+
+    // Anything too long to represent never runs out.
+    seconds *= multiplier;
+    if (seconds * 1e9 >= static_cast<double>(std::numeric_limits<int64_t>::max()))
+        return std::chrono::nanoseconds::max();
+    return std::chrono::nanoseconds { static_cast<int64_t>(std::ceil(seconds * 1e9)) };
+}
+
+std::optional<size_t> parse_size(std::string_view text)
+{
+    size_t size = 0;
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), size);
+    if (error != std::errc {})
+        return std::nullopt;
+
+    auto suffix = text.substr(end - text.data());
+    size_t multiplier = 1;
+    if (suffix == "K" || suffix == "k")
+        multiplier = 1024;
+    else if (suffix == "M" || suffix == "m")
+        multiplier = 1024 * 1024;
+    else if (suffix == "G" || suffix == "g")
+        multiplier = 1024 * 1024 * 1024;
+    else if (!suffix.empty())
+        return std::nullopt;
+
+    if (size > std::numeric_limits<size_t>::max() / multiplier)
+        return std::nullopt;
+    return size * multiplier;
+}
+
+size_t pipe_max_size()
+{
+    std::ifstream file { "/proc/sys/fs/pipe-max-size" };
+    size_t size = 0;
+    if (file >> size)
+        return size;
+
+    // The kernel's default, should procfs be missing.
+    return 1024 * 1024;
+}
+
+Builtin const* find_builtin(std::string_view name)
+{
+    auto it = registry().find(name);
+    return it != registry().end() ? &it->second : nullptr;
+}
+
+std::vector<Builtin const*> all_builtins()
+{
+    std::vector<Builtin const*> all;
+    all.reserve(registry().size());
+    for (auto const& [name, builtin] : registry())
+        all.push_back(&builtin);
+    return all;
+}
+
+bool register_builtin(Builtin builtin)
+{
+    return registry().emplace(builtin.name, builtin).second;
+}
+
+void unregister_builtin(std::string_view name)
+{
+    if (auto it = registry().find(name); it != registry().end())
+        registry().erase(it);
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#break
+int builtin_break(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto count = parse_count("break", argv, 1);
+    if (!count.has_value())
+        return 1;
+
+    // If n is greater than the number of enclosing loops, the outermost enclosing loop
+    // shall be exited.
+    if (shell.loop_depth() > 0)
+        shell.request_break(std::min(count.value(), shell.loop_depth()));
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/cat.html
+int builtin_cat(Shell&, std::vector<std::string> const& argv)
+{
+    static constexpr std::array<OptionSpec, 1> cat_options { {
+        // Nothing is buffered anyway, so -u changes nothing.
+        { .short_name = 'u' },
+    } };
+
+    auto options = parse_options<cat_options>(argv);
+    if (!options.has_value())
+        return 1;
+
+    std::vector<std::string> operands { argv.begin() + options->first_operand, argv.end() };
+    if (operands.empty())
+        operands.emplace_back("-");
+
+    struct stat out_stat {};
+    bool is_output_regular = fstat(STDOUT_FILENO, &out_stat) == 0 && S_ISREG(out_stat.st_mode);
+    int const out_fd = STDOUT_FILENO;
+    int rc = 0;
+
+    for (auto const& operand : operands) {
+        bool is_stdin = operand == "-";
+        int fd = is_stdin ? STDIN_FILENO : open(operand.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "cat: " << operand << ": " << strerror(errno) << "\n";
+            rc = 1;
+            continue;
+        }
+
+        // Otherwise the output would keep growing as fast as it's read.
+        struct stat in_stat {};
+        if (is_output_regular && fstat(fd, &in_stat) == 0 && in_stat.st_dev == out_stat.st_dev && in_stat.st_ino == out_stat.st_ino) {
+            std::cerr << "cat: " << operand << ": input file is output file\n";
+            if (!is_stdin)
+                close(fd);
+            rc = 1;
+            continue;
+        }
+
+        auto result = copy_data(fd, { &out_fd, 1 });
+        if (!is_stdin)
+            close(fd);
+
+        if (result.write_errors.front() != 0) {
+            std::cerr << "cat: write error: " << strerror(result.write_errors.front()) << "\n";
+            return 1;
+        }
+        if (result.read_error != 0) {
+            std::cerr << "cat: " << operand << ": " << strerror(result.read_error) << "\n";
+            rc = 1;
+        }
+    }
+
+    return rc;
+}
+
 // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/cd.html#tag_20_14
-int builtin_cd(std::vector<std::string> const& argv)
+int builtin_cd(Shell& shell, std::vector<std::string> const& argv)
 {
-    /// TODO: A custom argument parser is needed for this utility.
+    auto options = parse_directory_options(argv);
+    if (!options.has_value())
+        return 2;
 
-    if (argv.empty() || argv.size() > 2)
+    auto [first_operand, is_physical] = options.value();
+    if (argv.size() - first_operand > 1) {
+        std::cerr << "cd: too many arguments\n";
         return 1;
+    }
 
-    std::string path;
+    auto& variables = shell.variables();
+    std::string operand;
+    bool should_print = false;
 
-    if (argv.size() == 1) {
-        if (auto* home = std::getenv("HOME"); home != nullptr) {
-            path = home;
-        } else {
-            std::cerr << "failed to get $HOME: " << strerror(errno) << "\n";
+    // 1. If no directory operand is given and the HOME environment variable is empty or
+    // undefined, the default behavior is implementation-defined.
+    if (first_operand == argv.size()) {
+        auto const* home = variables.find("HOME");
+        if (home == nullptr || home->value.empty()) {
+            std::cerr << "cd: HOME not set\n";
             return 1;
         }
+        operand = home->value;
     } else {
-        path = argv.at(1);
+        operand = argv[first_operand];
     }
 
-    /// FIXME: Implement step 5 (utilizing CDPATH env var).
-    /// FIXME: Implement step 7 once an argument parser has been implemented.
+    if (operand == "-") {
+        auto const* old_pwd = variables.find("OLDPWD");
+        if (old_pwd == nullptr) {
+            std::cerr << "cd: OLDPWD not set\n";
+            return 1;
+        }
+        operand = old_pwd->value;
+        should_print = true;
+    }
 
-    auto const* pwd = std::getenv("PWD");
-    if (pwd == nullptr) {
-        std::cerr << "failed to get $PWD: " << strerror(errno) << "\n";
+    bool used_cdpath = false;
+    auto directory = resolve_directory(shell, operand, is_physical, used_cdpath);
+    if (!directory.has_value()) {
+        std::cerr << "cd: " << operand << ": " << strerror(errno) << "\n";
         return 1;
     }
 
-    auto using_old_pwd = false;
-    if (path == "-") {
-        auto const* old_pwd = std::getenv("OLDPWD");
-        if (old_pwd == nullptr) {
-            std::cerr << "$OLDPWD is not set\n";
+    if (!shell.change_directory(std::move(directory.value())).has_value()) {
+        std::cerr << "cd: " << operand << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+
+    // (cd, step 5) If a non-empty directory name from CDPATH is used, an absolute
+    // pathname of the new working directory shall be written to the standard output.
+    if (should_print || used_cdpath)
+        std::cout << shell.working_directory().path() << "\n";
+
+    return 0;
+}
+
+int builtin_dirs(Shell& shell, std::vector<std::string> const&)
+{
+    print_directory_stack(shell);
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/echo.html
+int builtin_echo(Shell&, std::vector<std::string> const& argv)
+{
+    /// NOTE: Like most shells, we accept "-n" to suppress the trailing newline and don't
+    // interpret escape sequences.
+    size_t first = 1;
+    bool print_newline = true;
+
+    if (argv.size() > 1 && argv[1] == "-n") {
+        print_newline = false;
+        first = 2;
+    }
+
+    for (size_t i = first; i < argv.size(); i++) {
+        if (i != first)
+            std::cout << ' ';
+        std::cout << argv[i];
+    }
+    if (print_newline)
+        std::cout << '\n';
+
+    return 0;
+}
+
+// https://www.gnu.org/software/bash/manual/html_node/Bash-Builtins.html#index-enable
+// Only for loading builtins with -f and removing them with -d, as nothing else can be
+// disabled.
+int builtin_enable(Shell&, std::vector<std::string> const& argv)
+{
+    enum EnableOption {
+        Delete,
+        File,
+    };
+    static constexpr std::array<OptionSpec, 2> enable_options { {
+        { .short_name = 'd', .long_name = "delete" },
+        { .short_name = 'f', .long_name = "file", .has_argument = true },
+    } };
+
+    auto options = parse_options<enable_options>(argv);
+    if (!options.has_value())
+        return 2;
+
+    std::span<std::string const> names { argv.begin() + options->first_operand, argv.end() };
+
+    if ((*options)[File].is_present()) {
+        if (names.empty()) {
+            std::cerr << "enable: usage: enable -f FILE NAME...\n";
+            return 2;
+        }
+        if (auto error = load_builtins(std::string { (*options)[File].argument }, names); error.has_value()) {
+            std::cerr << "enable: " << error.value() << "\n";
             return 1;
         }
-        path = old_pwd;
-        using_old_pwd = true;
+        return 0;
+    }
+
+    int rc = 0;
+    if ((*options)[Delete].is_present()) {
+        for (auto const& name : names) {
+            if (!unload_builtin(name)) {
+                std::cerr << "enable: " << name << ": not a loaded builtin\n";
+                rc = 1;
+            }
+        }
+        return rc;
+    }
+
+    if (names.empty()) {
+        for (auto const* builtin : all_builtins())
+            std::cout << "enable " << builtin->name << "\n";
+        return 0;
     }
 
-    std::error_code ec;
+    for (auto const& name : names) {
+        if (find_builtin(name) == nullptr) {
+            std::cerr << "enable: " << name << ": not a shell builtin\n";
+            rc = 1;
+        }
+    }
+    return rc;
+}
 
-    path = std::filesystem::canonical(path, ec);
-    if (ec) {
-        std::cerr << "failed to create canonical path: " << ec.message() << "\n";
+int builtin_popd(Shell& shell, std::vector<std::string> const& argv)
+{
+    if (argv.size() > 1) {
+        std::cerr << "popd: too many arguments\n";
         return 1;
     }
 
-    auto new_pwd = path;
+    auto& stack = shell.directory_stack();
+    if (stack.empty()) {
+        std::cerr << "popd: directory stack empty\n";
+        return 1;
+    }
 
-    path = std::filesystem::relative(path, pwd, ec);
-    if (ec) {
-        std::cerr << "failed to create relative path: " << ec.message() << "\n";
+    // The saved directory is still open, so going back to it is a single fchdir(2).
+    if (!shell.change_directory(std::move(stack.back())).has_value()) {
+        std::cerr << "popd: " << stack.back().path() << ": " << strerror(errno) << "\n";
         return 1;
     }
-    if (chdir(path.c_str()) == -1) {
-        std::cerr << path << ": " << strerror(errno) << "\n";
+    stack.pop_back();
+
+    print_directory_stack(shell);
+    return 0;
+}
+
+int builtin_pushd(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto& stack = shell.directory_stack();
+    std::optional<WorkingDirectory> directory;
+
+    if (argv.size() > 2) {
+        std::cerr << "pushd: too many arguments\n";
         return 1;
     }
-    if (using_old_pwd)
-        std::cout << new_pwd << "\n";
 
-    setenv("PWD", new_pwd.c_str(), 1);
-    setenv("OLDPWD", pwd, 1);
+    // With no operand, the two topmost directories swap places.
+    if (argv.size() == 1) {
+        if (stack.empty()) {
+            std::cerr << "pushd: no other directory\n";
+            return 1;
+        }
+        directory = std::move(stack.back());
+        stack.pop_back();
+    } else {
+        bool used_cdpath = false;
+        directory = resolve_directory(shell, argv[1], false, used_cdpath);
+        if (!directory.has_value()) {
+            std::cerr << "pushd: " << argv[1] << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+    }
+
+    auto path = directory->path();
+    auto previous = shell.change_directory(std::move(directory.value()));
+    if (!previous.has_value()) {
+        std::cerr << "pushd: " << path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    stack.push_back(std::move(previous.value()));
 
+    print_directory_stack(shell);
     return 0;
 }
 
 // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/pwd.html
-int builtin_pwd(std::vector<std::string> const&)
+int builtin_pwd(Shell& shell, std::vector<std::string> const& argv)
 {
-    // TODO: Implement -L and -P options.
+    auto options = parse_directory_options(argv);
+    if (!options.has_value())
+        return 2;
 
-    auto const* pwd = std::getenv("PWD");
-    if (pwd == nullptr) {
-        std::cerr << "failed to get $PWD: " << strerror(errno) << "\n";
+    auto [first_operand, is_physical] = options.value();
+    if (first_operand != argv.size()) {
+        std::cerr << "pwd: too many arguments\n";
         return 1;
     }
 
-    std::error_code ec;
-    auto path = std::filesystem::canonical(pwd, ec);
-    if (ec) {
-        std::cerr << pwd << ": " << ec.message() << "\n";
+    // The shell keeps track of both names, so neither needs the file system.
+    auto const& working_directory = shell.working_directory();
+    auto path = is_physical ? working_directory.physical_path() : working_directory.path();
+    if (!path.has_value() || path->empty()) {
+        std::cerr << "pwd: cannot determine the working directory\n";
         return 1;
     }
 
-    std::cout << path.string() << "\n";
+    std::cout << path.value() << "\n";
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#set
+// Only the options below are known, and without arguments nothing is written, where POSIX
+// lists the variables.
+int builtin_set(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto& options = shell.options();
+    struct NamedOption {
+        std::string_view name;
+        char short_name;
+        bool& value;
+    };
+    NamedOption named_options[] = {
+        { "globstar", 0, options.globstar },
+        { "noglob", 'f', options.noglob },
+        { "profile", 0, options.profile },
+        { "autoparallel", 0, options.autoparallel },
+        { "argbatch", 0, options.argbatch },
+    };
+
+    if (argv.size() <= 1)
+        return 0;
+
+    for (size_t i = 1; i < argv.size(); i++) {
+        auto const& arg = argv[i];
+
+        // The arguments after "--", or from the first one that isn't an option on, replace
+        // the positional parameters, so that "set --" unsets them all.
+        if (arg == "--" || arg == "-" || (!arg.starts_with('-') && !arg.starts_with('+'))) {
+            auto first = arg == "--" || arg == "-" ? i + 1 : i;
+            shell.positional_parameters().assign(argv.begin() + first, argv.end());
+            return 0;
+        }
+        if (arg.size() < 2) {
+            std::cerr << "set: " << arg << ": invalid option\n";
+            return 2;
+        }
+
+        bool enable = arg[0] == '-';
+
+        if (arg == "-o" || arg == "+o") {
+            // With no option name, report the current settings.
+            if (i + 1 == argv.size()) {
+                for (auto const& option : named_options) {
+                    if (enable)
+                        std::cout << option.name << "\t" << (option.value ? "on" : "off") << "\n";
+                    else
+                        std::cout << "set " << (option.value ? "-o " : "+o ") << option.name << "\n";
+                }
+                if (enable && options.pipe_size > 0)
+                    std::cout << "pipesize\t" << options.pipe_size << "\n";
+                else if (enable)
+                    std::cout << "pipesize\tdefault\n";
+                else if (options.pipe_size > 0)
+                    std::cout << "set -o pipesize=" << options.pipe_size << "\n";
+                else
+                    std::cout << "set +o pipesize\n";
+                continue;
+            }
+
+            std::string_view name = argv[++i];
+            std::optional<std::string_view> value;
+            if (auto equals = name.find('='); equals != std::string_view::npos) {
+                value = name.substr(equals + 1);
+                name = name.substr(0, equals);
+            }
+
+            // The pipe size is given as "-o pipesize=1M", and "+o pipesize" restores the
+            // default.
+            if (name == "pipesize") {
+                if (!enable) {
+                    options.pipe_size = 0;
+                    continue;
+                }
+
+                if (!value.has_value()) {
+                    std::cerr << "set: pipesize: size required, e.g. pipesize=1M\n";
+                    return 2;
+                }
+                auto size = parse_size(value.value());
+                if (!size.has_value() || size.value() == 0) {
+                    std::cerr << "set: pipesize: invalid size: " << value.value() << '\n';
+                    return 2;
+                }
+                options.pipe_size = std::min(size.value(), pipe_max_size());
+                continue;
+            }
+
+            // The profile is written to "-o profile=PATH" when the shell exits, or else to
+            // ratsh.profile in the directory the profile was started in.
+            if (name == "profile" && enable) {
+                if (value.has_value() || shell.profiler().output_path().empty()) {
+                    std::string path { value.value_or("ratsh.profile") };
+                    if (path.empty()) {
+                        std::cerr << "set: profile: path required, e.g. profile=out.profile\n";
+                        return 2;
+                    }
+                    if (!path.starts_with('/'))
+                        path = shell.working_directory().path() + "/" + path;
+                    shell.profiler().set_output_path(std::move(path));
+                }
+                value.reset();
+            }
+
+            // "-o autoparallel=N" runs at most N commands at once, instead of one per
+            // processor.
+            if (name == "autoparallel" && enable && value.has_value()) {
+                unsigned jobs = 0;
+                auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), jobs);
+                if (error != std::errc {} || end != value->data() + value->size() || jobs == 0) {
+                    std::cerr << "set: autoparallel: number of jobs required, e.g. autoparallel=4\n";
+                    return 2;
+                }
+                options.autoparallel_jobs = jobs;
+                value.reset();
+            }
+
+            // "-o argbatch=N" runs up to N batches at once, where they otherwise run one
+            // after the other.
+            if (name == "argbatch" && enable) {
+                unsigned jobs = 1;
+                if (value.has_value()) {
+                    auto [end, error] = std::from_chars(value->data(), value->data() + value->size(), jobs);
+                    if (error != std::errc {} || end != value->data() + value->size() || jobs == 0) {
+                        std::cerr << "set: argbatch: number of jobs required, e.g. argbatch=4\n";
+                        return 2;
+                    }
+                }
+                options.argbatch_jobs = jobs;
+                value.reset();
+            }
+
+            auto* it = std::find_if(std::begin(named_options), std::end(named_options), [&name](auto const& option) {
+                return option.name == name;
+            });
+            if (it == std::end(named_options) || value.has_value()) {
+                std::cerr << "set: " << argv[i] << ": invalid option name\n";
+                return 2;
+            }
+            it->value = enable;
+            continue;
+        }
+
+        for (auto short_name : std::string_view { arg }.substr(1)) {
+            auto* it = std::find_if(std::begin(named_options), std::end(named_options), [short_name](auto const& option) {
+                return option.short_name == short_name;
+            });
+            if (it == std::end(named_options)) {
+                std::cerr << "set: -" << short_name << ": invalid option\n";
+                return 2;
+            }
+            it->value = enable;
+        }
+    }
 
     return 0;
 }
 
+// https://www.gnu.org/software/bash/manual/html_node/Programmable-Completion-Builtins.html
+// Lists what a word could be completed to, e.g. "compgen -c gi" for command names or
+// "compgen -f src/" for pathnames.
+int builtin_compgen(Shell& shell, std::vector<std::string> const& argv)
+{
+    enum CompgenOption {
+        Command,
+        File,
+    };
+    static constexpr std::array<OptionSpec, 2> compgen_options { {
+        { .short_name = 'c', .long_name = "command" },
+        { .short_name = 'f', .long_name = "file" },
+    } };
+
+    auto options = parse_options<compgen_options>(argv);
+    if (!options.has_value())
+        return 2;
+    if (argv.size() - options->first_operand > 1) {
+        std::cerr << "compgen: too many arguments\n";
+        return 2;
+    }
+    if (!(*options)[Command].is_present() && !(*options)[File].is_present()) {
+        std::cerr << "compgen: -c or -f required\n";
+        return 2;
+    }
+
+    std::string_view word;
+    if (options->first_operand < argv.size())
+        word = argv[options->first_operand];
+
+    auto& completion = shell.completion();
+    std::vector<std::string> names;
+
+    if ((*options)[Command].is_present()) {
+        auto const* path = shell.variables().find("PATH");
+        completion.update(path != nullptr ? std::string_view { path->value } : std::string_view {});
+        names = completion.complete_command(word);
+
+        // There are few enough functions to go through them all.
+        auto builtin_count = names.size();
+        for (auto const& [name, body] : shell.functions()) {
+            if (name.starts_with(word))
+                names.push_back(name);
+        }
+        if (names.size() > builtin_count) {
+            std::sort(names.begin(), names.end());
+            names.erase(std::unique(names.begin(), names.end()), names.end());
+        }
+    }
+    if ((*options)[File].is_present()) {
+        auto pathnames = completion.complete_pathname(word);
+        names.insert(names.end(), std::make_move_iterator(pathnames.begin()), std::make_move_iterator(pathnames.end()));
+    }
+
+    for (auto const& name : names)
+        std::cout << name << "\n";
+    return names.empty() ? 1 : 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#continue
+int builtin_continue(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto count = parse_count("continue", argv, 1);
+    if (!count.has_value())
+        return 1;
+
+    if (shell.loop_depth() > 0)
+        shell.request_continue(std::min(count.value(), shell.loop_depth()));
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#exec
+int builtin_exec(Shell&, std::vector<std::string> const&)
+{
+    // With a command, the shell runs it in place of itself instead of calling this.
+    // Without one, the shell keeps the redirections once this returns.
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#exit
+int builtin_exit(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto code = shell.last_exit_status();
+
+    if (argv.size() > 2) {
+        std::cerr << "exit: too many arguments\n";
+        return 1;
+    }
+    if (argv.size() == 2) {
+        char* end = nullptr;
+        auto value = std::strtol(argv[1].c_str(), &end, 10);
+        if (argv[1].empty() || *end != '\0') {
+            std::cerr << "exit: " << argv[1] << ": numeric argument required\n";
+            value = 2;
+        }
+        code = static_cast<int>(value & 0xff);
+    }
+
+    shell.request_exit(code);
+    return code;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#export
+int builtin_export(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto& variables = shell.variables();
+
+    if (argv.size() == 1 || (argv.size() == 2 && argv[1] == "-p")) {
+        for (auto const& [name, variable] : variables.all()) {
+            if (variable.is_exported)
+                std::cout << "export " << name << "='" << variable.value << "'\n";
+        }
+        return 0;
+    }
+
+    int rc = 0;
+    for (size_t i = 1; i < argv.size(); i++) {
+        auto const& arg = argv[i];
+        auto equals = arg.find('=');
+        auto name = arg.substr(0, equals);
+
+        if (!Variables::is_valid_name(name)) {
+            std::cerr << "export: " << arg << ": not a valid identifier\n";
+            rc = 1;
+            continue;
+        }
+
+        if (equals != std::string::npos)
+            variables.set(name, arg.substr(equals + 1));
+        variables.export_variable(name);
+    }
+
+    return rc;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/read.html
+int builtin_read(Shell& shell, std::vector<std::string> const& argv)
+{
+    enum ReadOption {
+        Delimiter,
+        Raw,
+    };
+    static constexpr std::array<OptionSpec, 2> read_options { {
+        { .short_name = 'd', .long_name = "delimiter", .has_argument = true },
+        { .short_name = 'r', .long_name = "raw" },
+    } };
+
+    auto options = parse_options<read_options>(argv);
+    if (!options.has_value())
+        return 2;
+
+    // An empty delimiter reads up to a NUL byte.
+    char delimiter = '\n';
+    if ((*options)[Delimiter].is_present())
+        delimiter = (*options)[Delimiter].argument.empty() ? '\0' : (*options)[Delimiter].argument[0];
+    bool is_raw = (*options)[Raw].is_present();
+
+    /// NOTE: Like most shells, REPLY is assigned if no variable is named.
+    std::vector<std::string> names { argv.begin() + options->first_operand, argv.end() };
+    if (names.empty())
+        names.emplace_back("REPLY");
+
+    for (auto const& name : names) {
+        if (!Variables::is_valid_name(name)) {
+            std::cerr << "read: " << name << ": not a valid identifier\n";
+            return 2;
+        }
+    }
+
+    auto line = read_line(STDIN_FILENO, delimiter, is_raw);
+    if (!line.has_value()) {
+        std::cerr << "read: " << strerror(errno) << "\n";
+        return 2;
+    }
+
+    std::string_view ifs = " \t\n";
+    if (auto const* variable = shell.variables().find("IFS"); variable != nullptr)
+        ifs = variable->value;
+
+    auto fields = split_line(line.value(), ifs, names.size());
+    for (size_t i = 0; i < names.size(); i++)
+        shell.variables().set(names[i], std::move(fields[i]));
+
+    // An end-of-file before the delimiter still assigns what was read.
+    return line->found_delimiter ? 0 : 1;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#return
+int builtin_return(Shell& shell, std::vector<std::string> const& argv)
+{
+    if (shell.function_depth() == 0) {
+        std::cerr << "return: can only be used in a function\n";
+        return 1;
+    }
+    if (argv.size() > 2) {
+        std::cerr << "return: too many arguments\n";
+        return 1;
+    }
+
+    auto code = shell.last_exit_status();
+    if (argv.size() == 2) {
+        char* end = nullptr;
+        auto value = std::strtol(argv[1].c_str(), &end, 10);
+        if (argv[1].empty() || *end != '\0') {
+            std::cerr << "return: " << argv[1] << ": numeric argument required\n";
+            value = 2;
+        }
+        code = static_cast<int>(value & 0xff);
+    }
+
+    shell.request_return(code);
+    return code;
+}
+
+// Lists the latest entries of the history, e.g. "history 20", the entries that start with
+// a prefix with "history -p make", or those that contain some text with "history -s ssh".
+int builtin_history(Shell& shell, std::vector<std::string> const& argv)
+{
+    enum HistoryOption {
+        Compact,
+        Prefix,
+        Search,
+    };
+    static constexpr std::array<OptionSpec, 3> history_options { {
+        { .short_name = 'c', .long_name = "compact" },
+        { .short_name = 'p', .long_name = "prefix", .has_argument = true },
+        { .short_name = 's', .long_name = "search", .has_argument = true },
+    } };
+
+    auto options = parse_options<history_options>(argv);
+    if (!options.has_value())
+        return 2;
+    if (argv.size() - options->first_operand > 1) {
+        std::cerr << "history: too many arguments\n";
+        return 2;
+    }
+
+    auto& history = shell.history();
+    if (!history.has_value()) {
+        std::cerr << "history: no history file is open\n";
+        return 1;
+    }
+
+    auto print = [&history](size_t index) {
+        std::cout << std::setw(6) << index + 1 << "  " << history->entry(index) << "\n";
+    };
+
+    if ((*options)[Compact].is_present()) {
+        if (!history->compact()) {
+            std::cerr << "history: " << history->path() << ": " << strerror(errno) << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    if ((*options)[Prefix].is_present()) {
+        for (auto index : history->with_prefix((*options)[Prefix].argument, SIZE_MAX))
+            print(index);
+        return 0;
+    }
+
+    if ((*options)[Search].is_present()) {
+        auto text = (*options)[Search].argument;
+        for (auto index = history->search_backward(text, SIZE_MAX); index.has_value(); index = history->search_backward(text, index.value()))
+            print(index.value());
+        return 0;
+    }
+
+    if (!history->refresh())
+        return 1;
+
+    auto count = history->size();
+    if (options->first_operand < argv.size()) {
+        auto const& operand = argv[options->first_operand];
+        char* end = nullptr;
+        auto value = std::strtoull(operand.c_str(), &end, 10);
+        if (operand.empty() || *end != '\0') {
+            std::cerr << "history: " << operand << ": numeric argument required\n";
+            return 2;
+        }
+        count = std::min<size_t>(count, value);
+    }
+
+    for (auto index = history->size() - count; index < history->size(); index++)
+        print(index);
+    return 0;
+}
+
+// Reports how much work the shell has done, e.g. "shellstats --json", or sets up a
+// report for when it exits with "shellstats -x".
+int builtin_shellstats(Shell& shell, std::vector<std::string> const& argv)
+{
+    enum ShellstatsOption {
+        AtExit,
+        Json,
+        NotAtExit,
+        Reset,
+    };
+    static constexpr std::array<OptionSpec, 4> shellstats_options { {
+        { .short_name = 'x', .long_name = "at-exit" },
+        { .short_name = 'j', .long_name = "json" },
+        { .short_name = 'X', .long_name = "not-at-exit" },
+        { .short_name = 'r', .long_name = "reset" },
+    } };
+
+    auto options = parse_options<shellstats_options>(argv);
+    if (!options.has_value())
+        return 2;
+    if (options->first_operand != argv.size()) {
+        std::cerr << "shellstats: too many arguments\n";
+        return 2;
+    }
+
+    auto& statistics = shell.statistics();
+    auto format = (*options)[Json].is_present() ? Statistics::Format::Json : Statistics::Format::Text;
+    bool should_report = true;
+
+    if ((*options)[AtExit].is_present() || (*options)[NotAtExit].is_present()) {
+        auto at_exit = (*options)[AtExit].position > (*options)[NotAtExit].position;
+        statistics.set_report_at_exit(at_exit ? std::optional { format } : std::nullopt);
+        should_report = false;
+    }
+    if ((*options)[Reset].is_present()) {
+        statistics.reset();
+        should_report = false;
+    }
+
+    if (should_report)
+        std::cout << statistics.report(format);
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#shift
+int builtin_shift(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto count = parse_count("shift", argv, 0);
+    if (!count.has_value())
+        return 1;
+
+    auto& parameters = shell.positional_parameters();
+    if (count.value() > parameters.size()) {
+        std::cerr << "shift: can't shift that many\n";
+        return 1;
+    }
+
+    parameters.erase(parameters.begin(), parameters.begin() + count.value());
+    return 0;
+}
+
+int builtin_false(Shell&, std::vector<std::string> const&)
+{
+    return 1;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/tee.html
+int builtin_tee(Shell&, std::vector<std::string> const& argv)
+{
+    enum TeeOption {
+        Append,
+        IgnoreInterrupts,
+    };
+    static constexpr std::array<OptionSpec, 2> tee_options { {
+        { .short_name = 'a', .long_name = "append" },
+        { .short_name = 'i', .long_name = "ignore-interrupts" },
+    } };
+
+    auto options = parse_options<tee_options>(argv);
+    if (!options.has_value())
+        return 1;
+
+    auto flags = O_WRONLY | O_CREAT | O_CLOEXEC | ((*options)[Append].is_present() ? O_APPEND : O_TRUNC);
+    std::vector<int> out_fds { STDOUT_FILENO };
+    std::vector<std::string_view> names { "standard output" };
+    int rc = 0;
+
+    for (size_t i = options->first_operand; i < argv.size(); i++) {
+        auto fd = open(argv[i].c_str(), flags, 0666);
+        if (fd < 0) {
+            std::cerr << "tee: " << argv[i] << ": " << strerror(errno) << "\n";
+            rc = 1;
+            continue;
+        }
+        out_fds.push_back(fd);
+        names.push_back(argv[i]);
+    }
+
+    bool ignores_interrupts = (*options)[IgnoreInterrupts].is_present();
+    struct sigaction ignore {};
+    struct sigaction saved {};
+    ignore.sa_handler = SIG_IGN;
+    if (ignores_interrupts)
+        sigaction(SIGINT, &ignore, &saved);
+
+    auto result = copy_data(STDIN_FILENO, out_fds);
+
+    if (ignores_interrupts)
+        sigaction(SIGINT, &saved, nullptr);
+
+    for (size_t i = 0; i < out_fds.size(); i++) {
+        if (result.write_errors[i] != 0) {
+            std::cerr << "tee: " << names[i] << ": " << strerror(result.write_errors[i]) << "\n";
+            rc = 1;
+        }
+        if (i > 0)
+            close(out_fds[i]);
+    }
+    if (result.read_error != 0) {
+        std::cerr << "tee: standard input: " << strerror(result.read_error) << "\n";
+        rc = 1;
+    }
+
+    return rc;
+}
+
+// https://www.gnu.org/software/coreutils/manual/html_node/timeout-invocation.html
+int builtin_timeout(Shell& shell, std::vector<std::string> const& argv)
+{
+    enum TimeoutOption {
+        KillAfter,
+        Signal,
+    };
+    static constexpr std::array<OptionSpec, 2> timeout_options { {
+        { .short_name = 'k', .long_name = "kill-after", .has_argument = true },
+        { .short_name = 's', .long_name = "signal", .has_argument = true },
+    } };
+
+    // As with coreutils, failures of timeout itself are told apart from the command's.
+    constexpr int failure_status = 125;
+    constexpr int timed_out_status = 124;
+
+    auto options = parse_options<timeout_options>(argv);
+    if (!options.has_value())
+        return failure_status;
+    if (argv.size() - options->first_operand < 2) {
+        std::cerr << "timeout: usage: timeout [-s SIGNAL] [-k DURATION] DURATION COMMAND [ARGUMENT...]\n";
+        return failure_status;
+    }
+
+    int signal = SIGTERM;
+    if ((*options)[Signal].is_present()) {
+        auto parsed = parse_signal((*options)[Signal].argument);
+        if (!parsed.has_value()) {
+            std::cerr << "timeout: " << (*options)[Signal].argument << ": invalid signal\n";
+            return failure_status;
+        }
+        signal = parsed.value();
+    }
+
+    std::chrono::nanoseconds kill_after {};
+    if ((*options)[KillAfter].is_present()) {
+        auto parsed = parse_duration((*options)[KillAfter].argument);
+        if (!parsed.has_value()) {
+            std::cerr << "timeout: " << (*options)[KillAfter].argument << ": invalid time interval\n";
+            return failure_status;
+        }
+        kill_after = parsed.value();
+    }
+
+    auto const& duration_text = argv[options->first_operand];
+    auto duration = parse_duration(duration_text);
+    if (!duration.has_value()) {
+        std::cerr << "timeout: " << duration_text << ": invalid time interval\n";
+        return failure_status;
+    }
+
+    auto timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        perror("timeout: timerfd_create");
+        return failure_status;
+    }
+    if (!arm_timer(timer_fd, duration.value())) {
+        perror("timeout: timerfd_settime");
+        close(timer_fd);
+        return failure_status;
+    }
+
+    // The command leads a process group of its own, so a pipeline or script it starts
+    // is signalled as a whole.
+    auto pid = shell.start_command({ argv.begin() + options->first_operand + 1, argv.end() });
+    if (pid < 0) {
+        perror("timeout: fork");
+        close(timer_fd);
+        return failure_status;
+    }
+
+    // Without pidfds, the child is checked on every so often instead.
+    auto pid_fd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    constexpr int poll_interval_ms = 10;
+
+    bool has_timed_out = false;
+    bool has_killed = false;
+    while (true) {
+        if (pid_fd < 0) {
+            siginfo_t info {};
+            if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == pid)
+                break;
+        }
+
+        struct pollfd fds[2] = {
+            { .fd = timer_fd, .events = POLLIN, .revents = 0 },
+            { .fd = pid_fd, .events = POLLIN, .revents = 0 },
+        };
+        auto rc = poll(fds, pid_fd < 0 ? 1 : 2, pid_fd < 0 ? poll_interval_ms : -1);
+        if (rc < 0 && errno != EINTR) {
+            perror("timeout: poll");
+            break;
+        }
+        if (rc > 0 && (fds[1].revents & POLLIN) != 0)
+            break;
+        if (rc <= 0 || (fds[0].revents & POLLIN) == 0)
+            continue;
+
+        uint64_t expirations = 0;
+        if (read(timer_fd, &expirations, sizeof(expirations)) < 0)
+            continue;
+
+        // A stopped command couldn't act on the signal, so it's continued as well.
+        if (!has_timed_out) {
+            has_timed_out = true;
+            kill(-pid, signal);
+            if (signal != SIGKILL)
+                kill(-pid, SIGCONT);
+            if (kill_after.count() > 0 && signal != SIGKILL)
+                arm_timer(timer_fd, kill_after);
+        } else if (!has_killed) {
+            has_killed = true;
+            kill(-pid, SIGKILL);
+        }
+    }
+
+    close(timer_fd);
+    if (pid_fd >= 0)
+        close(pid_fd);
+
+    auto status = shell.wait_for_child(pid);
+    if (has_killed)
+        return 128 + SIGKILL;
+    if (has_timed_out)
+        return timed_out_status;
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+}
+
+int builtin_true(Shell&, std::vector<std::string> const&)
+{
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#unset
+int builtin_unset(Shell& shell, std::vector<std::string> const& argv)
+{
+    enum UnsetOption {
+        OnlyFunctions,
+        OnlyVariables,
+    };
+    static constexpr std::array<OptionSpec, 2> unset_options { {
+        { .short_name = 'f', .long_name = "functions" },
+        { .short_name = 'v', .long_name = "variables" },
+    } };
+
+    auto options = parse_options<unset_options>(argv);
+    if (!options.has_value())
+        return 2;
+
+    auto unset_functions = (*options)[OnlyFunctions].position > (*options)[OnlyVariables].position;
+
+    int rc = 0;
+    for (size_t i = options->first_operand; i < argv.size(); i++) {
+        auto const& name = argv[i];
+
+        if (!Variables::is_valid_name(name)) {
+            std::cerr << "unset: " << name << ": not a valid identifier\n";
+            rc = 1;
+            continue;
+        }
+
+        if (unset_functions)
+            shell.unset_function(name);
+        else
+            shell.variables().unset(name);
+    }
+
+    return rc;
+}
+
 } // namespace RatShell
\ No newline at end of file
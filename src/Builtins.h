@@ -1,4 +1,3 @@
-
 /*
  * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
  *
@@ -7,12 +6,74 @@
 
 #pragma once
 
+#include <chrono>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace RatShell {
 
-int builtin_cd(std::vector<std::string> const& argv);
-int builtin_pwd(std::vector<std::string> const& argv);
+class Shell;
+
+using BuiltinFunction = int (*)(Shell&, std::vector<std::string> const& argv);
+
+struct Builtin {
+    std::string_view name;
+    BuiltinFunction function { nullptr };
+    // Whether all of its effects on the shell are undone by restoring a snapshot of the
+    // shell, which lets subshells using it run without forking.
+    bool is_snapshot_safe { false };
+    // Whether it only writes to standard output and leaves the shell's state alone.
+    bool is_side_effect_free { false };
+    // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_14
+    // Special builtins are found before functions.
+    bool is_special { false };
+};
+
+Builtin const* find_builtin(std::string_view name);
+// In order of their names.
+std::vector<Builtin const*> all_builtins();
+
+// Adds a builtin, e.g. one loaded with enable -f, whose name must outlive it. Returns
+// false if there's already a builtin by that name.
+bool register_builtin(Builtin);
+void unregister_builtin(std::string_view name);
+
+// Parses a signal given by number or by name, with or without the "SIG" prefix.
+std::optional<int> parse_signal(std::string_view);
+// https://www.gnu.org/software/coreutils/manual/html_node/timeout-invocation.html
+// Parses a duration such as "1.5", "30s", "2m", "1h" or "1d", where 0 means none.
+std::optional<std::chrono::nanoseconds> parse_duration(std::string_view);
+// Parses a size in bytes such as "65536", "64K" or "1M".
+std::optional<size_t> parse_size(std::string_view);
+// The largest pipe an unprivileged process may ask for.
+size_t pipe_max_size();
+
+int builtin_break(Shell&, std::vector<std::string> const& argv);
+int builtin_cat(Shell&, std::vector<std::string> const& argv);
+int builtin_cd(Shell&, std::vector<std::string> const& argv);
+int builtin_compgen(Shell&, std::vector<std::string> const& argv);
+int builtin_continue(Shell&, std::vector<std::string> const& argv);
+int builtin_dirs(Shell&, std::vector<std::string> const& argv);
+int builtin_echo(Shell&, std::vector<std::string> const& argv);
+int builtin_enable(Shell&, std::vector<std::string> const& argv);
+int builtin_exec(Shell&, std::vector<std::string> const& argv);
+int builtin_exit(Shell&, std::vector<std::string> const& argv);
+int builtin_export(Shell&, std::vector<std::string> const& argv);
+int builtin_false(Shell&, std::vector<std::string> const& argv);
+int builtin_history(Shell&, std::vector<std::string> const& argv);
+int builtin_popd(Shell&, std::vector<std::string> const& argv);
+int builtin_pushd(Shell&, std::vector<std::string> const& argv);
+int builtin_pwd(Shell&, std::vector<std::string> const& argv);
+int builtin_read(Shell&, std::vector<std::string> const& argv);
+int builtin_return(Shell&, std::vector<std::string> const& argv);
+int builtin_set(Shell&, std::vector<std::string> const& argv);
+int builtin_shellstats(Shell&, std::vector<std::string> const& argv);
+int builtin_shift(Shell&, std::vector<std::string> const& argv);
+int builtin_tee(Shell&, std::vector<std::string> const& argv);
+int builtin_timeout(Shell&, std::vector<std::string> const& argv);
+int builtin_true(Shell&, std::vector<std::string> const& argv);
+int builtin_unset(Shell&, std::vector<std::string> const& argv);
 
 } // namespace RatShell
\ No newline at end of file
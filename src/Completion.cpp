@@ -0,0 +1,371 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Completion.h"
+#include "Builtins.h"
+#include "FileDescription.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace RatShell {
+
+namespace {
+
+// Calls the callback with the name and type of each entry but "." and "..", reading many
+// entries per system call.
+template<typename Callback>
+bool read_directory(int fd, Callback callback)
+{
+    alignas(struct dirent64) char buffer[32 * 1024];
+
+    while (true) {
+        auto nread = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread < 0)
+            return false;
+        if (nread == 0)
+            return true;
+
+        for (long offset = 0; offset < nread;) {
+            auto const* entry = reinterpret_cast<struct dirent64 const*>(buffer + offset);
+            std::string_view name = entry->d_name;
+            if (name != "." && name != "..")
+                callback(name, entry->d_type);
+            offset += entry->d_reclen;
+        }
+    }
+}
+
+bool is_executable(int dir_fd, char const* name, unsigned char type)
+{
+    if (type == DT_DIR)
+        return false;
+    if (type != DT_REG) {
+        struct stat st {};
+        if (fstatat(dir_fd, name, &st, 0) < 0 || !S_ISREG(st.st_mode))
+            return false;
+    }
+    return faccessat(dir_fd, name, X_OK, 0) == 0;
+}
+
+bool is_directory(int dir_fd, char const* name, unsigned char type)
+{
+    if (type != DT_LNK && type != DT_UNKNOWN)
+        return type == DT_DIR;
+
+    struct stat st {};
+    return fstatat(dir_fd, name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool operator==(struct timespec const& a, struct timespec const& b)
+{
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+// There's no point in keeping the listings of every directory ever completed in.
+constexpr size_t max_listings = 64;
+
+} // namespace
+
+void PrefixTrie::insert(std::string_view name)
+{
+    std::vector<uint32_t> path { 0 };
+    uint32_t index = 0;
+
+    for (unsigned char ch : name) {
+        auto& children = m_nodes[index].children;
+        auto it = std::lower_bound(children.begin(), children.end(), ch, [](auto const& child, unsigned char value) {
+            return child.first < value;
+        });
+
+        if (it == children.end() || it->first != ch) {
+            auto child = static_cast<uint32_t>(m_nodes.size());
+            children.insert(it, { ch, child });
+            m_nodes.emplace_back();
+            index = child;
+        } else {
+            index = it->second;
+        }
+        path.push_back(index);
+    }
+
+    if (m_nodes[index].count++ == 0) {
+        for (auto node : path)
+            m_nodes[node].names_below++;
+    }
+}
+
+void PrefixTrie::erase(std::string_view name)
+{
+    std::vector<uint32_t> path { 0 };
+    uint32_t index = 0;
+
+    for (unsigned char ch : name) {
+        auto const& children = m_nodes[index].children;
+        auto it = std::lower_bound(children.begin(), children.end(), ch, [](auto const& child, unsigned char value) {
+            return child.first < value;
+        });
+        if (it == children.end() || it->first != ch)
+            return;
+        index = it->second;
+        path.push_back(index);
+    }
+
+    // The nodes themselves stay, ready for the name to come back.
+    if (m_nodes[index].count == 0 || --m_nodes[index].count > 0)
+        return;
+    for (auto node : path)
+        m_nodes[node].names_below--;
+}
+
+bool PrefixTrie::contains(std::string_view name) const
+{
+    auto index = find(name);
+    return index != no_node && m_nodes[index].count > 0;
+}
+
+uint32_t PrefixTrie::find(std::string_view text) const
+{
+    uint32_t index = 0;
+    for (unsigned char ch : text) {
+        auto const& children = m_nodes[index].children;
+        auto it = std::lower_bound(children.begin(), children.end(), ch, [](auto const& child, unsigned char value) {
+            return child.first < value;
+        });
+        if (it == children.end() || it->first != ch)
+            return no_node;
+        index = it->second;
+    }
+    return index;
+}
+
+void PrefixTrie::collect(std::string_view prefix, std::vector<std::string>& names, size_t limit) const
+{
+    auto start = find(prefix);
+    if (start == no_node || names.size() >= limit)
+        return;
+
+    std::string name { prefix };
+    auto visit = [&](auto& self, uint32_t index) -> void {
+        auto const& node = m_nodes[index];
+        if (node.count > 0)
+            names.push_back(name);
+
+        for (auto [ch, child] : node.children) {
+            if (names.size() >= limit)
+                return;
+            if (m_nodes[child].names_below == 0)
+                continue;
+            name.push_back(static_cast<char>(ch));
+            self(self, child);
+            name.pop_back();
+        }
+    };
+    visit(visit, start);
+}
+
+Completion::~Completion()
+{
+    if (m_inotify_fd >= 0)
+        close(m_inotify_fd);
+}
+
+void Completion::update(std::string_view path_variable)
+{
+    if (m_has_scanned && path_variable == m_path_variable)
+        drain_events();
+    if (!m_has_scanned || path_variable != m_path_variable)
+        scan_path(path_variable);
+}
+
+void Completion::scan_path(std::string_view path_variable)
+{
+    if (m_inotify_fd >= 0)
+        close(m_inotify_fd);
+    m_inotify_fd = move_to_shell_range(inotify_init1(IN_NONBLOCK | IN_CLOEXEC));
+
+    m_path_variable = path_variable;
+    m_has_scanned = true;
+    m_directories.clear();
+    m_commands = {};
+    m_next_unwatched = -1;
+
+    for (auto const* builtin : all_builtins())
+        m_commands.insert(builtin->name);
+
+    for (size_t start = 0; start <= path_variable.size();) {
+        auto end = path_variable.find(':', start);
+        if (end == std::string_view::npos)
+            end = path_variable.size();
+        std::string path { path_variable.substr(start, end - start) };
+        start = end + 1;
+
+        if (!path.starts_with('/'))
+            continue;
+
+        auto dir_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fd < 0)
+            continue;
+
+        // A directory that can't be watched is still worth completing from, even if it
+        // won't be kept current.
+        auto watch = m_inotify_fd < 0 ? -1 : inotify_add_watch(m_inotify_fd, path.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+        if (watch < 0)
+            watch = m_next_unwatched--;
+
+        // The same directory may be on PATH twice.
+        auto [it, is_new] = m_directories.try_emplace(watch, Directory { .path = path, .executables = {} });
+        if (is_new) {
+            auto& directory = it->second;
+            read_directory(dir_fd, [&](std::string_view name, unsigned char type) {
+                std::string owned { name };
+                if (is_executable(dir_fd, owned.c_str(), type) && directory.executables.insert(owned).second)
+                    m_commands.insert(owned);
+            });
+        }
+        close(dir_fd);
+    }
+}
+
+void Completion::drain_events()
+{
+    if (m_inotify_fd < 0)
+        return;
+
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    while (true) {
+        auto nread = read(m_inotify_fd, buffer, sizeof(buffer));
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return;
+
+        for (long offset = 0; offset < nread;) {
+            auto const* event = reinterpret_cast<struct inotify_event const*>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            // Some events were lost, so only a rescan can tell what's there.
+            if (event->mask & IN_Q_OVERFLOW) {
+                m_has_scanned = false;
+                continue;
+            }
+
+            auto it = m_directories.find(event->wd);
+            if (it == m_directories.end())
+                continue;
+            if (event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)) {
+                forget_directory(event->wd);
+                continue;
+            }
+            if (event->len == 0)
+                continue;
+
+            auto& directory = it->second;
+            std::string name { event->name };
+
+            // A file that was created, moved in or changed its mode may or may not be
+            // executable now.
+            auto is_present = !(event->mask & (IN_DELETE | IN_MOVED_FROM));
+            if (is_present) {
+                auto dir_fd = open(directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                is_present = dir_fd >= 0 && is_executable(dir_fd, name.c_str(), DT_UNKNOWN);
+                if (dir_fd >= 0)
+                    close(dir_fd);
+            }
+
+            if (is_present && directory.executables.insert(name).second)
+                m_commands.insert(name);
+            else if (!is_present && directory.executables.erase(name) > 0)
+                m_commands.erase(name);
+        }
+    }
+}
+
+void Completion::forget_directory(int watch)
+{
+    auto it = m_directories.find(watch);
+    if (it == m_directories.end())
+        return;
+
+    for (auto const& name : it->second.executables)
+        m_commands.erase(name);
+    m_directories.erase(it);
+}
+
+std::vector<std::string> Completion::complete_command(std::string_view prefix, size_t limit)
+{
+    std::vector<std::string> names;
+    m_commands.collect(prefix, names, limit);
+    return names;
+}
+
+std::vector<std::string> Completion::complete_pathname(std::string_view word, size_t limit)
+{
+    auto slash = word.rfind('/');
+    auto directory = slash == std::string_view::npos ? std::string_view {} : word.substr(0, slash + 1);
+    auto base = word.substr(directory.size());
+
+    std::vector<std::string> names;
+    auto const* listing = list_directory(directory.empty() ? "." : std::string { directory });
+    if (listing == nullptr)
+        return names;
+
+    auto it = std::lower_bound(listing->names.begin(), listing->names.end(), base);
+    for (; it != listing->names.end() && it->starts_with(base) && names.size() < limit; ++it) {
+        if (it->starts_with('.') && !base.starts_with('.'))
+            continue;
+        names.push_back(std::string { directory } + *it);
+    }
+    return names;
+}
+
+Completion::Listing const* Completion::list_directory(std::string const& path)
+{
+    // A directory's modification time changes whenever an entry is added, removed or
+    // renamed, so a listing is good for as long as that stays the same.
+    struct stat st {};
+    if (stat(path.c_str(), &st) < 0 || !S_ISDIR(st.st_mode))
+        return nullptr;
+
+    auto key = std::pair { st.st_dev, st.st_ino };
+    if (auto it = m_listings.find(key); it != m_listings.end() && it->second.modified == st.st_mtim)
+        return &it->second;
+
+    auto dir_fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0)
+        return nullptr;
+
+    Listing listing;
+    read_directory(dir_fd, [&](std::string_view name, unsigned char type) {
+        std::string owned { name };
+        if (is_directory(dir_fd, owned.c_str(), type))
+            owned += '/';
+        listing.names.push_back(std::move(owned));
+    });
+    close(dir_fd);
+    std::sort(listing.names.begin(), listing.names.end());
+
+    // The clock the file system stamps directories with may not tick for every change, so
+    // a directory changed within the last second could change again without its time
+    // moving. Such a listing is read again the next time.
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    if (now - std::chrono::seconds { st.st_mtim.tv_sec } >= std::chrono::seconds { 2 })
+        listing.modified = st.st_mtim;
+
+    if (m_listings.size() >= max_listings && !m_listings.contains(key))
+        m_listings.clear();
+    return &(m_listings[key] = std::move(listing));
+}
+
+} // namespace RatShell
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace RatShell {
+
+// A set of names that can be listed by prefix without looking at the others. A name may
+// be added more than once, e.g. when two directories have it, and stays until it's been
+// removed as many times.
+class PrefixTrie {
+public:
+    void insert(std::string_view);
+    void erase(std::string_view);
+    bool contains(std::string_view) const;
+
+    // Appends the names that start with the prefix in byte order, up to limit of them.
+    void collect(std::string_view prefix, std::vector<std::string>& names, size_t limit) const;
+
+    size_t size() const { return m_nodes.front().names_below; }
+
+private:
+    struct Node {
+        // Sorted by character, which keeps the names in order.
+        std::vector<std::pair<unsigned char, uint32_t>> children;
+        uint32_t count { 0 };
+        uint32_t names_below { 0 };
+    };
+
+    static constexpr uint32_t no_node = UINT32_MAX;
+
+    // The node the text leads to, or no_node if there is none.
+    uint32_t find(std::string_view) const;
+
+    std::vector<Node> m_nodes { Node {} };
+};
+
+// Completes command names and pathnames for an interactive shell. The executables on PATH
+// are scanned once, and inotify(7) watches on their directories keep the names current as
+// programs come and go. Directories being completed in are read with getdents64(2) and
+// kept as long as their modification time says they haven't changed.
+class Completion {
+public:
+    Completion() = default;
+    ~Completion();
+
+    Completion(Completion const&) = delete;
+    Completion& operator=(Completion const&) = delete;
+
+    // Rescans if PATH isn't what it was, and otherwise applies what changed since. Only
+    // absolute directories are used, as the others depend on the working directory.
+    void update(std::string_view path_variable);
+
+    // The builtins and executables that start with the prefix, in order, as of the last
+    // update.
+    std::vector<std::string> complete_command(std::string_view prefix, size_t limit = SIZE_MAX);
+    // The pathnames that start with the word, directories ending in a slash. Names that
+    // start with a dot are only given if the word's last component does.
+    std::vector<std::string> complete_pathname(std::string_view word, size_t limit = SIZE_MAX);
+
+private:
+    struct Directory {
+        std::string path;
+        std::unordered_set<std::string> executables;
+    };
+
+    struct Listing {
+        struct timespec modified {};
+        // Sorted, with a slash after each directory.
+        std::vector<std::string> names;
+    };
+
+    void scan_path(std::string_view path_variable);
+    void drain_events();
+    void add_executable(Directory&, int dir_fd, std::string name);
+    void forget_directory(int watch);
+    Listing const* list_directory(std::string const& path);
+
+    std::string m_path_variable;
+    bool m_has_scanned { false };
+    int m_inotify_fd { -1 };
+    // By watch descriptor, or by a negative number for a directory that isn't watched.
+    std::unordered_map<int, Directory> m_directories;
+    int m_next_unwatched { -1 };
+    PrefixTrie m_commands;
+
+    std::map<std::pair<dev_t, ino_t>, Listing> m_listings;
+};
+
+} // namespace RatShell
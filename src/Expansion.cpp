@@ -0,0 +1,477 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Expansion.h"
+#include "Glob.h"
+#include "Shell.h"
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr std::string_view default_ifs = " \t\n";
+
+bool is_pattern_character(char ch)
+{
+    return ch == '*' || ch == '?' || ch == '[' || ch == ']' || ch == '\\';
+}
+
+// Returns the index one past the ')' or '}' closing the expansion that starts with the
+// '$' at the given index.
+size_t find_expansion_end(std::string_view word, size_t index)
+{
+    auto open = word[index + 1];
+    auto close = open == '(' ? ')' : '}';
+    size_t depth = 1;
+
+    for (index += 2; index < word.size() && depth > 0; index++) {
+        auto ch = word[index];
+
+        switch (ch) {
+        case '\\':
+            index++;
+            break;
+        case '\'':
+            index = std::min(word.find('\'', index + 1), word.size());
+            break;
+        case '"':
+            for (index++; index < word.size() && word[index] != '"'; index++) {
+                if (word[index] == '\\')
+                    index++;
+            }
+            break;
+        default:
+            if (ch == open)
+                depth++;
+            else if (ch == close)
+                depth--;
+            break;
+        }
+    }
+
+    return std::min(index, word.size());
+}
+
+bool is_name_character(char ch)
+{
+    return std::isalnum(static_cast<unsigned char>(ch)) != 0 || ch == '_';
+}
+
+bool is_special_parameter(char ch)
+{
+    return ch == '?' || ch == '$' || ch == '#' || ch == '@' || ch == '*' || ch == '!' || ch == '-' || std::isdigit(static_cast<unsigned char>(ch)) != 0;
+}
+
+// Returns the length of the parameter name at the start of the text, or 0 if there's none.
+size_t parameter_name_length(std::string_view text, bool is_braced)
+{
+    if (text.empty())
+        return 0;
+
+    // (2.6.2) When a positional parameter with more than one digit is specified, the
+    // application shall enclose the digits in braces.
+    if (std::isdigit(static_cast<unsigned char>(text[0])) != 0) {
+        if (!is_braced)
+            return 1;
+        auto end = text.find_first_not_of("0123456789");
+        return end == std::string_view::npos ? text.size() : end;
+    }
+    if (is_special_parameter(text[0]))
+        return 1;
+    if (!is_name_character(text[0]))
+        return 0;
+
+    size_t length = 1;
+    while (length < text.size() && is_name_character(text[length]))
+        length++;
+    return length;
+}
+
+} // namespace
+
+namespace RatShell {
+
+std::vector<std::string> Expander::expand_words(std::span<std::string const> words)
+{
+    std::vector<std::string> result;
+    result.reserve(words.size());
+
+    for (auto const& word : words) {
+        std::vector<Field> fields;
+        expand_word_into(word, fields, true);
+
+        for (auto& field : fields)
+            expand_pathnames(std::move(field), result);
+    }
+
+    return result;
+}
+
+std::string Expander::expand_word(std::string_view word)
+{
+    std::vector<Field> fields;
+    expand_word_into(word, fields, false);
+
+    if (fields.empty())
+        return {};
+    return std::move(fields.front().value);
+}
+
+void Expander::expand_word_into(std::string_view word, std::vector<Field>& fields, bool split_fields)
+{
+    Field field;
+    bool in_double_quotes = false;
+    // Set when "$@" had no parameters to expand to, in which case it makes no field.
+    bool drop_if_empty = false;
+
+    auto append = [&field](char ch, bool quoted) {
+        field.value += ch;
+        if (quoted && is_pattern_character(ch))
+            field.pattern += '\\';
+        else if (!quoted && (ch == '*' || ch == '?' || ch == '['))
+            field.has_unquoted_magic = true;
+        field.pattern += ch;
+        field.is_significant = true;
+    };
+
+    auto append_expansion = [&](std::string_view result) {
+        // (2.6.5) Field splitting only applies to the results of unquoted expansions.
+        if (in_double_quotes || !split_fields) {
+            for (auto result_ch : result)
+                append(result_ch, true);
+            field.is_significant = true;
+        } else {
+            split_into_fields(result, field, fields);
+        }
+    };
+
+    // (2.5.2) When the expansion occurs within double-quotes, each positional parameter
+    // shall expand as a separate field.
+    auto append_positional_parameters = [&]() {
+        auto const& parameters = m_shell.positional_parameters();
+        for (size_t index = 0; index < parameters.size(); index++) {
+            if (index > 0) {
+                fields.push_back(std::move(field));
+                field = {};
+            }
+            for (auto parameter_ch : parameters[index])
+                append(parameter_ch, true);
+            field.is_significant = true;
+        }
+        if (parameters.empty())
+            drop_if_empty = true;
+    };
+
+    for (size_t i = 0; i < word.size(); i++) {
+        auto ch = word[i];
+
+        if (ch == '$' && i + 1 < word.size()) {
+            auto next = word[i + 1];
+
+            // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06_03
+            if (next == '(') {
+                auto end = find_expansion_end(word, i);
+
+                // "$((" starts an arithmetic expansion only if its inner parenthesis
+                // closes right before the outer one, otherwise it's a subshell inside a
+                // command substitution.
+                if (i + 2 < word.size() && word[i + 2] == '(' && find_expansion_end(word, i + 1) == end - 1) {
+                    append_expansion(expand_arithmetic(word.substr(i + 3, end - i - 5)));
+                    i = end - 1;
+                    continue;
+                }
+
+                append_expansion(m_shell.run_command_substitution(word.substr(i + 2, end - i - 3)));
+                i = end - 1;
+                continue;
+            }
+
+            // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06_02
+            if (next == '{') {
+                auto end = find_expansion_end(word, i);
+                auto expression = word.substr(i + 2, end - i - 3);
+                if (expression == "@" && in_double_quotes && split_fields)
+                    append_positional_parameters();
+                else
+                    append_expansion(expand_parameter(expression));
+                i = end - 1;
+                continue;
+            }
+
+            if (auto length = parameter_name_length(word.substr(i + 1), false); length > 0) {
+                if (next == '@' && in_double_quotes && split_fields)
+                    append_positional_parameters();
+                else
+                    append_expansion(lookup_parameter(word.substr(i + 1, length)).value_or(""));
+                i += length;
+                continue;
+            }
+        }
+
+        if (in_double_quotes) {
+            if (ch == '"') {
+                in_double_quotes = false;
+                continue;
+            }
+
+            // (2.2.3) The <backslash> shall retain its special meaning as an escape
+            // character only when followed by one of the following characters when
+            // considered special: $ ` " \ <newline>
+            if (ch == '\\' && i + 1 < word.size()) {
+                auto next = word[i + 1];
+                if (next == '\n') {
+                    i++;
+                    continue;
+                }
+                if (next == '$' || next == '`' || next == '"' || next == '\\') {
+                    append(word[++i], true);
+                    continue;
+                }
+            }
+
+            append(ch, true);
+            continue;
+        }
+
+        switch (ch) {
+        case '\\':
+            // (2.2.1) A <backslash> that is not quoted shall preserve the literal value of
+            // the following character.
+            if (i + 1 < word.size())
+                append(word[++i], true);
+            break;
+        case '\'': {
+            // (2.2.2) Enclosing characters in single-quotes shall preserve the literal value
+            // of each character within the single-quotes.
+            auto end = word.find('\'', i + 1);
+            if (end == std::string_view::npos)
+                end = word.size();
+            for (auto quoted : word.substr(i + 1, end - i - 1))
+                append(quoted, true);
+            field.is_significant = true;
+            i = end;
+            break;
+        }
+        case '"':
+            in_double_quotes = true;
+            field.is_significant = true;
+            break;
+        default:
+            append(ch, false);
+            break;
+        }
+    }
+
+    if (drop_if_empty && field.value.empty())
+        return;
+    if (field.is_significant || !split_fields)
+        fields.push_back(std::move(field));
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_05_02
+std::optional<std::string> Expander::lookup_parameter(std::string_view name)
+{
+    if (name == "?")
+        return std::to_string(m_shell.last_exit_status());
+    if (name == "$")
+        return std::to_string(m_shell.pid());
+    if (name == "0")
+        return m_shell.name();
+
+    auto const& parameters = m_shell.positional_parameters();
+    if (name == "#")
+        return std::to_string(parameters.size());
+
+    // Outside of "$@", the parameters are joined by the first character of IFS.
+    if (name == "@" || name == "*") {
+        std::string_view ifs = default_ifs;
+        if (auto const* variable = m_shell.variables().find("IFS"); variable != nullptr)
+            ifs = variable->value;
+
+        std::string joined;
+        for (size_t index = 0; index < parameters.size(); index++) {
+            if (index > 0 && name == "@")
+                joined += ' ';
+            else if (index > 0 && !ifs.empty())
+                joined += ifs[0];
+            joined += parameters[index];
+        }
+        return joined;
+    }
+
+    if (std::isdigit(static_cast<unsigned char>(name[0])) != 0) {
+        size_t index = 0;
+        for (auto digit : name)
+            index = std::min<size_t>(index * 10 + (digit - '0'), parameters.size() + 1);
+        if (index == 0 || index > parameters.size())
+            return std::nullopt;
+        return parameters[index - 1];
+    }
+
+    auto const* variable = m_shell.variables().find(std::string { name });
+    if (variable == nullptr)
+        return std::nullopt;
+    return variable->value;
+}
+
+// Expands the contents of "${...}".
+std::string Expander::expand_parameter(std::string_view expression)
+{
+    // ${#parameter}: String Length.
+    if (expression.size() > 1 && expression[0] == '#') {
+        auto value = lookup_parameter(expression.substr(1));
+        return std::to_string(value.has_value() ? value->size() : 0);
+    }
+
+    auto name_length = parameter_name_length(expression, true);
+    auto name = expression.substr(0, name_length);
+    auto value = lookup_parameter(name);
+    auto rest = expression.substr(name_length);
+
+    if (name_length == 0 || (!rest.empty() && rest.find_first_of(":-=?+") != 0)) {
+        std::cerr << "ratsh: ${" << expression << "}: bad substitution\n";
+        m_has_failed = true;
+        return {};
+    }
+    if (rest.empty())
+        return value.value_or("");
+
+    // With a colon, a parameter that is set but null is treated like an unset one.
+    bool treat_null_as_unset = rest[0] == ':';
+    if (treat_null_as_unset)
+        rest.remove_prefix(1);
+    if (rest.empty()) {
+        std::cerr << "ratsh: ${" << expression << "}: bad substitution\n";
+        m_has_failed = true;
+        return {};
+    }
+
+    auto is_set = value.has_value() && !(treat_null_as_unset && value->empty());
+    auto word = rest.substr(1);
+
+    switch (rest[0]) {
+    case '-':
+        return is_set ? value.value() : expand_word(word);
+    case '=':
+        if (is_set)
+            return value.value();
+        if (!Variables::is_valid_name(name)) {
+            std::cerr << "ratsh: $" << name << ": cannot assign in this way\n";
+            m_has_failed = true;
+            return {};
+        }
+        m_shell.variables().set(std::string { name }, expand_word(word));
+        return m_shell.variables().find(std::string { name })->value;
+    case '+':
+        return is_set ? expand_word(word) : std::string {};
+    case '?':
+        if (is_set)
+            return value.value();
+        std::cerr << "ratsh: " << name << ": " << (word.empty() ? "parameter null or not set" : expand_word(word)) << "\n";
+        m_has_failed = true;
+        return {};
+    default:
+        std::cerr << "ratsh: ${" << expression << "}: bad substitution\n";
+        m_has_failed = true;
+        return {};
+    }
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06_04
+std::string Expander::expand_arithmetic(std::string_view expression)
+{
+    // The expression shall be treated as if it were in double-quotes, so it goes through
+    // parameter expansion, command substitution and quote removal first.
+    std::string expanded;
+    if (expression.find_first_of("$`\\'\"") != std::string_view::npos) {
+        expanded = expand_word(expression);
+        expression = expanded;
+    }
+
+    std::string error;
+    std::optional<int64_t> result;
+    bool was_cached = false;
+    if (auto compiled = m_shell.arithmetic_cache().get(expression, error, &was_cached))
+        result = compiled->evaluate(m_shell.variables(), error);
+    if (was_cached)
+        m_shell.statistics().increment(Statistics::Counter::ParseCacheHits);
+
+    if (!result.has_value()) {
+        std::cerr << "ratsh: $((" << expression << ")): " << error << "\n";
+        m_has_failed = true;
+        return {};
+    }
+
+    return std::to_string(result.value());
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06_05
+void Expander::split_into_fields(std::string_view text, Field& field, std::vector<Field>& fields)
+{
+    // If the value of IFS is null, no field splitting shall be performed.
+    std::string_view ifs = default_ifs;
+    if (auto const* variable = m_shell.variables().find("IFS"); variable != nullptr)
+        ifs = variable->value;
+
+    auto is_ifs = [&ifs](char ch) { return ifs.find(ch) != std::string_view::npos; };
+    auto is_ifs_whitespace = [&is_ifs](char ch) { return is_ifs(ch) && (ch == ' ' || ch == '\t' || ch == '\n'); };
+
+    for (size_t i = 0; i < text.size();) {
+        auto ch = text[i];
+
+        if (!is_ifs(ch)) {
+            field.value += ch;
+            if (ch == '*' || ch == '?' || ch == '[')
+                field.has_unquoted_magic = true;
+            field.pattern += ch;
+            field.is_significant = true;
+            i++;
+            continue;
+        }
+
+        // A delimiter is any IFS white space together with at most one other IFS
+        // character. Only the latter delimits empty fields.
+        bool has_non_whitespace = false;
+        while (i < text.size() && is_ifs_whitespace(text[i]))
+            i++;
+        if (i < text.size() && is_ifs(text[i]) && !is_ifs_whitespace(text[i])) {
+            has_non_whitespace = true;
+            i++;
+            while (i < text.size() && is_ifs_whitespace(text[i]))
+                i++;
+        }
+
+        if (field.is_significant || has_non_whitespace) {
+            fields.push_back(std::move(field));
+            field = {};
+        }
+    }
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06_06
+void Expander::expand_pathnames(Field&& field, std::vector<std::string>& result)
+{
+    auto const& options = m_shell.options();
+
+    if (field.has_unquoted_magic && !options.noglob) {
+        auto paths = m_shell.glob().expand(field.pattern, Glob::Options { .globstar = options.globstar });
+
+        // If the pattern does not match any existing filenames or pathnames, the pattern
+        // string shall be left unchanged.
+        if (!paths.empty()) {
+            result.insert(result.end(), std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()));
+            return;
+        }
+    }
+
+    result.push_back(std::move(field.value));
+}
+
+} // namespace RatShell
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RatShell {
+
+class Shell;
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06
+class Expander {
+public:
+    explicit Expander(Shell& shell)
+        : m_shell(shell)
+    {
+    }
+
+    // Performs every word expansion, producing the fields used as a command's arguments.
+    std::vector<std::string> expand_words(std::span<std::string const> words);
+
+    // Expands a word without field splitting or pathname expansion, as is done for
+    // redirection targets.
+    std::string expand_word(std::string_view word);
+
+    // Whether one of the expansions failed, e.g. "$((1/0))" or "${unset?}", once its
+    // error has been written out. The command they were for must not run then.
+    bool has_failed() const { return m_has_failed; }
+
+private:
+    struct Field {
+        // The field after quote removal.
+        std::string value;
+        // The field as a pattern, where quoted pattern characters are escaped.
+        std::string pattern;
+        bool has_unquoted_magic { false };
+        // Whether the field should be kept even if empty, e.g. because of "".
+        bool is_significant { false };
+    };
+
+    void expand_word_into(std::string_view word, std::vector<Field>& fields, bool split_fields);
+    std::optional<std::string> lookup_parameter(std::string_view name);
+    std::string expand_parameter(std::string_view expression);
+    std::string expand_arithmetic(std::string_view expression);
+    void split_into_fields(std::string_view text, Field& field, std::vector<Field>& fields);
+    void expand_pathnames(Field&& field, std::vector<std::string>& result);
+
+    Shell& m_shell;
+    bool m_has_failed { false };
+};
+
+} // namespace RatShell
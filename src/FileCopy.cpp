@@ -0,0 +1,286 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "FileCopy.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace RatShell {
+
+namespace {
+
+// Large enough that the system calls cost little next to the copying itself.
+constexpr size_t chunk_size = 1 << 20;
+constexpr size_t buffer_size = 128 * 1024;
+
+// For a standard input or output that another program left non-blocking.
+void wait_until_ready(int fd, short events)
+{
+    struct pollfd poll_fd { .fd = fd, .events = events, .revents = 0 };
+    while (poll(&poll_fd, 1, -1) < 0 && errno == EINTR)
+        ;
+}
+
+// Returns 0, or the errno of the write that failed.
+int write_all(int fd, char const* data, size_t size)
+{
+    while (size > 0) {
+        auto written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                wait_until_ready(fd, POLLOUT);
+                continue;
+            }
+            return errno;
+        }
+        data += written;
+        size -= written;
+    }
+    return 0;
+}
+
+bool have_all_failed(std::span<int const> write_errors)
+{
+    return std::all_of(write_errors.begin(), write_errors.end(), [](int error) { return error != 0; });
+}
+
+void read_write(int in_fd, std::span<int const> out_fds, std::span<int> write_errors, CopyResult& result)
+{
+    std::vector<char> buffer(buffer_size);
+
+    while (!have_all_failed(write_errors)) {
+        auto count = read(in_fd, buffer.data(), buffer.size());
+        if (count == 0)
+            return;
+        if (count < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN) {
+                wait_until_ready(in_fd, POLLIN);
+                continue;
+            }
+            result.read_error = errno;
+            return;
+        }
+
+        if (result.method == CopyMethod::None)
+            result.method = CopyMethod::ReadWrite;
+        for (size_t i = 0; i < out_fds.size(); i++) {
+            if (write_errors[i] == 0)
+                write_errors[i] = write_all(out_fds[i], buffer.data(), count);
+        }
+    }
+}
+
+// Calls move until it reports the end of the input. Returns false if it failed instead,
+// which leaves the rest to the read/write loop: that one can tell which end failed, and
+// carries on if the kernel just wouldn't do it.
+template<typename Move>
+bool move_until_end(CopyMethod method, CopyResult& result, Move move)
+{
+    while (true) {
+        auto moved = move();
+        if (moved == 0)
+            return true;
+        if (moved < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (result.method == CopyMethod::None)
+            result.method = method;
+    }
+}
+
+void copy_to_one(int in_fd, int out_fd, int& write_error, CopyResult& result)
+{
+    struct stat in_stat {};
+    struct stat out_stat {};
+    if (fstat(in_fd, &in_stat) == 0 && fstat(out_fd, &out_stat) == 0) {
+        // Files that say they're empty, like those in /proc, may still have something to read.
+        if (S_ISREG(in_stat.st_mode) && S_ISREG(out_stat.st_mode) && in_stat.st_size > 0) {
+            if (move_until_end(CopyMethod::CopyFileRange, result, [&] { return copy_file_range(in_fd, nullptr, out_fd, nullptr, chunk_size, 0); }))
+                return;
+        } else if (S_ISFIFO(in_stat.st_mode) || S_ISFIFO(out_stat.st_mode)) {
+            if (move_until_end(CopyMethod::Splice, result, [&] { return splice(in_fd, nullptr, out_fd, nullptr, chunk_size, SPLICE_F_MOVE | SPLICE_F_MORE); }))
+                return;
+        }
+    }
+
+    read_write(in_fd, { &out_fd, 1 }, { &write_error, 1 }, result);
+}
+
+// Takes count bytes that are known to be in the pipe out of it.
+void discard_from_pipe(int pipe_fd, size_t count, std::vector<char>& buffer)
+{
+    while (count > 0) {
+        auto got = read(pipe_fd, buffer.data(), std::min(count, buffer.size()));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return;
+        count -= got;
+    }
+}
+
+// Moves count bytes that are known to be in the pipe to the output. Returns 0, or the
+// errno of the output once it failed, with the rest of the bytes discarded.
+int move_from_pipe(int pipe_fd, int out_fd, size_t count, std::vector<char>& buffer)
+{
+    while (count > 0) {
+        auto moved = splice(pipe_fd, nullptr, out_fd, nullptr, count, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved > 0) {
+            count -= moved;
+            continue;
+        }
+        if (moved < 0 && errno == EINTR)
+            continue;
+        if (moved < 0 && errno == EAGAIN) {
+            wait_until_ready(out_fd, POLLOUT);
+            continue;
+        }
+        // Such as an output opened to append to, or one that can't be spliced to.
+        if (moved < 0 && errno == EINVAL)
+            break;
+
+        auto error = moved < 0 ? errno : EIO;
+        discard_from_pipe(pipe_fd, count, buffer);
+        return error;
+    }
+
+    while (count > 0) {
+        auto got = read(pipe_fd, buffer.data(), std::min(count, buffer.size()));
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            return EIO;
+        count -= got;
+
+        if (auto error = write_all(out_fd, buffer.data(), got); error != 0) {
+            discard_from_pipe(pipe_fd, count, buffer);
+            return error;
+        }
+    }
+    return 0;
+}
+
+// Each output but the last gets its own copy of what's in the input pipe with tee(2),
+// which then gets spliced to it, and the last takes the bytes out of the input. Returns
+// false without reading anything if the input isn't a pipe.
+bool fan_out_pipe(int in_fd, std::span<int const> out_fds, std::span<int> write_errors, CopyResult& result)
+{
+    auto pipe_size = fcntl(in_fd, F_GETPIPE_SZ);
+    if (pipe_size < 0)
+        return false;
+
+    std::vector<std::array<int, 2>> copies(out_fds.size() - 1, { -1, -1 });
+    auto close_copies = [&copies] {
+        for (auto [read_fd, write_fd] : copies) {
+            if (read_fd >= 0) {
+                close(read_fd);
+                close(write_fd);
+            }
+        }
+    };
+    for (auto& fds : copies) {
+        if (pipe2(fds.data(), O_CLOEXEC) < 0) {
+            fds = { -1, -1 };
+            close_copies();
+            return false;
+        }
+        // A copy can then take all that's in the input at once.
+        fcntl(fds[1], F_SETPIPE_SZ, pipe_size);
+    }
+
+    std::vector<char> buffer(buffer_size);
+    std::vector<size_t> copied(copies.size());
+    auto const last = out_fds.size() - 1;
+
+    while (!have_all_failed(write_errors)) {
+        if (have_all_failed(write_errors.first(last))) {
+            copy_to_one(in_fd, out_fds[last], write_errors[last], result);
+            break;
+        }
+
+        // tee(2) waits for the input as read(2) would. The copies may differ in length if
+        // more came in between them, so only what they all have goes out this round.
+        auto count = SIZE_MAX;
+        bool is_supported = true;
+        bool is_at_end = false;
+        std::fill(copied.begin(), copied.end(), 0);
+        for (size_t i = 0; i < copies.size() && is_supported && !is_at_end; i++) {
+            if (write_errors[i] != 0)
+                continue;
+
+            ssize_t got;
+            while ((got = tee(in_fd, copies[i][1], chunk_size, 0)) < 0 && (errno == EINTR || errno == EAGAIN)) {
+                if (errno == EAGAIN)
+                    wait_until_ready(in_fd, POLLIN);
+            }
+
+            if (got < 0)
+                is_supported = false;
+            else if (got == 0)
+                is_at_end = true;
+            else
+                count = std::min(count, static_cast<size_t>(got));
+            copied[i] = std::max<ssize_t>(got, 0);
+        }
+
+        if (is_at_end)
+            break;
+        if (!is_supported) {
+            // Nothing was taken out of the input, so the copies can just be dropped.
+            for (size_t i = 0; i < copies.size(); i++)
+                discard_from_pipe(copies[i][0], copied[i], buffer);
+            read_write(in_fd, out_fds, write_errors, result);
+            break;
+        }
+
+        for (size_t i = 0; i < copies.size(); i++) {
+            if (copied[i] == 0)
+                continue;
+            write_errors[i] = move_from_pipe(copies[i][0], out_fds[i], count, buffer);
+            discard_from_pipe(copies[i][0], copied[i] - count, buffer);
+        }
+
+        if (write_errors[last] == 0)
+            write_errors[last] = move_from_pipe(in_fd, out_fds[last], count, buffer);
+        else
+            discard_from_pipe(in_fd, count, buffer);
+
+        if (result.method == CopyMethod::None)
+            result.method = CopyMethod::Tee;
+    }
+
+    close_copies();
+    return true;
+}
+
+} // namespace
+
+CopyResult copy_data(int in_fd, std::span<int const> out_fds)
+{
+    CopyResult result;
+    result.write_errors.assign(out_fds.size(), 0);
+
+    if (out_fds.size() == 1)
+        copy_to_one(in_fd, out_fds.front(), result.write_errors.front(), result);
+    else if (out_fds.size() > 1 && !fan_out_pipe(in_fd, out_fds, result.write_errors, result))
+        read_write(in_fd, out_fds, result.write_errors, result);
+
+    return result;
+}
+
+} // namespace RatShell
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <span>
+#include <vector>
+
+namespace RatShell {
+
+// How copy_data moved the first bytes it copied.
+enum class CopyMethod {
+    None,
+    CopyFileRange,
+    Splice,
+    Tee,
+    ReadWrite,
+};
+
+struct CopyResult {
+    CopyMethod method { CopyMethod::None };
+    // The errno of a failed read, or 0 if the input was read to its end.
+    int read_error { 0 };
+    // The errno of each output that failed, or 0, in the order they were given. An output
+    // that fails is dropped and the others carry on.
+    std::vector<int> write_errors;
+};
+
+// Copies the input to each of the outputs until it ends, keeping the data in the kernel
+// where the file types allow: copy_file_range(2) between regular files, splice(2) when
+// either end is a pipe, and tee(2) to fan a pipe out to several outputs. Anything else,
+// or anything the kernel refuses, goes through a read/write loop with a large buffer.
+CopyResult copy_data(int in_fd, std::span<int const> out_fds);
+
+} // namespace RatShell
@@ -5,12 +5,24 @@
  */
 
 #include "FileDescription.h"
+#include <cerrno>
 #include <cstdio>
 #include <fcntl.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 namespace RatShell {
 
+int move_to_shell_range(int fd)
+{
+    if (fd < 0 || fd >= min_shell_fd)
+        return fd;
+
+    auto moved = fcntl(fd, F_DUPFD_CLOEXEC, min_shell_fd);
+    close(fd);
+    return moved;
+}
+
 FileDescriptionCollector::~FileDescriptionCollector()
 {
     collect();
@@ -40,29 +52,54 @@ SavedFileDescriptions::~SavedFileDescriptions()
 
 void SavedFileDescriptions::add(int fd)
 {
-    auto saved_fd = dup(fd);
-    /// FIXME: Should we handle this case?
-    if (saved_fd < 0)
-        perror("dup");
-
-    // Make sure to close the duplicated fd for the child process before its execution.
-    auto flags = fcntl(saved_fd, F_GETFD);
-    auto rc = fcntl(saved_fd, F_SETFD, flags | FD_CLOEXEC);
-    if (rc < 0)
+    // The copy is kept out of the way of other redirections, and closed for child
+    // processes before their execution.
+    auto saved_fd = fcntl(fd, F_DUPFD_CLOEXEC, min_shell_fd);
+    if (saved_fd < 0 && errno != EBADF)
         perror("fcntl");
 
+    // A descriptor that wasn't open is restored by closing it again.
     m_saves.push_back({ .original = fd, .saved = saved_fd });
-    m_fds.add(saved_fd);
+    if (saved_fd >= 0)
+        m_fds.add(saved_fd);
 }
 
 void SavedFileDescriptions::restore()
 {
-    for (auto& save : m_saves) {
-        if (dup2(save.saved, save.original) < 0)
+    // The same descriptor may have been saved more than once, and only the first save
+    // holds what it was originally.
+    for (auto it = m_saves.rbegin(); it != m_saves.rend(); ++it) {
+        if (it->saved < 0)
+            close(it->original);
+        else if (dup2(it->saved, it->original) < 0)
             perror("SavedFileDescriptions::restore()");
     }
     m_saves.clear();
     m_fds.collect();
+
+    // With the pipes closed, a substitution that's still writing gets SIGPIPE, and one
+    // that's still reading sees the end of its input.
+    for (auto pid : m_process_substitutions) {
+        while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+            ;
+    }
+    m_process_substitutions.clear();
+}
+
+void SavedFileDescriptions::add_process_substitution(pid_t pid, int fd)
+{
+    m_fds.add(fd);
+    m_process_substitutions.push_back(pid);
+}
+
+void SavedFileDescriptions::discard()
+{
+    m_saves.clear();
+    m_fds.collect();
+
+    // What the redirections kept may still be in use, so the substitutions are left to
+    // finish on their own.
+    m_process_substitutions.clear();
 }
 
 } // namespace RatShell
\ No newline at end of file
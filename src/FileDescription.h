@@ -6,10 +6,19 @@
 
 #pragma once
 
+#include <sys/types.h>
 #include <vector>
 
 namespace RatShell {
 
+// (2.7) Redirections may use descriptors 0 through 9, so the shell keeps its own
+// descriptors at this number or above.
+constexpr int min_shell_fd = 10;
+
+// Moves a descriptor the shell keeps for itself out of the range left for redirections,
+// so that e.g. "exec 3>log" can't take it away. Returns the new descriptor, or -1.
+int move_to_shell_range(int fd);
+
 class FileDescriptionCollector {
 public:
     FileDescriptionCollector() = default;
@@ -30,7 +39,12 @@ public:
     ~SavedFileDescriptions();
 
     void add(int fd);
+    // Keeps the shell's end of a process substitution's pipe until the redirections are
+    // restored, after which the process is waited for.
+    void add_process_substitution(pid_t pid, int fd);
     void restore();
+    // Leaves the redirections in place for good, e.g. for exec without a command.
+    void discard();
 
 private:
     struct SavedFileDescription {
@@ -39,6 +53,7 @@ private:
     };
     std::vector<SavedFileDescription> m_saves;
     FileDescriptionCollector m_fds;
+    std::vector<pid_t> m_process_substitutions;
 };
 
 } // namespace RatShell
\ No newline at end of file
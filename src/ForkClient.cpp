@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ForkProtocol.h"
+#include "ForkServer.h"
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+namespace RatShell {
+
+// This is all the small client links in, so it stays away from iostreams, whose setup
+// would cost more than the rest of its startup.
+std::optional<int> run_fork_client(std::string const& socket_path, std::span<char const* const> arguments)
+{
+    using namespace ForkProtocol;
+
+    auto address = address_of(socket_path);
+    if (!address.has_value() || arguments.empty())
+        return std::nullopt;
+
+    auto connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connection < 0)
+        return std::nullopt;
+    if (connect(connection, reinterpret_cast<sockaddr const*>(&address.value()), sizeof(sockaddr_un)) < 0) {
+        close(connection);
+        return std::nullopt;
+    }
+
+    char working_directory[PATH_MAX];
+    if (getcwd(working_directory, sizeof(working_directory)) == nullptr)
+        std::strcpy(working_directory, "/");
+
+    std::string payload;
+    append_string(payload, working_directory);
+    append_u32(payload, static_cast<uint32_t>(arguments.size()));
+    for (auto const* argument : arguments)
+        append_string(payload, argument);
+
+    uint32_t variable_count = 0;
+    for (auto** variable = environ; *variable != nullptr; variable++)
+        variable_count++;
+    append_u32(payload, variable_count);
+    for (auto** variable = environ; *variable != nullptr; variable++)
+        append_string(payload, *variable);
+
+    std::string request;
+    append_u32(request, version);
+    append_u32(request, static_cast<uint32_t>(payload.size()));
+    request += payload;
+
+    // A closed standard descriptor is passed along as /dev/null.
+    std::array<int, passed_fd_count> fds {};
+    std::vector<int> opened;
+    for (size_t fd = 0; fd < passed_fd_count; fd++) {
+        fds[fd] = static_cast<int>(fd);
+        if (fcntl(fds[fd], F_GETFD) < 0) {
+            fds[fd] = open("/dev/null", O_RDWR | O_CLOEXEC);
+            opened.push_back(fds[fd]);
+        }
+    }
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] {};
+    iovec vector { .iov_base = request.data(), .iov_len = request.size() };
+    msghdr message {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    auto* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(fds));
+
+    ssize_t nsent;
+    do {
+        nsent = sendmsg(connection, &message, MSG_NOSIGNAL);
+    } while (nsent < 0 && errno == EINTR);
+    for (auto fd : opened)
+        close(fd);
+
+    uint32_t rc = 0;
+    auto is_done = nsent > 0
+        && send_all(connection, request.data() + nsent, request.size() - nsent)
+        && read_all(connection, reinterpret_cast<char*>(&rc), sizeof(rc));
+    close(connection);
+
+    // The command may have run by now, so running it again here would be wrong.
+    if (!is_done) {
+        dprintf(STDERR_FILENO, "ratsh: %s: lost the connection to the server\n", socket_path.c_str());
+        return 1;
+    }
+    return static_cast<int>(rc);
+}
+
+} // namespace RatShell
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ForkProtocol.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace RatShell::ForkProtocol {
+
+std::optional<sockaddr_un> address_of(std::string const& socket_path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path))
+        return std::nullopt;
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+    return address;
+}
+
+void append_u32(std::string& out, uint32_t value)
+{
+    out.append(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+void append_string(std::string& out, std::string_view text)
+{
+    append_u32(out, static_cast<uint32_t>(text.size()));
+    out += text;
+}
+
+bool read_all(int fd, char* data, size_t size)
+{
+    while (size > 0) {
+        auto nread = read(fd, data, size);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread <= 0)
+            return false;
+        data += nread;
+        size -= nread;
+    }
+    return true;
+}
+
+bool send_all(int fd, char const* data, size_t size)
+{
+    while (size > 0) {
+        auto nsent = send(fd, data, size, MSG_NOSIGNAL);
+        if (nsent < 0 && errno == EINTR)
+            continue;
+        if (nsent <= 0)
+            return false;
+        data += nsent;
+        size -= nsent;
+    }
+    return true;
+}
+
+} // namespace RatShell::ForkProtocol
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/un.h>
+
+// What a fork server and its clients say to each other. A request starts with the version
+// and the size of the rest, which is the working directory, the arguments and the
+// environment, each string preceded by its size and each list by its length. Standard
+// input, output and error come along with the first bytes. The reply is the exit status.
+// Everything is in the host's byte order, as both ends are on the same machine.
+namespace RatShell::ForkProtocol {
+
+constexpr uint32_t version = 1;
+constexpr size_t max_request_size = 64 * 1024 * 1024;
+constexpr size_t passed_fd_count = 3;
+
+std::optional<sockaddr_un> address_of(std::string const& socket_path);
+
+void append_u32(std::string& out, uint32_t);
+void append_string(std::string& out, std::string_view);
+
+// Both retry after signals, and fail at the end of the file or if the peer is gone.
+bool read_all(int fd, char* data, size_t size);
+bool send_all(int fd, char const* data, size_t size);
+
+} // namespace RatShell::ForkProtocol
@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ForkServer.h"
+#include "ForkProtocol.h"
+#include "Shell.h"
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <signal.h>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+using namespace ForkProtocol;
+
+struct Request {
+    std::string working_directory;
+    std::vector<std::string> arguments;
+    std::vector<std::string> environment;
+    std::array<int, passed_fd_count> fds { -1, -1, -1 };
+
+    void close_fds()
+    {
+        for (auto& fd : fds) {
+            if (fd >= 0)
+                close(fd);
+            fd = -1;
+        }
+    }
+};
+
+// A child forked ahead of time that waits for a connection to be handed to it, so that
+// neither the fork nor the copying of the pages it writes to hold up a request.
+struct Spare {
+    pid_t pid { -1 };
+    int pidfd { -1 };
+    int channel { -1 };
+};
+
+struct Job {
+    pid_t pid { -1 };
+    int pidfd { -1 };
+    int connection { -1 };
+    bool is_hung_up { false };
+};
+
+class Reader {
+public:
+    explicit Reader(std::string_view data)
+        : m_data(data)
+    {
+    }
+
+    std::optional<uint32_t> u32()
+    {
+        uint32_t value = 0;
+        if (m_data.size() < sizeof(value))
+            return std::nullopt;
+        std::memcpy(&value, m_data.data(), sizeof(value));
+        m_data.remove_prefix(sizeof(value));
+        return value;
+    }
+
+    std::optional<std::string> string()
+    {
+        auto size = u32();
+        if (!size.has_value() || m_data.size() < size.value())
+            return std::nullopt;
+        std::string text { m_data.substr(0, size.value()) };
+        m_data.remove_prefix(size.value());
+        return text;
+    }
+
+    std::optional<std::vector<std::string>> strings()
+    {
+        auto count = u32();
+        if (!count.has_value())
+            return std::nullopt;
+
+        std::vector<std::string> texts;
+        for (uint32_t i = 0; i < count.value(); i++) {
+            auto text = string();
+            if (!text.has_value())
+                return std::nullopt;
+            texts.push_back(std::move(text.value()));
+        }
+        return texts;
+    }
+
+private:
+    std::string_view m_data;
+};
+
+// Receives the bytes that fill the buffer along with up to fds.size() descriptors.
+bool receive_with_fds(int socket_fd, char* data, size_t size, std::span<int> fds)
+{
+    std::array<char, CMSG_SPACE(sizeof(int) * passed_fd_count)> control {};
+    iovec vector { .iov_base = data, .iov_len = size };
+    msghdr message {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    ssize_t nread;
+    do {
+        nread = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    } while (nread < 0 && errno == EINTR);
+
+    for (auto* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        auto count = std::min((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int), fds.size());
+        std::memcpy(fds.data(), CMSG_DATA(cmsg), count * sizeof(int));
+    }
+
+    return nread == static_cast<ssize_t>(size) && !(message.msg_flags & MSG_CTRUNC);
+}
+
+bool send_fd(int socket_fd, int fd)
+{
+    char byte = 0;
+    std::array<char, CMSG_SPACE(sizeof(int))> control {};
+    iovec vector { .iov_base = &byte, .iov_len = sizeof(byte) };
+    msghdr message {};
+    message.msg_iov = &vector;
+    message.msg_iovlen = 1;
+    message.msg_control = control.data();
+    message.msg_controllen = control.size();
+
+    auto* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    ssize_t nsent;
+    do {
+        nsent = sendmsg(socket_fd, &message, MSG_NOSIGNAL);
+    } while (nsent < 0 && errno == EINTR);
+    return nsent == sizeof(byte);
+}
+
+std::optional<Request> receive_request(int connection)
+{
+    Request request;
+    std::array<char, 2 * sizeof(uint32_t)> header {};
+    auto is_received = receive_with_fds(connection, header.data(), header.size(), request.fds);
+
+    auto fail = [&request]() -> std::optional<Request> {
+        request.close_fds();
+        return std::nullopt;
+    };
+    if (!is_received)
+        return fail();
+
+    Reader header_reader { { header.data(), header.size() } };
+    auto request_version = header_reader.u32();
+    auto size = header_reader.u32();
+    if (request_version != version || size.value() > max_request_size)
+        return fail();
+
+    std::string payload(size.value(), '\0');
+    if (!read_all(connection, payload.data(), payload.size()))
+        return fail();
+
+    Reader reader { payload };
+    auto working_directory = reader.string();
+    auto arguments = reader.strings();
+    auto environment = reader.strings();
+    if (!working_directory.has_value() || !arguments.has_value() || arguments->empty() || !environment.has_value())
+        return fail();
+
+    for (auto fd : request.fds) {
+        if (fd < 0)
+            return fail();
+    }
+
+    request.working_directory = std::move(working_directory.value());
+    request.arguments = std::move(arguments.value());
+    request.environment = std::move(environment.value());
+    return request;
+}
+
+// Runs the request as "sh -c" would. The server is the one to tell the client how it
+// went, as only it can tell when the child was killed by a signal.
+[[noreturn]] void run_request(Request& request)
+{
+    for (size_t fd = 0; fd < passed_fd_count; fd++) {
+        if (dup2(request.fds[fd], static_cast<int>(fd)) < 0)
+            _exit(126);
+    }
+    request.close_fds();
+
+    if (chdir(request.working_directory.c_str()) < 0) {
+        std::cerr << "ratsh: " << request.working_directory << ": " << strerror(errno) << "\n";
+        _exit(1);
+    }
+
+    // The strings outlive the environment, as this process never returns.
+    clearenv();
+    for (auto& variable : request.environment)
+        putenv(variable.data());
+
+    int rc;
+    {
+        Shell shell;
+        auto& arguments = request.arguments;
+        if (arguments.size() > 1)
+            shell.set_name(arguments[1]);
+        if (arguments.size() > 2)
+            shell.positional_parameters().assign(arguments.begin() + 2, arguments.end());
+
+        arguments[0].push_back('\n');
+        rc = shell.run_script(arguments[0]);
+    }
+
+    std::cout.flush();
+    _exit(rc);
+}
+
+[[noreturn]] void run_spare(int channel)
+{
+    // Its own session keeps what it runs from being stopped for using the client's terminal,
+    // and lets a hangup reach all of it.
+    setsid();
+
+    // Writing to the pages now copies them before there's a request waiting on it.
+    {
+        Shell shell;
+        shell.run_script("true\n");
+    }
+
+    std::array<int, 1> connection { -1 };
+    char byte;
+    if (!receive_with_fds(channel, &byte, sizeof(byte), connection) || connection[0] < 0)
+        _exit(0);
+    close(channel);
+
+    auto request = receive_request(connection[0]);
+    close(connection[0]);
+    if (!request.has_value())
+        _exit(2);
+    run_request(request.value());
+}
+
+std::optional<Spare> fork_spare(int listener, std::vector<Job> const& jobs)
+{
+    std::array<int, 2> channel {};
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel.data()) < 0)
+        return std::nullopt;
+
+    std::cout.flush();
+    auto pid = fork();
+    if (pid == 0) {
+        close(listener);
+        close(channel[0]);
+        for (auto const& job : jobs) {
+            close(job.pidfd);
+            close(job.connection);
+        }
+        run_spare(channel[1]);
+    }
+    close(channel[1]);
+
+    if (pid < 0) {
+        close(channel[0]);
+        return std::nullopt;
+    }
+
+    auto pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+    if (pidfd >= 0)
+        fcntl(pidfd, F_SETFD, FD_CLOEXEC);
+    return Spare { .pid = pid, .pidfd = pidfd, .channel = channel[0] };
+}
+
+// Only the user the server runs as may have it run commands, as they'd run with its
+// privileges.
+bool is_from_same_user(int connection)
+{
+    ucred credentials {};
+    socklen_t length = sizeof(credentials);
+    if (getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &credentials, &length) < 0)
+        return false;
+    return credentials.uid == geteuid();
+}
+
+void finish_job(Job& job)
+{
+    int status = 0;
+    while (waitpid(job.pid, &status, 0) < 0 && errno == EINTR)
+        ;
+
+    uint32_t rc = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    send_all(job.connection, reinterpret_cast<char const*>(&rc), sizeof(rc));
+
+    close(job.connection);
+    if (job.pidfd >= 0)
+        close(job.pidfd);
+}
+
+} // namespace
+
+int run_fork_server(std::string const& socket_path)
+{
+    auto address = address_of(socket_path);
+    if (!address.has_value()) {
+        std::cerr << "ratsh: " << socket_path << ": socket path too long\n";
+        return 2;
+    }
+
+    auto listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    // A socket left behind by a server that's gone is in the way of binding a new one.
+    struct stat st {};
+    if (lstat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path.c_str());
+
+    // The socket is created without any access for others, so that no one else can even
+    // connect to it.
+    auto old_mask = umask(0177);
+    auto bound = bind(listener, reinterpret_cast<sockaddr const*>(&address.value()), sizeof(sockaddr_un));
+    umask(old_mask);
+
+    if (bound < 0 || listen(listener, SOMAXCONN) < 0) {
+        std::cerr << "ratsh: " << socket_path << ": " << strerror(errno) << "\n";
+        close(listener);
+        return 1;
+    }
+
+    // Run something once, so that what every child runs is already paged in and bound.
+    {
+        Shell shell;
+        shell.run_script("true\n");
+    }
+
+    std::vector<Job> jobs;
+    std::vector<pollfd> pollfds;
+    std::optional<Spare> spare;
+
+    while (true) {
+        // Forking the next spare while a job runs would take time away from it when there
+        // are fewer processors than jobs, so it waits until they're done.
+        if (!spare.has_value() && jobs.empty())
+            spare = fork_spare(listener, jobs);
+
+        pollfds.clear();
+        pollfds.push_back({ .fd = listener, .events = POLLIN, .revents = 0 });
+        for (auto const& job : jobs) {
+            pollfds.push_back({ .fd = job.pidfd, .events = POLLIN, .revents = 0 });
+            pollfds.push_back({ .fd = job.is_hung_up ? -1 : job.connection, .events = POLLRDHUP, .revents = 0 });
+        }
+
+        if (poll(pollfds.data(), pollfds.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            return 1;
+        }
+
+        // Going backwards keeps the indices of the jobs still to be looked at.
+        for (size_t i = jobs.size(); i-- > 0;) {
+            auto& job = jobs[i];
+            if (pollfds[1 + 2 * i].revents != 0) {
+                finish_job(job);
+                jobs.erase(jobs.begin() + i);
+                continue;
+            }
+            // The client went away, as it would when its terminal hangs up.
+            if (pollfds[2 + 2 * i].revents != 0) {
+                kill(-job.pid, SIGHUP);
+                job.is_hung_up = true;
+            }
+        }
+
+        if (!(pollfds[0].revents & POLLIN))
+            continue;
+
+        auto connection = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (connection < 0)
+            continue;
+        if (!is_from_same_user(connection)) {
+            close(connection);
+            continue;
+        }
+
+        if (!spare.has_value())
+            spare = fork_spare(listener, jobs);
+        if (!spare.has_value()) {
+            uint32_t rc = 126;
+            send_all(connection, reinterpret_cast<char const*>(&rc), sizeof(rc));
+            close(connection);
+            continue;
+        }
+
+        // The spare reads the request itself, and is waited for like any other job.
+        Job job { .pid = spare->pid, .pidfd = spare->pidfd, .connection = connection };
+        if (!send_fd(spare->channel, connection))
+            kill(spare->pid, SIGKILL);
+        close(spare->channel);
+        spare.reset();
+
+        // Without a pidfd to wait on, the job has to be waited for right away.
+        if (job.pidfd < 0)
+            finish_job(job);
+        else
+            jobs.push_back(job);
+    }
+}
+
+} // namespace RatShell
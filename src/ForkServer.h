@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+
+namespace RatShell {
+
+// A shell that waits on a Unix socket for command strings to run. For each one it forks a
+// child from its already initialized state, which saves the client from starting a shell
+// of its own. The client's standard input, output and error are passed along with
+// SCM_RIGHTS, together with its environment and working directory, and the exit status
+// is sent back once the child is done. Runs until it's killed.
+int run_fork_server(std::string const& socket_path);
+
+// Runs a command string through a fork server as "sh -c" would, where the arguments are
+// the command string, optionally followed by the command name and its arguments. Returns
+// the exit status, or nothing if the server couldn't be reached.
+std::optional<int> run_fork_client(std::string const& socket_path, std::span<char const* const> arguments);
+
+} // namespace RatShell
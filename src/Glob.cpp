@@ -0,0 +1,598 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Glob.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <clocale>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+// The kernel's record layout for getdents64(2), which glibc doesn't export.
+struct LinuxDirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+constexpr auto cached_listing_lifetime = std::chrono::seconds(5);
+constexpr size_t max_cached_listings = 1 << 16;
+
+bool is_dot_or_dot_dot(std::string_view name)
+{
+    return name == "." || name == "..";
+}
+
+bool is_directory(std::string const& path, unsigned char type, bool follow_symlinks)
+{
+    if (type == DT_DIR)
+        return true;
+    if (type != DT_UNKNOWN && (type != DT_LNK || !follow_symlinks))
+        return false;
+
+    struct stat st {};
+    if (fstatat(AT_FDCWD, path.c_str(), &st, follow_symlinks ? 0 : AT_SYMLINK_NOFOLLOW) < 0)
+        return false;
+    return S_ISDIR(st.st_mode);
+}
+
+bool timespec_equal(timespec const& a, timespec const& b)
+{
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+using CharacterClass = int (*)(int);
+
+CharacterClass character_class_from(std::string_view name)
+{
+    if (name == "alnum")
+        return isalnum;
+    if (name == "alpha")
+        return isalpha;
+    if (name == "blank")
+        return isblank;
+    if (name == "cntrl")
+        return iscntrl;
+    if (name == "digit")
+        return isdigit;
+    if (name == "graph")
+        return isgraph;
+    if (name == "lower")
+        return islower;
+    if (name == "print")
+        return isprint;
+    if (name == "punct")
+        return ispunct;
+    if (name == "space")
+        return isspace;
+    if (name == "upper")
+        return isupper;
+    if (name == "xdigit")
+        return isxdigit;
+
+    return nullptr;
+}
+
+// Parses a bracket expression starting just after its '['. Returns the index one past
+// its closing ']', or std::string_view::npos if the bracket is not terminated (in which
+// case the '[' is an ordinary character).
+size_t parse_bracket(std::string_view pattern, size_t index, std::bitset<256>& set)
+{
+    bool negate = false;
+    if (index < pattern.size() && (pattern[index] == '!' || pattern[index] == '^')) {
+        negate = true;
+        index++;
+    }
+
+    bool first = true;
+    while (index < pattern.size()) {
+        auto ch = static_cast<unsigned char>(pattern[index]);
+
+        if (ch == ']' && !first) {
+            if (negate)
+                set.flip();
+            return index + 1;
+        }
+        first = false;
+
+        // Character classes, e.g. [:alpha:].
+        if (ch == '[' && index + 1 < pattern.size() && pattern[index + 1] == ':') {
+            auto end = pattern.find(":]", index + 2);
+            if (end != std::string_view::npos) {
+                auto is_member = character_class_from(pattern.substr(index + 2, end - index - 2));
+                for (int c = 0; c < 256 && is_member != nullptr; c++) {
+                    if (is_member(c) != 0)
+                        set.set(c);
+                }
+                index = end + 2;
+                continue;
+            }
+        }
+
+        if (ch == '\\' && index + 1 < pattern.size())
+            ch = static_cast<unsigned char>(pattern[++index]);
+        index++;
+
+        // Ranges, e.g. a-z. A '-' right before the closing ']' is taken literally.
+        if (index + 1 < pattern.size() && pattern[index] == '-' && pattern[index + 1] != ']') {
+            auto end = static_cast<unsigned char>(pattern[index + 1]);
+            index += 2;
+            if (end == '\\' && index < pattern.size())
+                end = static_cast<unsigned char>(pattern[index++]);
+            for (unsigned c = ch; c <= end; c++)
+                set.set(c);
+            continue;
+        }
+
+        set.set(ch);
+    }
+
+    return std::string_view::npos;
+}
+
+} // namespace
+
+namespace RatShell {
+
+std::shared_ptr<DirectoryListing> DirectoryListing::read(int dir_fd)
+{
+    auto listing = std::make_shared<DirectoryListing>();
+    alignas(LinuxDirent64) char buffer[32 * 1024];
+
+    while (true) {
+        auto nread = syscall(SYS_getdents64, dir_fd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            if (errno == EINTR)
+                continue;
+            return nullptr;
+        }
+        if (nread == 0)
+            break;
+
+        for (long offset = 0; offset < nread;) {
+            auto const* dirent = reinterpret_cast<LinuxDirent64 const*>(buffer + offset);
+            offset += dirent->d_reclen;
+
+            std::string_view name { dirent->d_name };
+            if (is_dot_or_dot_dot(name))
+                continue;
+
+            listing->m_entries.push_back(Entry {
+                .offset = static_cast<uint32_t>(listing->m_names.size()),
+                .length = static_cast<uint32_t>(name.size()),
+                .type = dirent->d_type,
+            });
+            listing->m_names.append(name);
+        }
+    }
+
+    return listing;
+}
+
+std::shared_ptr<DirectoryListing const> DirectoryCache::get(std::string const& path)
+{
+    auto fd = open(path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return nullptr;
+
+    struct stat st {};
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard lock { m_mutex };
+        if (auto it = m_listings.find(path); it != m_listings.end()) {
+            auto const& cached = it->second;
+            if (cached.device == st.st_dev && cached.inode == st.st_ino && timespec_equal(cached.mtime, st.st_mtim) && now < cached.expires_at) {
+                close(fd);
+                return cached.listing;
+            }
+            m_listings.erase(it);
+        }
+    }
+
+    std::shared_ptr<DirectoryListing const> listing = DirectoryListing::read(fd);
+    close(fd);
+
+    if (!listing)
+        return nullptr;
+
+    /// NOTE: A directory modified within the last second may be modified again without
+    // its mtime visibly changing (the file system's timestamp granularity is coarser
+    // than our clock), so such listings are not worth trusting later.
+    timespec wall_clock {};
+    clock_gettime(CLOCK_REALTIME, &wall_clock);
+    if (st.st_mtim.tv_sec >= wall_clock.tv_sec - 1)
+        return listing;
+
+    std::lock_guard lock { m_mutex };
+    if (m_listings.size() >= max_cached_listings) {
+        std::erase_if(m_listings, [now](auto const& item) { return item.second.expires_at <= now; });
+        if (m_listings.size() >= max_cached_listings)
+            m_listings.clear();
+    }
+
+    m_listings[path] = CachedListing {
+        .listing = listing,
+        .device = st.st_dev,
+        .inode = st.st_ino,
+        .mtime = st.st_mtim,
+        .expires_at = now + cached_listing_lifetime,
+    };
+
+    return listing;
+}
+
+void DirectoryCache::clear()
+{
+    std::lock_guard lock { m_mutex };
+    m_listings.clear();
+}
+
+GlobPattern GlobPattern::compile(std::string_view segment)
+{
+    GlobPattern pattern;
+    std::string literals;
+
+    auto push_literal = [&](char ch) {
+        if (pattern.m_ops.empty() || pattern.m_ops.back().type != Op::Type::Literal)
+            pattern.m_ops.push_back(Op { .type = Op::Type::Literal, .index = static_cast<uint32_t>(literals.size()), .length = 0 });
+        literals += ch;
+        pattern.m_ops.back().length++;
+    };
+
+    for (size_t i = 0; i < segment.size(); i++) {
+        auto ch = segment[i];
+
+        switch (ch) {
+        case '\\':
+            if (i + 1 < segment.size())
+                ch = segment[++i];
+            push_literal(ch);
+            break;
+        case '?':
+            pattern.m_ops.push_back(Op { .type = Op::Type::AnyChar });
+            break;
+        case '*':
+            // Consecutive asterisks are no different from a single one.
+            if (pattern.m_ops.empty() || pattern.m_ops.back().type != Op::Type::AnyString)
+                pattern.m_ops.push_back(Op { .type = Op::Type::AnyString });
+            break;
+        case '[': {
+            std::bitset<256> set;
+            auto end = parse_bracket(segment, i + 1, set);
+            if (end == std::string_view::npos) {
+                push_literal(ch);
+                break;
+            }
+            pattern.m_ops.push_back(Op { .type = Op::Type::Bracket, .index = static_cast<uint32_t>(pattern.m_brackets.size()) });
+            pattern.m_brackets.push_back(set);
+            i = end - 1;
+            break;
+        }
+        default:
+            push_literal(ch);
+            break;
+        }
+    }
+
+    auto const& ops = pattern.m_ops;
+
+    // (2.13.3) A leading period in a filename shall only be matched by a period in the
+    // pattern.
+    pattern.m_matches_leading_period = !ops.empty() && ops[0].type == Op::Type::Literal && literals[ops[0].index] == '.';
+
+    auto literal_of = [&](Op const& op) { return literals.substr(op.index, op.length); };
+
+    if (ops.empty()) {
+        pattern.m_kind = Kind::Literal;
+    } else if (ops.size() == 1 && ops[0].type == Op::Type::Literal) {
+        pattern.m_kind = Kind::Literal;
+        pattern.m_literal = literal_of(ops[0]);
+    } else if (ops.size() == 1 && ops[0].type == Op::Type::AnyString) {
+        pattern.m_kind = Kind::MatchAll;
+    } else if (ops.size() == 2 && ops[0].type == Op::Type::AnyString && ops[1].type == Op::Type::Literal) {
+        pattern.m_kind = Kind::Suffix;
+        pattern.m_literal = literal_of(ops[1]);
+    } else if (ops.size() == 2 && ops[0].type == Op::Type::Literal && ops[1].type == Op::Type::AnyString) {
+        pattern.m_kind = Kind::Prefix;
+        pattern.m_literal = literal_of(ops[0]);
+    } else {
+        pattern.m_kind = Kind::General;
+        pattern.m_literal = std::move(literals);
+    }
+
+    return pattern;
+}
+
+bool GlobPattern::has_magic(std::string_view pattern)
+{
+    for (size_t i = 0; i < pattern.size(); i++) {
+        switch (pattern[i]) {
+        case '\\':
+            i++;
+            break;
+        case '*':
+        case '?':
+            return true;
+        case '[': {
+            std::bitset<256> set;
+            if (parse_bracket(pattern, i + 1, set) != std::string_view::npos)
+                return true;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    return false;
+}
+
+bool GlobPattern::matches(std::string_view name) const
+{
+    if (name.starts_with('.') && !m_matches_leading_period)
+        return m_kind == Kind::Literal && name == m_literal;
+
+    switch (m_kind) {
+    case Kind::Literal:
+        return name == m_literal;
+    case Kind::MatchAll:
+        return true;
+    case Kind::Prefix:
+        return name.starts_with(m_literal);
+    case Kind::Suffix:
+        return name.ends_with(m_literal);
+    case Kind::General:
+        return matches_general(name);
+    }
+
+    return false;
+}
+
+bool GlobPattern::matches_general(std::string_view name) const
+{
+    size_t op_index = 0;
+    size_t position = 0;
+
+    // Where to resume from when a match fails after an asterisk, which then consumes
+    // one more character.
+    std::optional<size_t> star_op_index;
+    size_t star_position = 0;
+
+    while (true) {
+        if (op_index < m_ops.size()) {
+            auto const& op = m_ops[op_index];
+            bool matched = false;
+
+            switch (op.type) {
+            case Op::Type::AnyString:
+                star_op_index = op_index++;
+                star_position = position;
+                continue;
+            case Op::Type::AnyChar:
+                matched = position < name.size();
+                if (matched)
+                    position++;
+                break;
+            case Op::Type::Literal: {
+                auto literal = std::string_view { m_literal }.substr(op.index, op.length);
+                matched = name.substr(position).starts_with(literal);
+                if (matched)
+                    position += literal.size();
+                break;
+            }
+            case Op::Type::Bracket:
+                matched = position < name.size() && m_brackets[op.index].test(static_cast<unsigned char>(name[position]));
+                if (matched)
+                    position++;
+                break;
+            }
+
+            if (matched) {
+                op_index++;
+                continue;
+            }
+        } else if (position == name.size()) {
+            return true;
+        }
+
+        if (!star_op_index.has_value() || star_position >= name.size())
+            return false;
+
+        op_index = star_op_index.value() + 1;
+        position = ++star_position;
+    }
+}
+
+std::vector<std::string> Glob::expand(std::string_view pattern, Options options)
+{
+    if (pattern.empty() || !GlobPattern::has_magic(pattern))
+        return {};
+
+    // Each prefix is either empty (the current directory) or ends with a slash.
+    std::vector<std::string> prefixes;
+    if (pattern.starts_with('/')) {
+        prefixes.emplace_back("/");
+        pattern.remove_prefix(pattern.find_first_not_of('/') == std::string_view::npos ? pattern.size() : pattern.find_first_not_of('/'));
+    } else {
+        prefixes.emplace_back();
+    }
+
+    std::vector<std::string_view> segments;
+    while (true) {
+        auto slash = pattern.find('/');
+        segments.push_back(pattern.substr(0, slash));
+        if (slash == std::string_view::npos)
+            break;
+        pattern.remove_prefix(slash + 1);
+    }
+
+    // A trailing "**" matches every file below the directory, just like "**/*".
+    if (options.globstar && segments.back() == "**")
+        segments.emplace_back("*");
+
+    bool needs_existence_check = false;
+
+    for (size_t i = 0; i < segments.size(); i++) {
+        auto segment = segments[i];
+        bool is_last = i == segments.size() - 1;
+
+        if (options.globstar && segment == "**") {
+            prefixes = walk_subdirectories(prefixes);
+            continue;
+        }
+
+        auto compiled = GlobPattern::compile(segment);
+        std::vector<std::string> next_prefixes;
+
+        if (compiled.is_literal()) {
+            // No need to read the directory, just carry the component along.
+            for (auto& prefix : prefixes)
+                next_prefixes.push_back(prefix + compiled.literal() + (is_last ? "" : "/"));
+            needs_existence_check = is_last;
+        } else {
+            for (auto const& prefix : prefixes) {
+                auto listing = m_cache.get(prefix);
+                if (!listing)
+                    continue;
+
+                for (size_t entry = 0; entry < listing->size(); entry++) {
+                    auto name = listing->name(entry);
+                    if (!compiled.matches(name))
+                        continue;
+
+                    auto path = prefix;
+                    path += name;
+
+                    if (!is_last) {
+                        if (!is_directory(path, listing->type(entry), true))
+                            continue;
+                        path += '/';
+                    }
+                    next_prefixes.push_back(std::move(path));
+                }
+            }
+        }
+
+        prefixes = std::move(next_prefixes);
+        if (prefixes.empty())
+            return {};
+    }
+
+    if (needs_existence_check) {
+        std::erase_if(prefixes, [](std::string const& path) {
+            struct stat st {};
+            return lstat(path.c_str(), &st) < 0;
+        });
+    }
+
+    sort(prefixes);
+    return prefixes;
+}
+
+Glob::~Glob()
+{
+    // Joining threads that only ever ran in the parent would never return.
+    if (m_thread_pool && m_thread_pool_pid != getpid())
+        static_cast<void>(m_thread_pool.release());
+}
+
+ThreadPool& Glob::thread_pool()
+{
+    // A forked child can't use its parent's pool, nor join it, so it leaves that one be
+    // and starts its own.
+    if (m_thread_pool && m_thread_pool_pid != getpid())
+        static_cast<void>(m_thread_pool.release());
+
+    if (!m_thread_pool) {
+        m_thread_pool = std::make_unique<ThreadPool>();
+        m_thread_pool_pid = getpid();
+    }
+    return *m_thread_pool;
+}
+
+std::vector<std::string> Glob::walk_subdirectories(std::vector<std::string> const& roots)
+{
+    auto& pool = thread_pool();
+
+    std::mutex results_mutex;
+    std::vector<std::string> results { roots };
+
+    // Every directory is its own task so that large subtrees spread across workers.
+    std::function<void(std::string const&)> visit = [&](std::string const& directory) {
+        auto listing = m_cache.get(directory);
+        if (!listing)
+            return;
+
+        std::vector<std::string> children;
+        for (size_t entry = 0; entry < listing->size(); entry++) {
+            auto name = listing->name(entry);
+            if (name.starts_with('.'))
+                continue;
+
+            auto path = directory;
+            path += name;
+
+            // Symbolic links are not followed so that cycles can't make us walk forever.
+            if (!is_directory(path, listing->type(entry), false))
+                continue;
+
+            path += '/';
+            children.push_back(std::move(path));
+        }
+
+        {
+            std::lock_guard lock { results_mutex };
+            results.insert(results.end(), children.begin(), children.end());
+        }
+
+        for (auto& child : children)
+            pool.enqueue([&visit, child = std::move(child)] { visit(child); });
+    };
+
+    for (auto const& root : roots)
+        pool.enqueue([&visit, &root] { visit(root); });
+    pool.wait();
+
+    return results;
+}
+
+void Glob::sort(std::vector<std::string>& paths) const
+{
+    // (2.13.3) The pathnames shall be sorted according to the collating sequence in
+    // effect in the current locale.
+    auto const* collate = std::setlocale(LC_COLLATE, nullptr);
+    if (collate == nullptr || std::strcmp(collate, "C") == 0 || std::strcmp(collate, "POSIX") == 0) {
+        std::sort(paths.begin(), paths.end());
+        return;
+    }
+
+    std::sort(paths.begin(), paths.end(), [](std::string const& a, std::string const& b) {
+        auto rc = std::strcoll(a.c_str(), b.c_str());
+        if (rc != 0)
+            return rc < 0;
+        return a < b;
+    });
+}
+
+} // namespace RatShell
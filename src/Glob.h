@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include "ThreadPool.h"
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+namespace RatShell {
+
+// The entries of a single directory, read with getdents64(2). All names live in one
+// arena so that a listing costs two allocations no matter how many entries it has.
+class DirectoryListing {
+public:
+    struct Entry {
+        uint32_t offset { 0 };
+        uint32_t length { 0 };
+        unsigned char type { 0 }; // One of the DT_* constants.
+    };
+
+    static std::shared_ptr<DirectoryListing> read(int dir_fd);
+
+    size_t size() const { return m_entries.size(); }
+    std::string_view name(size_t index) const { return { m_names.data() + m_entries[index].offset, m_entries[index].length }; }
+    unsigned char type(size_t index) const { return m_entries[index].type; }
+
+private:
+    std::string m_names;
+    std::vector<Entry> m_entries;
+};
+
+// Keeps recently read directory listings around so that repeated globs (e.g. in a
+// loop) don't hit the file system again. A listing is reused only while the
+// directory's mtime is unchanged and it hasn't outlived its short lifetime.
+class DirectoryCache {
+public:
+    std::shared_ptr<DirectoryListing const> get(std::string const& path);
+    void clear();
+
+private:
+    struct CachedListing {
+        std::shared_ptr<DirectoryListing const> listing;
+        dev_t device { 0 };
+        ino_t inode { 0 };
+        timespec mtime {};
+        std::chrono::steady_clock::time_point expires_at;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, CachedListing> m_listings;
+};
+
+// A compiled matcher for one pathname component (2.13.1 and 2.13.3 of POSIX).
+class GlobPattern {
+public:
+    static GlobPattern compile(std::string_view segment);
+
+    // Returns whether the segment contains unescaped pattern characters at all.
+    static bool has_magic(std::string_view pattern);
+
+    bool matches(std::string_view name) const;
+
+    bool is_literal() const { return m_kind == Kind::Literal; }
+    std::string const& literal() const { return m_literal; }
+
+private:
+    enum class Kind {
+        Literal,
+        MatchAll,
+        Prefix,
+        Suffix,
+        General
+    };
+
+    struct Op {
+        enum class Type : uint8_t {
+            Literal,
+            AnyChar,
+            AnyString,
+            Bracket
+        };
+
+        Type type { Type::Literal };
+        uint32_t index { 0 };
+        uint32_t length { 0 };
+    };
+
+    bool matches_general(std::string_view name) const;
+
+    Kind m_kind { Kind::Literal };
+    std::string m_literal;
+    std::vector<Op> m_ops;
+    std::vector<std::bitset<256>> m_brackets;
+    bool m_matches_leading_period { false };
+};
+
+class Glob {
+public:
+    struct Options {
+        // Whether a "**" component matches any number of directories.
+        bool globstar { false };
+    };
+
+    Glob() = default;
+    ~Glob();
+
+    // Returns the sorted pathnames matching the pattern, or nothing if none matched.
+    std::vector<std::string> expand(std::string_view pattern, Options options);
+
+    DirectoryCache& cache() { return m_cache; }
+
+private:
+    std::vector<std::string> walk_subdirectories(std::vector<std::string> const& roots);
+    ThreadPool& thread_pool();
+    void sort(std::vector<std::string>& paths) const;
+
+    DirectoryCache m_cache;
+    std::unique_ptr<ThreadPool> m_thread_pool;
+    // The process the pool's threads run in. A forked child gets the pool without them.
+    pid_t m_thread_pool_pid { 0 };
+};
+
+} // namespace RatShell
@@ -0,0 +1,442 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "History.h"
+#include "FileDescription.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include <utility>
+
+namespace RatShell {
+
+namespace {
+
+void append_escaped(std::string& out, std::string_view entry)
+{
+    for (auto ch : entry) {
+        if (ch == '\n')
+            out += "\\n";
+        else if (ch == '\\')
+            out += "\\\\";
+        else
+            out += ch;
+    }
+}
+
+std::string unescape(std::string_view record)
+{
+    std::string entry;
+    entry.reserve(record.size());
+    for (size_t i = 0; i < record.size(); i++) {
+        if (record[i] == '\\' && i + 1 < record.size()) {
+            entry += record[++i] == 'n' ? '\n' : record[i];
+            continue;
+        }
+        entry += record[i];
+    }
+    return entry;
+}
+
+uint32_t trigram_of(unsigned char a, unsigned char b, unsigned char c)
+{
+    return (uint32_t { a } << 16) | (uint32_t { b } << 8) | c;
+}
+
+bool write_all(int fd, std::string_view data)
+{
+    while (!data.empty()) {
+        auto nwritten = write(fd, data.data(), data.size());
+        if (nwritten < 0 && errno == EINTR)
+            continue;
+        if (nwritten <= 0)
+            return false;
+        data.remove_prefix(nwritten);
+    }
+    return true;
+}
+
+bool lock(int fd, int operation)
+{
+    while (flock(fd, operation) < 0) {
+        if (errno != EINTR)
+            return false;
+    }
+    return true;
+}
+
+// Whether the file was replaced by a compaction since it was opened.
+bool is_unlinked(int fd)
+{
+    struct stat st {};
+    return fstat(fd, &st) == 0 && st.st_nlink == 0;
+}
+
+} // namespace
+
+History::History(History&& other) noexcept
+    : m_path(std::move(other.m_path))
+    , m_fd(std::exchange(other.m_fd, -1))
+    , m_max_entries(other.m_max_entries)
+    , m_data(std::exchange(other.m_data, nullptr))
+    , m_mapped_size(std::exchange(other.m_mapped_size, 0))
+    , m_offsets(std::move(other.m_offsets))
+    , m_indexed_end(std::exchange(other.m_indexed_end, 0))
+    , m_has_trigrams(std::exchange(other.m_has_trigrams, false))
+    , m_trigrams(std::move(other.m_trigrams))
+{
+}
+
+History& History::operator=(History&& other) noexcept
+{
+    if (this != &other) {
+        unmap();
+        if (m_fd >= 0)
+            close(m_fd);
+
+        m_path = std::move(other.m_path);
+        m_fd = std::exchange(other.m_fd, -1);
+        m_max_entries = other.m_max_entries;
+        m_data = std::exchange(other.m_data, nullptr);
+        m_mapped_size = std::exchange(other.m_mapped_size, 0);
+        m_offsets = std::move(other.m_offsets);
+        m_indexed_end = std::exchange(other.m_indexed_end, 0);
+        m_has_trigrams = std::exchange(other.m_has_trigrams, false);
+        m_trigrams = std::move(other.m_trigrams);
+    }
+    return *this;
+}
+
+History::~History()
+{
+    unmap();
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+std::optional<History> History::open(std::string path, size_t max_entries)
+{
+    auto fd = move_to_shell_range(::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600));
+    if (fd < 0)
+        return std::nullopt;
+
+    History history { std::move(path), fd, max_entries };
+    if (!history.refresh())
+        return std::nullopt;
+    return history;
+}
+
+bool History::append(std::string_view entry)
+{
+    if (entry.find_first_not_of(" \t\n") == std::string_view::npos)
+        return true;
+
+    if (!refresh())
+        return false;
+    if (size() > 0 && this->entry(size() - 1) == entry)
+        return true;
+
+    std::string record;
+    append_escaped(record, entry);
+    record += '\n';
+
+    // Appenders only share the lock, so they never wait on one another, just on a
+    // compaction that's replacing the file.
+    while (true) {
+        if (!lock(m_fd, LOCK_SH))
+            return false;
+        if (!is_unlinked(m_fd))
+            break;
+        lock(m_fd, LOCK_UN);
+        if (!reopen())
+            return false;
+    }
+
+    // O_APPEND makes the write land at the end whatever the others are doing, and a single
+    // write to a regular file isn't interleaved with theirs.
+    ssize_t nwritten;
+    do {
+        nwritten = write(m_fd, record.data(), record.size());
+    } while (nwritten < 0 && errno == EINTR);
+    lock(m_fd, LOCK_UN);
+
+    if (nwritten != static_cast<ssize_t>(record.size()))
+        return false;
+    if (!refresh())
+        return false;
+
+    if (m_max_entries > 0 && size() > m_max_entries + m_max_entries / 4)
+        return compact();
+    return true;
+}
+
+bool History::refresh()
+{
+    if (is_unlinked(m_fd))
+        return reopen();
+
+    struct stat st {};
+    if (fstat(m_fd, &st) < 0)
+        return false;
+
+    auto size = static_cast<size_t>(st.st_size);
+    if (size < m_indexed_end)
+        reset_index();
+    if (size != m_mapped_size && !map(size))
+        return false;
+    if (size == m_indexed_end)
+        return true;
+
+    // Only whole records count, since another session may be in the middle of writing one.
+    auto first = m_offsets.size();
+    auto position = m_indexed_end;
+    while (position < size) {
+        auto const* newline = static_cast<char const*>(memchr(m_data + position, '\n', size - position));
+        if (newline == nullptr)
+            break;
+        m_offsets.push_back(position);
+        position = newline - m_data + 1;
+    }
+    m_indexed_end = position;
+
+    if (m_has_trigrams)
+        index_trigrams(first);
+    return true;
+}
+
+bool History::compact()
+{
+    while (true) {
+        if (!lock(m_fd, LOCK_EX))
+            return false;
+        if (!is_unlinked(m_fd))
+            break;
+        lock(m_fd, LOCK_UN);
+        if (!reopen())
+            return false;
+    }
+
+    if (!refresh()) {
+        lock(m_fd, LOCK_UN);
+        return false;
+    }
+
+    std::unordered_set<std::string_view> seen;
+    std::vector<size_t> kept;
+    for (auto i = size(); i-- > 0 && (m_max_entries == 0 || kept.size() < m_max_entries);) {
+        if (seen.insert(record(i)).second)
+            kept.push_back(i);
+    }
+
+    std::string contents;
+    for (auto it = kept.rbegin(); it != kept.rend(); ++it) {
+        contents += record(*it);
+        contents += '\n';
+    }
+
+    // The new file takes the place of the old one all at once, so a session that crashes
+    // here leaves the history as it was.
+    auto temporary = m_path + ".XXXXXX";
+    auto temporary_fd = mkostemp(temporary.data(), O_CLOEXEC);
+    if (temporary_fd < 0) {
+        lock(m_fd, LOCK_UN);
+        return false;
+    }
+
+    auto is_written = write_all(temporary_fd, contents) && fsync(temporary_fd) == 0;
+    close(temporary_fd);
+    if (!is_written || rename(temporary.c_str(), m_path.c_str()) < 0) {
+        unlink(temporary.c_str());
+        lock(m_fd, LOCK_UN);
+        return false;
+    }
+
+    // Closing the old file lets the sessions waiting to append to it find it's been
+    // replaced.
+    return reopen();
+}
+
+std::string_view History::record(size_t index) const
+{
+    auto start = m_offsets[index];
+    auto end = index + 1 < m_offsets.size() ? m_offsets[index + 1] : m_indexed_end;
+    return { m_data + start, static_cast<size_t>(end - start - 1) };
+}
+
+std::string History::entry(size_t index) const
+{
+    return unescape(record(index));
+}
+
+bool History::contains(size_t index, std::string_view text) const
+{
+    auto raw = record(index);
+    if (raw.find('\\') == std::string_view::npos)
+        return raw.find(text) != std::string_view::npos;
+    return unescape(raw).find(text) != std::string::npos;
+}
+
+std::optional<size_t> History::search_backward(std::string_view text, size_t before)
+{
+    if (!refresh())
+        return std::nullopt;
+
+    before = std::min(before, size());
+    if (text.empty())
+        return before > 0 ? std::optional { before - 1 } : std::nullopt;
+
+    auto const* postings = candidates(text);
+    if (postings == nullptr) {
+        for (auto i = before; i-- > 0;) {
+            if (contains(i, text))
+                return i;
+        }
+        return std::nullopt;
+    }
+
+    auto end = std::lower_bound(postings->begin(), postings->end(), before);
+    for (auto it = end; it != postings->begin();) {
+        --it;
+        if (contains(*it, text))
+            return *it;
+    }
+    return std::nullopt;
+}
+
+std::vector<size_t> History::with_prefix(std::string_view prefix, size_t limit)
+{
+    std::vector<size_t> found;
+    if (!refresh())
+        return found;
+
+    std::string key(2, '\0');
+    key += prefix;
+    auto const* postings = candidates(key);
+
+    std::unordered_set<std::string_view> seen;
+    auto consider = [&](size_t index) {
+        auto raw = record(index);
+        auto matches = raw.find('\\') == std::string_view::npos ? raw.starts_with(prefix) : unescape(raw).starts_with(prefix);
+        if (matches && seen.insert(raw).second)
+            found.push_back(index);
+        return found.size() < limit;
+    };
+
+    if (postings == nullptr) {
+        for (auto i = size(); i-- > 0;) {
+            if (!consider(i))
+                break;
+        }
+        return found;
+    }
+
+    for (auto it = postings->rbegin(); it != postings->rend(); ++it) {
+        if (!consider(*it))
+            break;
+    }
+    return found;
+}
+
+std::vector<uint32_t> const* History::candidates(std::string_view text)
+{
+    if (text.size() < 3)
+        return nullptr;
+
+    if (!m_has_trigrams) {
+        m_has_trigrams = true;
+        index_trigrams(0);
+    }
+
+    static std::vector<uint32_t> const none;
+    std::vector<uint32_t> const* rarest = nullptr;
+
+    for (size_t i = 0; i + 3 <= text.size(); i++) {
+        auto it = m_trigrams.find(trigram_of(text[i], text[i + 1], text[i + 2]));
+        if (it == m_trigrams.end())
+            return &none;
+        if (rarest == nullptr || it->second.size() < rarest->size())
+            rarest = &it->second;
+    }
+    return rarest;
+}
+
+void History::index_trigrams(size_t first)
+{
+    std::string unescaped;
+    for (auto index = first; index < size(); index++) {
+        std::string_view text = record(index);
+        if (text.find('\\') != std::string_view::npos) {
+            unescaped = unescape(text);
+            text = unescaped;
+        }
+
+        // The entry starts with two NULs, so that "\0\0a" and "\0ab" mark its prefix.
+        auto at = [&text](size_t i) -> unsigned char { return i < 2 ? 0 : text[i - 2]; };
+        for (size_t i = 0; i + 3 <= text.size() + 2; i++) {
+            auto& postings = m_trigrams[trigram_of(at(i), at(i + 1), at(i + 2))];
+            if (postings.empty() || postings.back() != index)
+                postings.push_back(static_cast<uint32_t>(index));
+        }
+    }
+}
+
+void History::reset_index()
+{
+    m_offsets.clear();
+    m_indexed_end = 0;
+    m_has_trigrams = false;
+    m_trigrams.clear();
+}
+
+bool History::reopen()
+{
+    auto fd = move_to_shell_range(::open(m_path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600));
+    if (fd < 0)
+        return false;
+
+    unmap();
+    close(std::exchange(m_fd, fd));
+    reset_index();
+    return refresh();
+}
+
+bool History::map(size_t size)
+{
+    if (size == 0) {
+        unmap();
+        return true;
+    }
+
+    void* data = m_data == nullptr
+        ? mmap(nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0)
+        : mremap(const_cast<char*>(m_data), m_mapped_size, size, MREMAP_MAYMOVE);
+    if (data == MAP_FAILED) {
+        unmap();
+        reset_index();
+        return false;
+    }
+
+    m_data = static_cast<char const*>(data);
+    m_mapped_size = size;
+    return true;
+}
+
+void History::unmap()
+{
+    if (m_data != nullptr)
+        munmap(const_cast<char*>(m_data), m_mapped_size);
+    m_data = nullptr;
+    m_mapped_size = 0;
+}
+
+} // namespace RatShell
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace RatShell {
+
+// The commands entered in every session, kept in a file that any number of shells append
+// to at once. Each entry is one line, with newlines and backslashes escaped, and is added
+// with a single O_APPEND write(2) so that entries never interleave. Reading goes through
+// a mapping of the file and an index of where each entry starts, which is brought up to
+// date with whatever other sessions appended whenever it's needed.
+//
+// Searches go through an index of the trigrams in each entry, built the first time it's
+// needed, so that only entries with every trigram of the text are looked at. The start of
+// an entry counts as two NUL characters, which lets the same index find prefixes.
+class History {
+public:
+    History(History&&) noexcept;
+    History& operator=(History&&) noexcept;
+    ~History();
+
+    History(History const&) = delete;
+    History& operator=(History const&) = delete;
+
+    // Opens the file, creating it if needed. Once the file holds more than the given
+    // number of entries by a quarter, appending compacts it back down.
+    static std::optional<History> open(std::string path, size_t max_entries);
+
+    // Adds an entry, unless it's empty or the same as the latest one.
+    bool append(std::string_view entry);
+
+    // Catches up with what other sessions appended.
+    bool refresh();
+
+    // Rewrites the file with only the latest of each distinct entry, and only the latest
+    // max_entries of them. Other sessions switch to the new file the next time they use
+    // theirs, and nothing they append in the meantime is lost.
+    bool compact();
+
+    // The number of entries as of the last refresh, the oldest being 0.
+    size_t size() const { return m_offsets.size(); }
+    std::string entry(size_t index) const;
+
+    // The latest entry before the given one that contains the text.
+    std::optional<size_t> search_backward(std::string_view text, size_t before);
+    // Distinct entries that start with the prefix, the latest first.
+    std::vector<size_t> with_prefix(std::string_view prefix, size_t limit);
+
+    std::string const& path() const { return m_path; }
+
+private:
+    History(std::string path, int fd, size_t max_entries)
+        : m_path(std::move(path))
+        , m_fd(fd)
+        , m_max_entries(max_entries)
+    {
+    }
+
+    // The entry as it is in the file, escapes and all, without its newline.
+    std::string_view record(size_t index) const;
+    bool contains(size_t index, std::string_view text) const;
+
+    bool reopen();
+    bool map(size_t size);
+    void unmap();
+    void index_trigrams(size_t first);
+    void reset_index();
+
+    // The fewest entries that may contain the text, going by the trigrams in it, or null
+    // if it's too short to have any.
+    std::vector<uint32_t> const* candidates(std::string_view text);
+
+    std::string m_path;
+    int m_fd { -1 };
+    size_t m_max_entries { 0 };
+
+    char const* m_data { nullptr };
+    size_t m_mapped_size { 0 };
+    // Where each entry starts, and where the next unindexed one does.
+    std::vector<uint64_t> m_offsets;
+    uint64_t m_indexed_end { 0 };
+
+    bool m_has_trigrams { false };
+    std::unordered_map<uint32_t, std::vector<uint32_t>> m_trigrams;
+};
+
+} // namespace RatShell
@@ -5,6 +5,7 @@
  */
 
 #include "Lexer.h"
+#include <algorithm>
 #include <cctype>
 #include <string_view>
 #include <vector>
@@ -18,10 +19,14 @@ bool is_operator(std::string_view text)
 
 bool is_part_of_operator(std::string_view text, char ch)
 {
-    std::string str = text.data();
-    str += ch;
-
-    return is_operator(str);
+    // No operator is longer than three characters, so the candidate fits on the stack.
+    char candidate[3];
+    if (text.size() >= sizeof(candidate))
+        return false;
+
+    std::copy(text.begin(), text.end(), candidate);
+    candidate[text.size()] = ch;
+    return is_operator({ candidate, text.size() + 1 });
 }
 
 bool isblank(char ch)
@@ -79,6 +84,10 @@ std::string_view Token::type_str() const
         return "Great";
     case Type::Less:
         return "Less";
+    case Type::LessParen:
+        return "LessParen";
+    case Type::GreatParen:
+        return "GreatParen";
     case Type::Newline:
         return "Newline";
     case Type::Word:
@@ -96,13 +105,32 @@ std::vector<Token> Lexer::batch_next()
         auto result = transition(m_next_state_type);
         m_next_state_type = result.next_state_type;
 
-        if (!result.tokens.empty())
+        if (!result.tokens.empty()) {
+            // The newline that ended a word may have been consumed along with it.
+            auto end = m_index;
+            if (end > 0 && m_input[end - 1] == '\n' && result.tokens.front().type != Token::Type::Newline)
+                end--;
+
+            auto line = line_at(end);
+            for (auto& token : result.tokens)
+                token.line = line;
             return result.tokens;
+        }
     }
 
     return {};
 }
 
+size_t Lexer::line_at(size_t index)
+{
+    if (index >= m_line_index)
+        m_line += std::count(m_input.begin() + m_line_index, m_input.begin() + index, '\n');
+    else
+        m_line -= std::count(m_input.begin() + index, m_input.begin() + m_line_index, '\n');
+    m_line_index = index;
+    return m_line;
+}
+
 void Lexer::reset_state()
 {
     m_state.buffer.clear();
@@ -121,6 +149,8 @@ Lexer::TransitionResult Lexer::transition(StateType type)
         return transition_operator();
     case StateType::SingleQuotedString:
         return transition_single_quoted_string();
+    case StateType::DoubleQuotedString:
+        return transition_double_quoted_string();
     case StateType::IoNumber:
         return transition_io_number();
     case StateType::Comment:
@@ -184,8 +214,27 @@ Lexer::TransitionResult Lexer::transition_start()
             };
         }
 
-        /// FIXME: ... or double-quote and it is not quoted, it shall affect quoting for
+        // ... or double-quote and it is not quoted, it shall affect quoting for
         // subsequent characters up to the end of the quoted text.
+        if (peek_is('"')) {
+            m_state.buffer += consume();
+            return TransitionResult {
+                .tokens = {},
+                .next_state_type = StateType::DoubleQuotedString
+            };
+        }
+
+        // 5. If the current character is an unquoted '$' or '`', the shell shall identify
+        // the start of any candidates for parameter expansion, command substitution, or
+        // arithmetic expansion from their introductory unquoted character sequences...
+        /// FIXME: Support backquoted command substitution.
+        if (is_at_expansion()) {
+            consume_expansion();
+            return TransitionResult {
+                .tokens = {},
+                .next_state_type = StateType::Start
+            };
+        }
 
         // 6. If the current character is not quoted and can be used as the first
         // character of a new operator, the current token (if any) shall be delimited.
@@ -240,7 +289,8 @@ Lexer::TransitionResult Lexer::transition_start()
         // 9. If the current character is a '#', it and all subsequent characters up to,
         // but excluding, the next <newline> shall be discarded as a comment. The
         // <newline> that ends the line is not considered part of the comment.
-        if (peek_is('#')) {
+        /// NOTE: This only applies to a '#' starting a token, so e.g. "$#" is left alone.
+        if (peek_is('#') && m_state.buffer.empty()) {
             return TransitionResult {
                 .tokens = {},
                 .next_state_type = StateType::Comment,
@@ -347,6 +397,90 @@ Lexer::TransitionResult Lexer::transition_single_quoted_string()
     };
 }
 
+Lexer::TransitionResult Lexer::transition_double_quoted_string()
+{
+    /// FIXME: What should we do if this transition is given EOF as input?
+    if (is_eof()) {
+        return TransitionResult {
+            .tokens = {},
+            .next_state_type = StateType::Start
+        };
+    }
+
+    // (2.2.3) The <dollar-sign> shall retain its special meaning introducing parameter
+    // expansion, a form of command substitution, and arithmetic expansion.
+    if (is_at_expansion()) {
+        consume_expansion();
+        return TransitionResult {
+            .tokens = {},
+            .next_state_type = StateType::DoubleQuotedString
+        };
+    }
+
+    auto ch = consume();
+    m_state.buffer += ch;
+
+    if (ch == '\\' && !is_eof()) {
+        m_state.buffer += consume();
+    } else if (ch == '"') {
+        return TransitionResult {
+            .tokens = {},
+            .next_state_type = StateType::Start
+        };
+    }
+
+    return TransitionResult {
+        .tokens = {},
+        .next_state_type = StateType::DoubleQuotedString
+    };
+}
+
+// Consumes a "$(...)", "$((...))" or "${...}" into the current token. Its end is found by
+// tracking how deeply the brackets nest while skipping over quoted text.
+void Lexer::consume_expansion()
+{
+    m_state.buffer += consume(); // '$'
+
+    auto open = consume();
+    auto close = open == '(' ? ')' : '}';
+    size_t depth = 1;
+    m_state.buffer += open;
+
+    while (!is_eof() && depth > 0) {
+        auto ch = consume();
+        m_state.buffer += ch;
+
+        switch (ch) {
+        case '\\':
+            if (!is_eof())
+                m_state.buffer += consume();
+            break;
+        case '\'':
+            while (!is_eof() && !peek_is('\''))
+                m_state.buffer += consume();
+            if (!is_eof())
+                m_state.buffer += consume();
+            break;
+        case '"':
+            while (!is_eof() && !peek_is('"')) {
+                if (peek_is('\\'))
+                    m_state.buffer += consume();
+                if (!is_eof())
+                    m_state.buffer += consume();
+            }
+            if (!is_eof())
+                m_state.buffer += consume();
+            break;
+        default:
+            if (ch == open)
+                depth++;
+            else if (ch == close)
+                depth--;
+            break;
+        }
+    }
+}
+
 Lexer::TransitionResult Lexer::transition_io_number()
 {
     if (is_eof()) {
@@ -356,7 +490,8 @@ Lexer::TransitionResult Lexer::transition_io_number()
         };
     }
 
-    if (peek_is('<') || peek_is('>')) {
+    // The digits before a process substitution are an ordinary word.
+    if ((peek_is('<') || peek_is('>')) && peek_at(1) != '(') {
         auto token = Token { Token::Type::IoNumber, std::move(m_state.buffer) };
 
         reset_state();
@@ -18,6 +18,7 @@ enum class StateType {
     End,
     Operator,
     SingleQuotedString,
+    DoubleQuotedString,
     IoNumber,
     Comment,
 };
@@ -48,6 +49,9 @@ struct Token {
         CloseParen,
         Great,
         Less,
+        // "<(" and ">(", which start a process substitution.
+        LessParen,
+        GreatParen,
         IoNumber,
         Newline,
 
@@ -57,6 +61,8 @@ struct Token {
 
     Type type;
     std::string value;
+    // The line the token ends on, counting from 1.
+    size_t line { 0 };
 
     static std::optional<Token> generic_token_from(State const& state)
     {
@@ -108,6 +114,10 @@ struct Token {
             return Token::Type::Great;
         if (text == "<")
             return Token::Type::Less;
+        if (text == "<(")
+            return Token::Type::LessParen;
+        if (text == ">(")
+            return Token::Type::GreatParen;
         if (text == "\n")
             return Token::Type::Newline;
 
@@ -174,6 +184,13 @@ public:
 
     bool peek_is(char expected) const { return peek() == expected; };
 
+    char peek_at(size_t offset) const
+    {
+        if (m_index + offset >= m_input.length())
+            return '\0';
+        return m_input[m_index + offset];
+    }
+
     void skip()
     {
         if (is_eof())
@@ -192,13 +209,23 @@ private:
     TransitionResult transition_end();
     TransitionResult transition_operator();
     TransitionResult transition_single_quoted_string();
+    TransitionResult transition_double_quoted_string();
     TransitionResult transition_io_number();
     TransitionResult transition_comment();
     void reset_state();
 
+    bool is_at_expansion() const { return peek_is('$') && (peek_at(1) == '(' || peek_at(1) == '{'); }
+    void consume_expansion();
+    size_t line_at(size_t index);
+
     size_t m_index { 0 };
     std::string_view m_input;
 
+    // The number of the line m_line_index is on, which only moves forwards a little at a
+    // time, so that finding the line of each token is cheap.
+    size_t m_line { 1 };
+    size_t m_line_index { 0 };
+
     State m_state;
     StateType m_next_state_type { StateType::Start };
 };
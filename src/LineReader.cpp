@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "LineReader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace RatShell {
+
+// (read) The utility must not consume input past the delimiter, as it belongs to whatever
+// reads the file next. Reading a byte at a time ensures that, which is all that can be done
+// for pipes and terminals. A regular file can instead be read in blocks, and the offset
+// moved back to just past the delimiter.
+std::optional<bool> read_until_delimiter(int fd, char delimiter, std::string& line)
+{
+    struct stat st {};
+    bool is_seekable = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && lseek(fd, 0, SEEK_CUR) >= 0;
+
+    if (!is_seekable) {
+        while (true) {
+            char ch = 0;
+            auto nread = read(fd, &ch, 1);
+            if (nread < 0 && errno == EINTR)
+                continue;
+            if (nread < 0)
+                return std::nullopt;
+            if (nread == 0)
+                return false;
+            if (ch == delimiter)
+                return true;
+            line += ch;
+        }
+    }
+
+    // Most lines are short, so start small and only read more of a long one.
+    constexpr size_t max_block_size = 64 * 1024;
+    char buffer[max_block_size];
+    size_t block_size = 512;
+
+    while (true) {
+        auto nread = read(fd, buffer, block_size);
+        if (nread < 0 && errno == EINTR)
+            continue;
+        if (nread < 0)
+            return std::nullopt;
+        if (nread == 0)
+            return false;
+
+        auto const* found = static_cast<char const*>(memchr(buffer, delimiter, nread));
+        if (found == nullptr) {
+            line.append(buffer, nread);
+            block_size = std::min(block_size * 2, max_block_size);
+            continue;
+        }
+
+        line.append(buffer, found - buffer);
+        auto unused = static_cast<off_t>(nread - (found - buffer) - 1);
+        if (unused > 0 && lseek(fd, -unused, SEEK_CUR) < 0)
+            return std::nullopt;
+        return true;
+    }
+}
+
+std::optional<ReadLine> read_line(int fd, char delimiter, bool is_raw)
+{
+    ReadLine line;
+    auto& text = line.text;
+
+    while (true) {
+        auto start = text.size();
+        auto result = read_until_delimiter(fd, delimiter, text);
+        if (!result.has_value())
+            return std::nullopt;
+        line.found_delimiter = result.value();
+
+        if (is_raw)
+            break;
+
+        // A backslash at the very end continues the line only if the delimiter followed
+        // it, and is dropped either way.
+        bool continues = false;
+        size_t out = start;
+        for (size_t in = start; in < text.size(); in++) {
+            if (text[in] != '\\') {
+                text[out++] = text[in];
+                continue;
+            }
+            if (in + 1 == text.size()) {
+                continues = line.found_delimiter;
+                break;
+            }
+            line.escaped.push_back(out);
+            text[out++] = text[++in];
+        }
+        text.resize(out);
+
+        if (!continues)
+            break;
+        // A joined newline disappears, like a line continuation in the shell, while any
+        // other delimiter is kept as a quoted character.
+        if (delimiter != '\n') {
+            line.escaped.push_back(text.size());
+            text += delimiter;
+        }
+    }
+
+    return line;
+}
+
+std::vector<std::string> split_line(ReadLine const& line, std::string_view ifs, size_t count)
+{
+    std::string_view text = line.text;
+    auto const& escaped = line.escaped;
+
+    auto is_ifs = [&](size_t i) {
+        return ifs.find(text[i]) != std::string_view::npos && !std::binary_search(escaped.begin(), escaped.end(), i);
+    };
+    auto is_ifs_whitespace = [&](size_t i) {
+        auto ch = text[i];
+        return (ch == ' ' || ch == '\t' || ch == '\n') && is_ifs(i);
+    };
+
+    std::vector<std::string> fields;
+    fields.reserve(count);
+
+    size_t i = 0;
+    while (i < text.size() && is_ifs_whitespace(i))
+        i++;
+
+    for (size_t n = 0; n < count; n++) {
+        auto start = i;
+
+        if (n + 1 == count) {
+            // Trailing IFS white space isn't part of the last field.
+            auto end = text.size();
+            while (end > start) {
+                if (!is_ifs_whitespace(end - 1))
+                    break;
+                end--;
+            }
+            fields.emplace_back(text.substr(start, end - start));
+            break;
+        }
+
+        while (i < text.size() && !is_ifs(i))
+            i++;
+        fields.emplace_back(text.substr(start, i - start));
+
+        // A delimiter is any IFS white space together with at most one other IFS
+        // character.
+        while (i < text.size() && is_ifs_whitespace(i))
+            i++;
+        if (i < text.size() && is_ifs(i)) {
+            i++;
+            while (i < text.size() && is_ifs_whitespace(i))
+                i++;
+        }
+    }
+
+    return fields;
+}
+
+} // namespace RatShell
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RatShell {
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/read.html
+// A line as the read builtin takes it, with its backslashes removed.
+struct ReadLine {
+    std::string text;
+    // The positions in the text, in order, of characters a backslash quoted, which are
+    // never taken as IFS characters.
+    std::vector<size_t> escaped;
+    // Whether the line ended with the delimiter, rather than at the end of the input.
+    bool found_delimiter { false };
+};
+
+// Reads up to and including the next delimiter from fd, appending what came before it
+// to line. Returns whether the delimiter was found, or nothing if reading failed.
+std::optional<bool> read_until_delimiter(int fd, char delimiter, std::string& line);
+
+// Reads a line from fd. Unless it's raw, a backslash quotes the next character, and a
+// backslash before the delimiter joins the next line to it. Returns nothing if reading
+// failed.
+std::optional<ReadLine> read_line(int fd, char delimiter, bool is_raw);
+
+// Splits a line into the given number of fields as field splitting would with the IFS,
+// except that the last field gets the rest of the line.
+std::vector<std::string> split_line(ReadLine const&, std::string_view ifs, size_t count);
+
+} // namespace RatShell
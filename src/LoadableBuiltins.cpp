@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "LoadableBuiltins.h"
+#include "BuiltinABI.h"
+#include "Builtins.h"
+#include "Shell.h"
+#include <algorithm>
+#include <cassert>
+#include <dlfcn.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <unistd.h>
+
+namespace RatShell {
+
+namespace {
+
+struct LoadedBuiltin {
+    std::string name;
+    ratsh_builtin_function function { nullptr };
+    // Shared by every builtin from the same object, which is closed along with the last.
+    std::shared_ptr<void> library;
+};
+
+// By name. The nodes stay put, so the registered names can point into them.
+std::map<std::string, LoadedBuiltin, std::less<>>& loaded_builtins()
+{
+    static std::map<std::string, LoadedBuiltin, std::less<>> loaded;
+    return loaded;
+}
+
+Shell& shell_from(ratsh_shell* shell)
+{
+    return *reinterpret_cast<Shell*>(shell);
+}
+
+char const* get_variable(ratsh_shell* shell, char const* name)
+{
+    auto const* variable = shell_from(shell).variables().find(name);
+    return variable != nullptr ? variable->value.c_str() : nullptr;
+}
+
+int set_variable(ratsh_shell* shell, char const* name, char const* value)
+{
+    if (!Variables::is_valid_name(name))
+        return -1;
+    shell_from(shell).variables().set(name, value);
+    return 0;
+}
+
+int unset_variable(ratsh_shell* shell, char const* name)
+{
+    if (!Variables::is_valid_name(name))
+        return -1;
+    shell_from(shell).variables().unset(name);
+    return 0;
+}
+
+} // namespace
+
+std::optional<std::string> load_builtins(std::string const& path, std::span<std::string const> names)
+{
+    // The names are checked before the object is opened, as its constructors may
+    // already do something.
+    for (auto const& name : names) {
+        if (find_builtin(name) != nullptr)
+            return name + ": already a builtin";
+    }
+
+    auto* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+        return std::string { dlerror() };
+    std::shared_ptr<void> library { handle, dlclose };
+
+    auto const* table = static_cast<ratsh_builtin_table const*>(dlsym(handle, RATSH_BUILTIN_TABLE_SYMBOL));
+    if (table == nullptr)
+        return path + ": no " RATSH_BUILTIN_TABLE_SYMBOL " table";
+    if (table->abi_version != RATSH_BUILTIN_ABI_VERSION) {
+        return path + ": built for builtin ABI version " + std::to_string(table->abi_version)
+            + ", but the shell has version " + std::to_string(RATSH_BUILTIN_ABI_VERSION);
+    }
+
+    std::vector<LoadedBuiltin> found;
+    for (auto const& name : names) {
+        auto const* begin = table->builtins;
+        auto const* end = table->builtins + table->count;
+        auto const* builtin = std::find_if(begin, end, [&name](auto const& builtin) { return builtin.name != nullptr && name == builtin.name; });
+        if (builtin == end || builtin->function == nullptr)
+            return path + ": " + name + ": no such builtin";
+        found.push_back({ .name = name, .function = builtin->function, .library = library });
+    }
+
+    for (auto& builtin : found) {
+        auto [it, is_new] = loaded_builtins().emplace(builtin.name, std::move(builtin));
+        // Loading the same name twice from one command was caught by find_builtin(),
+        // unless the name was given twice, in which case the first one stands.
+        if (!is_new)
+            continue;
+        [[maybe_unused]] auto was_registered = register_builtin({ .name = it->first, .function = run_loaded_builtin });
+        assert(was_registered);
+    }
+
+    return std::nullopt;
+}
+
+bool unload_builtin(std::string_view name)
+{
+    auto it = loaded_builtins().find(name);
+    if (it == loaded_builtins().end())
+        return false;
+
+    unregister_builtin(name);
+    loaded_builtins().erase(it);
+    return true;
+}
+
+int run_loaded_builtin(Shell& shell, std::vector<std::string> const& argv)
+{
+    auto it = loaded_builtins().find(argv[0]);
+    assert(it != loaded_builtins().end());
+
+    std::vector<char const*> arguments;
+    arguments.reserve(argv.size() + 1);
+    for (auto const& argument : argv)
+        arguments.push_back(argument.c_str());
+    arguments.push_back(nullptr);
+
+    ratsh_builtin_context context {
+        .stdin_fd = STDIN_FILENO,
+        .stdout_fd = STDOUT_FILENO,
+        .stderr_fd = STDERR_FILENO,
+        .shell = reinterpret_cast<ratsh_shell*>(&shell),
+        .get_variable = get_variable,
+        .set_variable = set_variable,
+        .unset_variable = unset_variable,
+    };
+
+    // The builtin writes to the descriptors itself, after whatever came before it.
+    std::cout.flush();
+    return it->second.function(&context, static_cast<int>(argv.size()), arguments.data());
+}
+
+} // namespace RatShell
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace RatShell {
+
+class Shell;
+
+// https://www.gnu.org/software/bash/manual/html_node/Bash-Builtins.html (enable -f)
+// Loads the named builtins from a shared object that exports them through the C ABI in
+// BuiltinABI.h, and adds them to the builtins the shell looks commands up in. Returns a
+// message, with nothing added, if the object can't be loaded, was built for another ABI
+// version, lacks one of the names, or one of them already names a builtin.
+std::optional<std::string> load_builtins(std::string const& path, std::span<std::string const> names);
+
+// Removes a loaded builtin, closing its shared object once none of its builtins are left.
+// Returns false if no loaded builtin has that name.
+bool unload_builtin(std::string_view name);
+
+// What Builtin::function is for every loaded builtin, which calls the one named by argv[0].
+int run_loaded_builtin(Shell&, std::vector<std::string> const& argv);
+
+} // namespace RatShell
@@ -7,10 +7,29 @@
 #include "Parser.h"
 #include "AST.h"
 #include "Lexer.h"
+#include "Variables.h"
 #include <algorithm>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+
+namespace {
+
+// (2.10.2) 7. [Assignment preceding command name]
+bool is_assignment_word(std::string_view word)
+{
+    auto equals = word.find('=');
+    if (equals == std::string_view::npos)
+        return false;
+    return RatShell::Variables::is_valid_name(word.substr(0, equals));
+}
+
+// Reserved words that end a compound_list rather than start a command in it.
+constexpr std::string_view list_terminators[] = { "do", "done", "}" };
+
+} // namespace
 
 namespace RatShell {
 
@@ -24,15 +43,81 @@ std::shared_ptr<AST::Node> Parser::parse()
     // word shall result. Otherwise, the token WORD shall be returned. Also, if the
     // parser is in any state where only a reserved word could be the next correct
     // token, proceed as above.
-    /// FIXME: Check if a token is a reserved word.
+    /// NOTE: Reserved words are only recognized where the grammar expects one, see
+    // peek_is_reserved_word().
     /// FIXME: Should this be here?
     for (auto& token : m_token_buffer) {
         if (token.type == Token::Type::Token)
             token.type = Token::Type::Word;
     }
 
-    /// TODO: Implement more grammar rules!
-    return parse_and_or();
+    // The error is reported at the token the parser stopped at.
+    auto node = parse_list();
+    if (node && node->is_syntax_error())
+        return std::make_shared<AST::SyntaxError>(std::static_pointer_cast<AST::SyntaxError>(node)->error_message(), peek().line);
+
+    if (!is_eof())
+        return std::make_shared<AST::SyntaxError>("unexpected token '" + peek().value + "'", peek().line);
+
+    return node;
+}
+
+void Parser::skip_newlines()
+{
+    while (peek().type == Token::Type::Newline)
+        consume();
+}
+
+bool Parser::peek_is_reserved_word(std::string_view word)
+{
+    // Quoting any part of a reserved word makes it an ordinary word, and since words keep
+    // their quotes, comparing them as written takes care of that.
+    auto const& token = peek();
+    return token.type == Token::Type::Word && token.value == word;
+}
+
+// This covers both the list and compound_list grammar rules, whose only difference is
+// where line breaks may appear.
+std::shared_ptr<AST::Node> Parser::parse_list()
+{
+    std::vector<std::shared_ptr<AST::Node>> nodes;
+
+    while (true) {
+        skip_newlines();
+        if (is_eof())
+            break;
+
+        auto is_terminator = std::any_of(std::begin(list_terminators), std::end(list_terminators), [this](auto word) {
+            return peek_is_reserved_word(word);
+        });
+        if (is_terminator)
+            break;
+
+        auto and_or = parse_and_or();
+        if (!and_or)
+            break;
+        if (and_or->is_syntax_error())
+            return and_or;
+
+        nodes.push_back(and_or);
+
+        auto type = peek().type;
+        if (type == Token::Type::Semicolon || type == Token::Type::Newline) {
+            consume();
+            continue;
+        }
+        if (type == Token::Type::And)
+            return std::make_shared<AST::SyntaxError>("asynchronous lists are not supported yet");
+
+        break;
+    }
+
+    if (nodes.empty())
+        return nullptr;
+    if (nodes.size() == 1)
+        return nodes.front();
+
+    return std::make_shared<AST::List>(nodes);
 }
 
 void Parser::fill_token_buffer()
@@ -45,83 +130,283 @@ void Parser::fill_token_buffer()
     }
 }
 
+// The commands of an and-or list, and the stages of a pipeline, are collected in a single
+// loop, so a long chain needs neither deep recursion nor repeated copies.
 std::shared_ptr<AST::Node> Parser::parse_and_or()
 {
-    auto left = parse_pipeline();
-    if (!left || left->is_syntax_error())
-        return left;
+    auto first = parse_pipeline();
+    if (!first || first->is_syntax_error())
+        return first;
 
-    switch (peek().type) {
-    case Token::Type::AndIf:
-    case Token::Type::OrIf:
-        break;
-    default:
-        return left;
-    }
+    std::vector<std::shared_ptr<AST::Node>> commands { first };
+    std::vector<AST::AndOrIf::Type> operators;
 
-    auto token = consume();
+    while (peek().type == Token::Type::AndIf || peek().type == Token::Type::OrIf) {
+        auto type = consume().type == Token::Type::AndIf ? AST::AndOrIf::Type::AndIf : AST::AndOrIf::Type::OrIf;
 
-    /// TODO: Parse away line breaks.
+        skip_newlines();
 
-    if (auto right = parse_and_or()) {
+        auto right = parse_pipeline();
+        if (!right)
+            return std::make_shared<AST::SyntaxError>("missing a right operand in and-or list");
         if (right->is_syntax_error())
             return right;
 
-        if (token.type == Token::Type::AndIf)
-            return std::make_shared<AST::AndOrIf>(left, right, AST::AndOrIf::Type::AndIf);
-        return std::make_shared<AST::AndOrIf>(left, right, AST::AndOrIf::Type::OrIf);
+        commands.push_back(std::move(right));
+        operators.push_back(type);
     }
 
-    return std::make_shared<AST::SyntaxError>("missing a right operand in and-or list");
+    if (commands.size() == 1)
+        return first;
+    return std::make_shared<AST::AndOrIf>(std::move(commands), std::move(operators));
 }
 
 std::shared_ptr<AST::Node> Parser::parse_pipeline()
 {
     /// TODO: Support the bang reserved word.
 
-    auto left = parse_command();
-    if (!left || left->is_syntax_error())
-        return left;
+    auto first = parse_command();
+    if (!first || first->is_syntax_error())
+        return first;
 
-    if (peek().type != Token::Type::Pipe) {
-        return left;
-    }
+    std::vector<std::shared_ptr<AST::Node>> stages { first };
 
-    consume();
+    while (peek().type == Token::Type::Pipe) {
+        consume();
 
-    /// TODO: Parse away line breaks.
+        skip_newlines();
 
-    if (auto right = parse_pipeline()) {
+        auto right = parse_command();
+        if (!right)
+            return std::make_shared<AST::SyntaxError>("no command to use read end of pipe");
         if (right->is_syntax_error())
             return right;
-        return std::make_shared<AST::Pipeline>(left, right);
+
+        stages.push_back(std::move(right));
     }
 
-    return std::make_shared<AST::SyntaxError>("no command to use read end of pipe");
+    if (stages.size() == 1)
+        return first;
+    return std::make_shared<AST::Pipeline>(std::move(stages));
 }
 
 std::shared_ptr<AST::Node> Parser::parse_command()
 {
-    return parse_simple_command();
+    std::shared_ptr<AST::Node> compound;
+    auto line = peek().line;
+
+    if (peek().type == Token::Type::OpenParen)
+        compound = parse_subshell();
+    else if (peek_is_reserved_word("{"))
+        compound = parse_brace_group();
+    else if (peek_is_reserved_word("for"))
+        compound = parse_for_clause();
+    else if (peek_is_reserved_word("while") || peek_is_reserved_word("until"))
+        compound = parse_while_clause();
+    else if (peek().type == Token::Type::Word && peek(1).type == Token::Type::OpenParen && peek(2).type == Token::Type::CloseParen)
+        return parse_function_definition();
+    else
+        return parse_simple_command();
+
+    if (compound->is_syntax_error())
+        return compound;
+
+    // The redirections apply to the compound command as a whole.
+    std::vector<std::shared_ptr<AST::Node>> redirections;
+    while (auto io_redirect = parse_io_redirect()) {
+        if (io_redirect->is_syntax_error())
+            return io_redirect;
+        redirections.push_back(io_redirect);
+    }
+
+    return std::make_shared<AST::CompoundCommand>(compound, redirections, line);
+}
+
+std::shared_ptr<AST::Node> Parser::parse_subshell()
+{
+    consume(); // '('
+
+    auto body = parse_list();
+    if (body && body->is_syntax_error())
+        return body;
+
+    if (peek().type != Token::Type::CloseParen)
+        return std::make_shared<AST::SyntaxError>("missing ')' to close subshell");
+    consume();
+
+    if (!body)
+        return std::make_shared<AST::SyntaxError>("subshell has no commands");
+
+    return std::make_shared<AST::Subshell>(body);
+}
+
+std::shared_ptr<AST::Node> Parser::parse_brace_group()
+{
+    consume(); // "{"
+
+    auto body = parse_list();
+    if (body && body->is_syntax_error())
+        return body;
+
+    if (!peek_is_reserved_word("}"))
+        return std::make_shared<AST::SyntaxError>("missing '}' to close group");
+    consume();
+
+    if (!body)
+        return std::make_shared<AST::SyntaxError>("group has no commands");
+
+    return std::make_shared<AST::BraceGroup>(body);
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_05
+std::shared_ptr<AST::Node> Parser::parse_function_definition()
+{
+    auto name = consume().value;
+    if (!Variables::is_valid_name(name))
+        return std::make_shared<AST::SyntaxError>("'" + name + "' is not a valid function name");
+
+    consume(); // '('
+    consume(); // ')'
+    skip_newlines();
+
+    // The body is lowered along with the rest of the definition, so calls never go back
+    // to the parser.
+    auto body = parse_command();
+    if (body && body->is_syntax_error())
+        return body;
+    if (!body || body->kind() != AST::Node::Kind::CompoundCommand)
+        return std::make_shared<AST::SyntaxError>("the body of function '" + name + "' must be a compound command");
+
+    return std::make_shared<AST::FunctionDefinition>(name, body);
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_04_03
+std::shared_ptr<AST::Node> Parser::parse_for_clause()
+{
+    consume(); // "for"
+
+    // (2.10.2) 5. [NAME in for]
+    if (peek().type != Token::Type::Word || !Variables::is_valid_name(peek().value))
+        return std::make_shared<AST::SyntaxError>("expected a variable name after 'for'");
+    auto name = consume().value;
+
+    skip_newlines();
+
+    std::optional<std::vector<std::string>> words;
+    if (peek_is_reserved_word("in")) {
+        consume();
+
+        words.emplace();
+        while (peek().type == Token::Type::Word)
+            words->push_back(consume().value);
+
+        if (peek().type != Token::Type::Semicolon && peek().type != Token::Type::Newline)
+            return std::make_shared<AST::SyntaxError>("expected ';' or a newline after the words of a for loop");
+        consume();
+        skip_newlines();
+    } else if (peek().type == Token::Type::Semicolon) {
+        consume();
+        skip_newlines();
+    }
+
+    auto body = parse_do_group();
+    if (body->is_syntax_error())
+        return body;
+
+    return std::make_shared<AST::ForLoop>(name, words, body);
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_04_09
+std::shared_ptr<AST::Node> Parser::parse_while_clause()
+{
+    auto type = consume().value == "until" ? AST::WhileLoop::Type::Until : AST::WhileLoop::Type::While;
+
+    auto condition = parse_list();
+    if (!condition)
+        return std::make_shared<AST::SyntaxError>("loop has no condition");
+    if (condition->is_syntax_error())
+        return condition;
+
+    auto body = parse_do_group();
+    if (body->is_syntax_error())
+        return body;
+
+    return std::make_shared<AST::WhileLoop>(condition, body, type);
+}
+
+std::shared_ptr<AST::Node> Parser::parse_do_group()
+{
+    if (!peek_is_reserved_word("do"))
+        return std::make_shared<AST::SyntaxError>("expected 'do' to start the body of a loop");
+    consume();
+
+    auto body = parse_list();
+    if (body && body->is_syntax_error())
+        return body;
+
+    if (!peek_is_reserved_word("done"))
+        return std::make_shared<AST::SyntaxError>("missing 'done' to close loop");
+    consume();
+
+    if (!body)
+        return std::make_shared<AST::SyntaxError>("loop has no commands");
+
+    return body;
 }
 
 std::shared_ptr<AST::Node> Parser::parse_simple_command()
 {
     std::vector<std::shared_ptr<AST::Node>> nodes;
+    std::vector<std::string> assignments;
     std::vector<std::string> argv;
+    std::vector<std::pair<size_t, std::shared_ptr<AST::Node>>> process_substitutions;
+    auto line = peek().line;
+
+    // Adds the next word or process substitution to argv, returning a syntax error if
+    // there is one.
+    auto parse_argument = [&]() -> std::shared_ptr<AST::Node> {
+        if (peek().type == Token::Type::Word) {
+            argv.push_back(consume().value);
+            return nullptr;
+        }
 
-    /// TODO: Support prefixed redirection operators and also assginment words.
+        auto substitution = parse_process_substitution();
+        if (substitution->is_syntax_error())
+            return substitution;
 
-    if (peek().type == Token::Type::Word) {
+        process_substitutions.emplace_back(argv.size(), substitution);
+        argv.emplace_back();
+        return nullptr;
+    };
+    auto is_at_argument = [this]() {
+        auto type = peek().type;
+        return type == Token::Type::Word || type == Token::Type::LessParen || type == Token::Type::GreatParen;
+    };
+
+    while (true) {
+        if (peek().type == Token::Type::Word && is_assignment_word(peek().value)) {
+            assignments.push_back(consume().value);
+        } else if (auto io_redirect = parse_io_redirect()) {
+            if (io_redirect->is_syntax_error())
+                return io_redirect;
+            nodes.push_back(io_redirect);
+        } else {
+            break;
+        }
+    }
+
+    if (is_at_argument()) {
         /// TODO: Differentiate between cmd_name and cmd_word grammar.
-        argv.push_back(consume().value);
-    } else {
+        if (auto error = parse_argument())
+            return error;
+    } else if (assignments.empty() && nodes.empty()) {
         return nullptr;
     }
 
-    while (true) {
-        if (peek().type == Token::Type::Word) {
-            argv.push_back(consume().value);
+    while (!argv.empty()) {
+        if (is_at_argument()) {
+            if (auto error = parse_argument())
+                return error;
         } else if (auto io_redirect = parse_io_redirect()) {
             if (io_redirect->is_syntax_error())
                 return io_redirect;
@@ -130,7 +415,7 @@ std::shared_ptr<AST::Node> Parser::parse_simple_command()
             break;
         }
     }
-    nodes.push_back(std::make_shared<AST::Execute>(argv));
+    nodes.push_back(std::make_shared<AST::Execute>(assignments, argv, line, std::move(process_substitutions)));
 
     return std::make_shared<AST::ConcatenateListToCommand>(nodes);
 }
@@ -166,6 +451,24 @@ std::shared_ptr<AST::Node> Parser::parse_io_file(std::optional<int> io_number)
 
     auto io_operator = consume();
 
+    // e.g. "< <(list)", which reads from the list's output.
+    if (peek().type == Token::Type::LessParen || peek().type == Token::Type::GreatParen) {
+        auto substitution = parse_process_substitution();
+        if (substitution->is_syntax_error())
+            return substitution;
+
+        switch (io_operator.type) {
+        case Token::Type::Less:
+            return std::make_shared<AST::PathRedirection>("", io_number.value_or(0), AST::PathRedirection::Flags::Read, substitution);
+        case Token::Type::Great:
+        case Token::Type::DoubleGreat:
+        case Token::Type::Clobber:
+            return std::make_shared<AST::PathRedirection>("", io_number.value_or(1), AST::PathRedirection::Flags::Write, substitution);
+        default:
+            return std::make_shared<AST::SyntaxError>("a process substitution can only be redirected from or to");
+        }
+    }
+
     if (peek().type != Token::Type::Word)
         return std::make_shared<AST::SyntaxError>("no file name given for redirection");
 
@@ -203,4 +506,26 @@ std::shared_ptr<AST::Node> Parser::parse_io_file(std::optional<int> io_number)
     }
 }
 
-} // namespace RatShell
\ No newline at end of file
+// https://www.gnu.org/software/bash/manual/html_node/Process-Substitution.html
+std::shared_ptr<AST::Node> Parser::parse_process_substitution()
+{
+    if (peek().type != Token::Type::LessParen && peek().type != Token::Type::GreatParen)
+        return nullptr;
+
+    auto direction = consume().type == Token::Type::LessParen ? ProcessSubstitutionValue::Direction::Input : ProcessSubstitutionValue::Direction::Output;
+
+    auto body = parse_list();
+    if (body && body->is_syntax_error())
+        return body;
+
+    if (peek().type != Token::Type::CloseParen)
+        return std::make_shared<AST::SyntaxError>("missing ')' to close process substitution");
+    consume();
+
+    if (!body)
+        return std::make_shared<AST::SyntaxError>("process substitution has no commands");
+
+    return std::make_shared<AST::ProcessSubstitution>(body, direction);
+}
+
+} // namespace RatShell
@@ -35,19 +35,30 @@ private:
         return m_token_buffer[m_token_index++];
     }
 
-    Token const& peek()
+    Token const& peek(size_t offset = 0)
     {
-        if (is_eof())
+        if (m_token_index + offset >= m_token_buffer.size())
             return m_eof_token;
-        return m_token_buffer[m_token_index];
+        return m_token_buffer[m_token_index + offset];
     }
 
+    void skip_newlines();
+    bool peek_is_reserved_word(std::string_view word);
+
+    std::shared_ptr<AST::Node> parse_list();
     std::shared_ptr<AST::Node> parse_and_or();
     std::shared_ptr<AST::Node> parse_pipeline();
     std::shared_ptr<AST::Node> parse_command();
+    std::shared_ptr<AST::Node> parse_subshell();
+    std::shared_ptr<AST::Node> parse_brace_group();
+    std::shared_ptr<AST::Node> parse_function_definition();
+    std::shared_ptr<AST::Node> parse_for_clause();
+    std::shared_ptr<AST::Node> parse_while_clause();
+    std::shared_ptr<AST::Node> parse_do_group();
     std::shared_ptr<AST::Node> parse_simple_command();
     std::shared_ptr<AST::Node> parse_io_redirect();
     std::shared_ptr<AST::Node> parse_io_file(std::optional<int> io_number);
+    std::shared_ptr<AST::Node> parse_process_substitution();
 
     Lexer m_lexer;
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Profiler.h"
+#include "Statistics.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+std::chrono::nanoseconds to_nanoseconds(struct timeval const& time)
+{
+    return std::chrono::seconds { time.tv_sec } + std::chrono::microseconds { time.tv_usec };
+}
+
+uint64_t count_of(std::chrono::nanoseconds duration)
+{
+    return static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 0));
+}
+
+std::vector<std::string_view> split_lines(std::string_view source)
+{
+    std::vector<std::string_view> lines;
+    for (size_t start = 0; start < source.size();) {
+        auto end = source.find('\n', start);
+        if (end == std::string_view::npos)
+            end = source.size();
+        lines.push_back(source.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines;
+}
+
+bool write_file(std::string const& path, std::string const& contents)
+{
+    std::ofstream file { path, std::ios::trunc };
+    file << contents;
+    return static_cast<bool>(file.flush());
+}
+
+} // namespace
+
+void Profiler::set_source(std::string name, std::string_view source)
+{
+    m_name = std::move(name);
+    m_source = source;
+}
+
+void Profiler::enter_command(size_t line, Clock::time_point now)
+{
+    m_frames.push_back({ .line = line, .function_depth = m_functions.size(), .start = now });
+}
+
+void Profiler::leave_command(Clock::time_point now)
+{
+    auto frame = m_frames.back();
+    auto elapsed = std::max<std::chrono::nanoseconds>(now - frame.start, {});
+    auto self = std::max<std::chrono::nanoseconds>(elapsed - frame.nested, {});
+
+    auto& line = m_lines[frame.line];
+    line.calls++;
+    line.total += elapsed;
+    line.self += self;
+    line.child_cpu += frame.child_cpu;
+    line.forks += frame.forks;
+
+    m_stack.clear();
+    for (auto const& caller : m_frames) {
+        if (!m_stack.empty())
+            m_stack += ';';
+        m_stack += caller.function_depth > 0 ? std::string_view { m_functions[caller.function_depth - 1] } : "main";
+        m_stack += ':';
+        m_stack += std::to_string(caller.line);
+    }
+    m_stacks[m_stack] += self;
+
+    m_frames.pop_back();
+    if (!m_frames.empty())
+        m_frames.back().nested += elapsed;
+}
+
+void Profiler::count_fork()
+{
+    if (!m_frames.empty())
+        m_frames.back().forks++;
+}
+
+void Profiler::add_child_usage(struct rusage const& usage)
+{
+    if (!m_frames.empty())
+        m_frames.back().child_cpu += to_nanoseconds(usage.ru_utime) + to_nanoseconds(usage.ru_stime);
+}
+
+std::string Profiler::report() const
+{
+    std::vector<std::pair<size_t, LineProfile const*>> sorted;
+    std::chrono::nanoseconds total {};
+    uint64_t calls = 0;
+    for (auto const& [line, profile] : m_lines) {
+        sorted.emplace_back(line, &profile);
+        total += profile.self;
+        calls += profile.calls;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto const& a, auto const& b) {
+        return a.second->self > b.second->self;
+    });
+
+    auto source_lines = split_lines(m_source);
+
+    std::string out = "# " + (m_name.empty() ? std::string { "ratsh" } : m_name) + ": "
+        + format_duration(count_of(total)) + " in " + std::to_string(calls) + " commands\n";
+
+    char row[128];
+    std::snprintf(row, sizeof(row), "%10s %10s %10s %10s %8s %6s  %s\n", "self", "total", "calls", "child cpu", "forks", "line", "source");
+    out += row;
+
+    for (auto const& [line, profile] : sorted) {
+        std::snprintf(row, sizeof(row), "%10s %10s %10llu %10s %8llu %6zu  ",
+            format_duration(count_of(profile->self)).c_str(),
+            format_duration(count_of(profile->total)).c_str(),
+            static_cast<unsigned long long>(profile->calls),
+            format_duration(count_of(profile->child_cpu)).c_str(),
+            static_cast<unsigned long long>(profile->forks),
+            line);
+        out += row;
+
+        if (line > 0 && line <= source_lines.size()) {
+            auto text = source_lines[line - 1];
+            auto first = text.find_first_not_of(" \t");
+            out += first == std::string_view::npos ? std::string_view {} : text.substr(first);
+        }
+        out += '\n';
+    }
+
+    return out;
+}
+
+std::string Profiler::folded_stacks() const
+{
+    std::vector<std::pair<std::string_view, uint64_t>> sorted;
+    for (auto const& [stack, self] : m_stacks)
+        sorted.emplace_back(stack, count_of(self) / 1000);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string out;
+    for (auto const& [stack, microseconds] : sorted) {
+        out += stack;
+        out += ' ';
+        out += std::to_string(microseconds);
+        out += '\n';
+    }
+    return out;
+}
+
+bool Profiler::write() const
+{
+    auto wrote_report = write_file(m_output_path, report());
+    auto wrote_stacks = write_file(m_output_path + ".folded", folded_stacks());
+    return wrote_report && wrote_stacks;
+}
+
+} // namespace RatShell
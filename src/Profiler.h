@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <unordered_map>
+#include <vector>
+
+namespace RatShell {
+
+// Where a script spends its time, line by line. Each command is timed from when the shell
+// starts running it to when it's done, and the CPU time of the children it waits for and
+// the number of times it forks are charged to it as well. Time spent in the commands it
+// runs itself, e.g. the body of a loop or of a function it calls, is charged to them
+// rather than to it.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct LineProfile {
+        uint64_t calls { 0 };
+        // Including the commands run from within this one, so a line that calls itself
+        // through a function is counted once for every level.
+        std::chrono::nanoseconds total {};
+        std::chrono::nanoseconds self {};
+        // The user and system time of the children waited for.
+        std::chrono::nanoseconds child_cpu {};
+        uint64_t forks { 0 };
+    };
+
+    // The script the line numbers refer to, which the report quotes.
+    void set_source(std::string name, std::string_view source);
+
+    // Where the report is written, with the folded stacks next to it in a file of the
+    // same name ending in ".folded".
+    std::string const& output_path() const { return m_output_path; }
+    void set_output_path(std::string path) { m_output_path = std::move(path); }
+
+    // Every command entered is left again, in the reverse order.
+    void enter_command(size_t line, Clock::time_point = Clock::now());
+    void leave_command(Clock::time_point = Clock::now());
+    void enter_function(std::string_view name) { m_functions.emplace_back(name); }
+    void leave_function() { m_functions.pop_back(); }
+
+    // Charged to the command that's running, if any.
+    void count_fork();
+    void add_child_usage(struct rusage const&);
+
+    bool is_empty() const { return m_lines.empty(); }
+    std::map<size_t, LineProfile> const& lines() const { return m_lines; }
+
+    // The lines that took the most time of their own first.
+    std::string report() const;
+    // One line per distinct call stack, e.g. "main:12;f:3 1500", where each frame is the
+    // function a command ran in and the line it started on, and the count is the time
+    // spent in the last of them in microseconds. This is what flamegraph.pl and
+    // speedscope take as input.
+    std::string folded_stacks() const;
+
+    // Writes both files, returning false if either couldn't be written.
+    bool write() const;
+
+private:
+    struct Frame {
+        size_t line { 0 };
+        // The number of functions that were running when the command started.
+        size_t function_depth { 0 };
+        Clock::time_point start;
+        std::chrono::nanoseconds nested {};
+        std::chrono::nanoseconds child_cpu {};
+        uint64_t forks { 0 };
+    };
+
+    std::string m_name;
+    std::string m_source;
+    std::string m_output_path;
+
+    std::vector<Frame> m_frames;
+    std::vector<std::string> m_functions;
+
+    std::map<size_t, LineProfile> m_lines;
+    std::unordered_map<std::string, std::chrono::nanoseconds> m_stacks;
+    // Reused to build the key of each stack.
+    std::string m_stack;
+};
+
+} // namespace RatShell
@@ -6,18 +6,36 @@
 
 #include "Shell.h"
 #include "AST.h"
+#include "ArgBatch.h"
 #include "Builtins.h"
+#include "Expansion.h"
 #include "FileDescription.h"
 #include "Parser.h"
 #include "Value.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
 #include <iostream>
+#include <linux/kcmp.h>
 #include <memory>
 #include <optional>
+#include <poll.h>
+#include <queue>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
+#include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -25,41 +43,321 @@ namespace RatShell {
 
 namespace {
 
-bool apply_redirections(std::vector<std::shared_ptr<RedirectionValue>> const& redirections, FileDescriptionCollector& fds, SavedFileDescriptions& saved_fds)
+constexpr size_t command_substitution_initial_read_size = 64 * 1024;
+
+// Deep enough for any sensible recursion, while still well within the stack.
+constexpr unsigned max_function_depth = 1000;
+constexpr size_t default_history_size = 100'000;
+
+// Each command run by autoparallel holds on to its output until the ones before it are
+// done, which takes two descriptors, so it can only get so far ahead of them.
+constexpr size_t max_unreported_jobs = 256;
+
+// Whether every command is a builtin which only writes to standard output, with no
+// redirections or pipes involved that would need real file descriptions.
+bool can_run_in_process(std::shared_ptr<Value> const& value, Shell::Functions const& functions)
 {
-    std::vector<std::pair<int, int>> dups;
-    FileDescriptionCollector fds_to_be_closed;
+    auto is_eligible = [&functions](std::shared_ptr<CommandValue> const& cmd) {
+        if (cmd->next_in_pipeline || cmd->compound || !cmd->redirections.empty() || !cmd->assignments.empty() || !cmd->process_substitutions.empty() || cmd->argv.empty())
+            return false;
+        if (functions.contains(cmd->argv[0]))
+            return false;
+
+        auto const* builtin = find_builtin(cmd->argv[0]);
+        return builtin != nullptr && builtin->is_side_effect_free;
+    };
 
+    if (!value)
+        return true;
+    if (value->is_command())
+        return is_eligible(std::static_pointer_cast<CommandValue>(value));
+    if (value->is_and_or_list()) {
+        auto const& commands = std::static_pointer_cast<AndOrListValue>(value)->commands;
+        return std::all_of(commands.begin(), commands.end(), is_eligible);
+    }
+
+    return false;
+}
+
+// Whether everything the value may change about the shell is covered by a Snapshot.
+/// NOTE: This looks at the words as written, so a command name that needs expanding
+// could be anything and is treated as unsafe.
+bool is_snapshot_safe(std::shared_ptr<Value> const& value, Shell::Functions const& functions, std::unordered_set<std::string>& checked_functions)
+{
+    auto is_safe = [&](std::shared_ptr<Value> const& other) {
+        return is_snapshot_safe(other, functions, checked_functions);
+    };
+
+    if (!value)
+        return true;
+
+    if (value->is_list()) {
+        auto const& items = std::static_pointer_cast<ListValue>(value)->items;
+        return std::all_of(items.begin(), items.end(), is_safe);
+    }
+    if (value->is_and_or_list()) {
+        auto const& commands = std::static_pointer_cast<AndOrListValue>(value)->commands;
+        return std::all_of(commands.begin(), commands.end(), is_safe);
+    }
+    if (!value->is_command())
+        return false;
+
+    for (auto cmd = std::static_pointer_cast<CommandValue>(value); cmd; cmd = cmd->next_in_pipeline) {
+        if (cmd->compound) {
+            auto const& compound = cmd->compound;
+
+            // Nested subshells are isolated one way or another.
+            if (compound->is_subshell())
+                continue;
+            if (compound->is_for_loop() && is_safe(std::static_pointer_cast<ForLoopValue>(compound)->body))
+                continue;
+            if (compound->is_while_loop()) {
+                auto loop = std::static_pointer_cast<WhileLoopValue>(compound);
+                if (is_safe(loop->condition) && is_safe(loop->body))
+                    continue;
+            }
+            if (compound->is_brace_group() && is_safe(std::static_pointer_cast<BraceGroupValue>(compound)->body))
+                continue;
+            return false;
+        }
+        if (cmd->argv.empty())
+            continue;
+
+        auto const& name = cmd->argv[0];
+        if (name.find_first_of("$`'\"\\") != std::string::npos)
+            return false;
+
+        // Functions come before all but the special builtins. A function that's already
+        // being checked doesn't need to be checked again.
+        auto const* builtin = find_builtin(name);
+        if (builtin == nullptr || !builtin->is_special) {
+            if (auto it = functions.find(name); it != functions.end()) {
+                if (checked_functions.insert(name).second && !is_safe(it->second))
+                    return false;
+                continue;
+            }
+        }
+
+        // Any other utility runs in its own process anyway.
+        if (builtin != nullptr && !builtin->is_snapshot_safe)
+            return false;
+    }
+
+    return true;
+}
+
+bool is_snapshot_safe(std::shared_ptr<Value> const& value, Shell::Functions const& functions)
+{
+    std::unordered_set<std::string> checked_functions;
+    return is_snapshot_safe(value, functions, checked_functions);
+}
+
+// Whether expanding the word can't change anything or depend on an earlier command, which
+// rules out substitutions, "$?" and "${name=word}" and the like.
+bool is_expansion_pure(std::string_view word)
+{
+    if (word.find('`') != std::string_view::npos || word.find("$(") != std::string_view::npos || word.find("$?") != std::string_view::npos)
+        return false;
+
+    for (auto start = word.find("${"); start != std::string_view::npos; start = word.find("${", start + 2)) {
+        auto end = word.find('}', start);
+        if (word.substr(start, end - start).find_first_of("=?") != std::string_view::npos)
+            return false;
+    }
+    return true;
+}
+
+// Whether standard output and error are the same open file description, e.g. a terminal
+// both were opened on, so that whatever is written to either ends up in the order it was.
+bool is_output_shared()
+{
+    auto pid = getpid();
+    return syscall(SYS_kcmp, pid, pid, KCMP_FILE, STDOUT_FILENO, STDERR_FILENO) == 0;
+}
+
+// Whether both the shell's standard output and its standard error are still where the
+// command's output goes once its redirections are in place, e.g. unless one of them is
+// sent to a file.
+bool writes_standard_output_and_error(CommandValue const& cmd)
+{
+    // The shell's descriptor each of the command's leads to, or -1 for anywhere else.
+    std::array<int, 10> targets;
+    targets.fill(-1);
+    targets[STDOUT_FILENO] = STDOUT_FILENO;
+    targets[STDERR_FILENO] = STDERR_FILENO;
+
+    for (auto const& redir : cmd.redirections) {
+        if (redir->io_number < 0 || static_cast<size_t>(redir->io_number) >= targets.size())
+            continue;
+        auto target = -1;
+        if (redir->action == RedirectionValue::Action::InputDup || redir->action == RedirectionValue::Action::OutputDup) {
+            auto right_fd = std::get<int>(redir->redir_variant);
+            if (right_fd >= 0 && static_cast<size_t>(right_fd) < targets.size())
+                target = targets[right_fd];
+        }
+        targets[redir->io_number] = target;
+    }
+
+    auto leads_to = [&targets](int fd) { return targets[STDOUT_FILENO] == fd || targets[STDERR_FILENO] == fd; };
+    return leads_to(STDOUT_FILENO) && leads_to(STDERR_FILENO);
+}
+
+// Whether the command is a utility whose only known effects on anything are its
+// redirections. Anything else, e.g. a builtin, a function or a command without
+// redirections, has to run on its own. So does one that writes to both standard output
+// and error unless they're shared, as each is captured on its own and passed on after
+// the other, which would change the order of what was written to them.
+bool can_run_in_parallel(std::shared_ptr<Value> const& value, Shell::Functions const& functions, bool is_output_shared)
+{
+    if (!value || !value->is_command())
+        return false;
+
+    auto const& cmd = static_cast<CommandValue const&>(*value);
+    if (cmd.next_in_pipeline || cmd.compound || cmd.argv.empty() || cmd.redirections.empty() || !cmd.process_substitutions.empty())
+        return false;
+    if (!is_output_shared && writes_standard_output_and_error(cmd))
+        return false;
+
+    auto const& name = cmd.argv[0];
+    if (name.find_first_of("$`'\"\\") != std::string::npos || find_builtin(name) != nullptr || functions.contains(name))
+        return false;
+
+    // What pathname expansion finds depends on the files the commands before have made.
+    for (auto const& word : cmd.argv) {
+        if (word.find_first_of("*?[") != std::string::npos || !is_expansion_pure(word))
+            return false;
+    }
+    for (auto const& assignment : cmd.assignments) {
+        if (!is_expansion_pure(assignment))
+            return false;
+    }
+    for (auto const& redir : cmd.redirections) {
+        if (redir->action == RedirectionValue::Action::Open && !is_expansion_pure(std::get<RedirectionValue::PathData>(redir->redir_variant).path))
+            return false;
+    }
+    return true;
+}
+
+// Copies what a command wrote to a capture onto the shell's own descriptor.
+void replay_output(int capture_fd, int fd)
+{
+    off_t offset = 0;
+    auto size = lseek(capture_fd, 0, SEEK_END);
+    while (offset < size) {
+        auto nsent = sendfile(fd, capture_fd, &offset, size - offset);
+        if (nsent < 0 && errno == EINTR)
+            continue;
+        if (nsent <= 0)
+            break;
+    }
+
+    // Not every file takes sendfile(2), e.g. one opened with O_APPEND.
+    char buffer[16 * 1024];
+    while (offset < size) {
+        auto nread = pread(capture_fd, buffer, sizeof(buffer), offset);
+        if (nread <= 0)
+            return;
+        for (ssize_t written = 0; written < nread;) {
+            auto nwritten = write(fd, buffer + written, nread - written);
+            if (nwritten < 0 && errno == EINTR)
+                continue;
+            if (nwritten <= 0)
+                return;
+            written += nwritten;
+        }
+        offset += nread;
+    }
+}
+
+} // namespace
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_08_01
+int Shell::fail_command()
+{
+    if (!m_is_interactive)
+        request_exit(1);
+    return 1;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_07
+bool Shell::apply_redirections(std::vector<std::shared_ptr<RedirectionValue>> const& redirections, SavedFileDescriptions& saved_fds)
+{
+    // Each redirection is done before the next is looked at, so later ones see the
+    // effects of earlier ones (e.g. in "> file 2>&1").
     for (auto const& redir : redirections) {
         auto fd = redir->io_number;
         auto const& redir_variant = redir->redir_variant;
 
+        // (2.7) Only 0 through 9 are for the user, which keeps the shell's own
+        // descriptors out of reach.
+        auto right_fd = std::holds_alternative<int>(redir_variant) ? std::get<int>(redir_variant) : -1;
+        if (fd >= min_shell_fd || right_fd >= min_shell_fd) {
+            std::cerr << "ratsh: " << std::max(fd, right_fd) << ": bad file descriptor\n";
+            return false;
+        }
+
         // Save fd so that we may restore it.
         saved_fds.add(fd);
+        m_statistics.increment(Statistics::Counter::Redirections);
 
         switch (redir->action) {
         case RedirectionValue::Action::Open: {
             auto const& data = std::get<RedirectionValue::PathData>(redir_variant);
-            auto path = data.path;
+
+            // The pipe can be used as it is, with no path to open.
+            if (data.process_substitution) {
+                auto pipe_fd = start_process_substitution(*data.process_substitution, saved_fds);
+                if (pipe_fd < 0)
+                    return false;
+                if (dup2(pipe_fd, fd) < 0) {
+                    perror("dup2");
+                    return false;
+                }
+                break;
+            }
+
+            Expander expander { *this };
+            auto path = expander.expand_word(data.path);
+            if (expander.has_failed()) {
+                fail_command();
+                return false;
+            }
             auto flags = data.flags;
 
             // Open a file using the given path.
-            auto path_fd = open(path.c_str(), flags, 0666);
+            // The fd is only needed until it's been duplicated, so keep it from leaking
+            // into utilities started while the redirection is in place. Relative paths
+            // start from the directory the shell already holds open.
+            auto directory_fd = m_working_directory.fd() < 0 ? AT_FDCWD : m_working_directory.fd();
+            auto path_fd = openat(directory_fd, path.c_str(), flags | O_CLOEXEC, 0666);
             if (path_fd < 0) {
                 perror("open");
                 return false;
             }
 
-            fds.add(path_fd);
-            dups.push_back({ path_fd, fd });
+            // The file may have been given the very number it was meant for, in which
+            // case it only needs to be inherited.
+            if (path_fd == fd) {
+                if (fcntl(fd, F_SETFD, 0) < 0) {
+                    perror("fcntl");
+                    return false;
+                }
+                break;
+            }
+
+            auto rc = dup2(path_fd, fd);
+            close(path_fd);
+            if (rc < 0) {
+                perror("dup2");
+                return false;
+            }
             break;
         }
         case RedirectionValue::Action::Close:
-            fds_to_be_closed.add(fd);
+            close(fd);
             break;
         case RedirectionValue::Action::InputDup:
         case RedirectionValue::Action::OutputDup: {
-            auto const& right_fd = std::get<int>(redir_variant);
             int flags = fcntl(right_fd, F_GETFL);
 
             if (flags < 0) {
@@ -78,31 +376,62 @@ bool apply_redirections(std::vector<std::shared_ptr<RedirectionValue>> const& re
                 return false;
             }
 
-            dups.push_back({ right_fd, fd });
+            if (dup2(right_fd, fd) < 0) {
+                perror("dup2");
+                return false;
+            }
             break;
         }
         }
     }
 
-    // Perform redirections.
-    for (auto& dup : dups) {
-        auto path_fd = dup.first;
-        auto fd_to_redirect = dup.second;
+    return true;
+}
 
-        // Redirect fd to path_fd.
-        if (dup2(path_fd, fd_to_redirect) < 0) {
-            perror("dup2");
-            return false;
+Shell::Shell()
+    : m_variables(Variables::from_environment())
+    , m_pid(getpid())
+{
+    // (2.5.3) PWD shall be set by the shell at startup if it names the working directory.
+    auto const* pwd = m_variables.find("PWD");
+    auto working_directory = WorkingDirectory::current(pwd != nullptr ? std::optional<std::string_view> { pwd->value } : std::nullopt);
+    if (working_directory.has_value()) {
+        m_working_directory = std::move(working_directory.value());
+        if (pwd == nullptr || pwd->value != m_working_directory.path()) {
+            m_variables.set("PWD", m_working_directory.path());
+            m_variables.export_variable("PWD");
         }
     }
+}
 
-    // Close the desired fds.
-    fds_to_be_closed.collect();
-
-    return true;
+Shell::~Shell()
+{
+    if (auto const& format = m_statistics.report_at_exit(); format.has_value())
+        std::cerr << m_statistics.report(format.value());
+    if (!m_profiler.is_empty() && !m_profiler.write())
+        std::cerr << "ratsh: " << m_profiler.output_path() << ": " << strerror(errno) << "\n";
 }
 
-} // namespace
+void Shell::open_history()
+{
+    std::string path;
+    if (auto const* file = m_variables.find("HISTFILE"); file != nullptr && !file->value.empty())
+        path = file->value;
+    else if (auto const* home = m_variables.find("HOME"); home != nullptr && !home->value.empty())
+        path = home->value + "/.ratsh_history";
+    else
+        return;
+
+    auto max_entries = default_history_size;
+    if (auto const* size = m_variables.find("HISTSIZE"); size != nullptr) {
+        char* end = nullptr;
+        auto value = std::strtoull(size->value.c_str(), &end, 10);
+        if (!size->value.empty() && *end == '\0')
+            max_entries = value;
+    }
+
+    m_history = History::open(std::move(path), max_entries);
+}
 
 int Shell::run_single_line(std::string_view input)
 {
@@ -120,141 +449,987 @@ int Shell::run_single_line(std::string_view input)
         return 1;
     }
 
+    return run_value(node->eval());
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_06_03
+std::string Shell::run_command_substitution(std::string_view input)
+{
+    auto node = parse(input);
+    if (!node)
+        return {};
+
+    if (node->is_syntax_error()) {
+        auto err_node = std::static_pointer_cast<AST::SyntaxError>(node);
+        print_error(err_node->error_message(), Error::SyntaxError);
+        return {};
+    }
+
     auto value = node->eval();
+    std::string output;
+
+    if (can_run_in_process(value, m_functions)) {
+        // Nothing in here can change the shell's state, so there's no need for a
+        // subshell: let the builtins write straight into a buffer.
+        std::stringbuf buffer;
+
+        // The line numbers in here count from the start of the substitution, so its time
+        // goes to the command it's part of.
+        auto was_profiling = std::exchange(m_options.profile, false);
+
+        std::cout.flush();
+        auto* saved_buffer = std::cout.rdbuf(&buffer);
+        m_last_substitution_status = run_value(value);
+        std::cout.rdbuf(saved_buffer);
+
+        // An expansion error only ends the substitution, as it would have in a subshell.
+        if (m_exit_code.has_value())
+            m_last_substitution_status = *std::exchange(m_exit_code, std::nullopt);
+
+        m_options.profile = was_profiling;
+
+        output = std::move(buffer).str();
+    } else {
+        int pipe_fds[2];
+        if (!open_pipe(pipe_fds)) {
+            perror("pipe");
+            return {};
+        }
+
+        std::cout.flush();
+
+        auto pid = fork_shell();
+        if (pid < 0) {
+            perror("fork");
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            return {};
+        }
+
+        if (pid == 0) {
+            close(pipe_fds[0]);
+            if (dup2(pipe_fds[1], STDOUT_FILENO) < 0) {
+                perror("dup2");
+                _exit(1);
+            }
+            close(pipe_fds[1]);
+            run_and_exit(value);
+        }
+
+        close(pipe_fds[1]);
+
+        // Read straight into the result, growing it geometrically so that large outputs
+        // need few reads and no intermediate copies.
+        size_t length = 0;
+        output.resize(command_substitution_initial_read_size);
+
+        while (true) {
+            if (length == output.size())
+                output.resize(output.size() * 2);
+
+            auto nread = read(pipe_fds[0], output.data() + length, output.size() - length);
+            if (nread < 0 && errno == EINTR)
+                continue;
+            if (nread <= 0)
+                break;
+            length += nread;
+        }
+
+        output.resize(length);
+        close(pipe_fds[0]);
+
+        auto status = wait_for_child(pid);
+        m_last_substitution_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+
+    // The trailing <newline> characters are removed in place.
+    auto last = output.find_last_not_of('\n');
+    output.resize(last == std::string::npos ? 0 : last + 1);
+
+    return output;
+}
+
+int Shell::run_script(std::string_view input)
+{
+    if (input.length() <= 1)
+        return 0;
+
+    auto node = parse(input);
+    if (!node)
+        return 0;
+
+    if (node->is_syntax_error()) {
+        auto err_node = std::static_pointer_cast<AST::SyntaxError>(node);
+        print_error(err_node->error_message(), Error::SyntaxError);
+        return 1;
+    }
+
+    m_profiler.set_source(m_name, input);
+
+    auto rc = run_value(node->eval(), LaunchMode::Replace);
+    return should_exit() ? exit_code() : rc;
+}
+
+int Shell::run_value(std::shared_ptr<Value> const& value, LaunchMode mode)
+{
+    if (!value)
+        return 0;
 
     if (value->is_command()) {
         auto cmd = std::static_pointer_cast<CommandValue>(value);
-        return run_command(cmd);
+
+        // A simple command that is the last thing to run doesn't need to be forked: the
+        // utility can replace this process.
+        if (mode == LaunchMode::Replace && !cmd->next_in_pipeline && !cmd->compound && !has_work_at_exit())
+            return m_last_exit_status = run_simple_command(*cmd, LaunchMode::Replace);
+        return m_last_exit_status = run_command(cmd);
     }
     if (value->is_and_or_list()) {
         auto and_or = std::static_pointer_cast<AndOrListValue>(value);
-        return run_commands(and_or->commands);
+        return m_last_exit_status = run_commands(and_or->commands, mode);
     }
+    if (value->is_list())
+        return run_list(static_cast<ListValue const&>(*value), mode);
 
     return 0;
 }
 
-int Shell::run_command(std::shared_ptr<CommandValue> const& cmd)
+void Shell::run_and_exit(std::shared_ptr<Value> const& value)
 {
-    if (!cmd)
-        return 0;
-    if (!cmd->next_in_pipeline)
-        return run_command(cmd->argv, cmd->redirections);
+    auto rc = run_value(value, LaunchMode::Replace);
+
+    std::cout.flush();
+    _exit(should_exit() ? exit_code() : rc);
+}
+
+void Shell::run_stage_and_exit(CommandValue const& cmd)
+{
+    auto rc = cmd.compound ? run_stage(cmd) : run_simple_command(cmd, LaunchMode::Replace);
 
+    std::cout.flush();
+    _exit(should_exit() ? exit_code() : rc);
+}
+
+int Shell::run_list(ListValue const& list, LaunchMode mode)
+{
     int rc = 0;
 
-    FileDescriptionCollector open_fds;
-    SavedFileDescriptions saved_fds;
-    int pipe_fds[2];
+    for (size_t i = 0; i < list.items.size(); i++) {
+        // The profile charges time to one line at a time, which wouldn't add up with
+        // several running at once.
+        if (m_options.autoparallel && !m_options.profile) {
+            if (auto count = run_in_parallel(std::span { list.items }.subspan(i), rc); count > 0) {
+                i += count - 1;
+                if (is_unwinding())
+                    break;
+                continue;
+            }
+        }
 
-    // Initialize the first command.
-    if (pipe2(pipe_fds, O_CLOEXEC) < 0) {
-        perror("pipe");
-        return 1;
+        auto is_last = i + 1 == list.items.size();
+        rc = run_value(list.items[i], is_last ? mode : LaunchMode::Fork);
+        if (is_unwinding())
+            break;
     }
 
-    /// NOTE: Just in case of any errors, we add any pipe-opened fds so that the
-    //  destructor can close them when returning. In normal execution, they
-    // shouldn't both be closed right away.
-    open_fds.add(pipe_fds[0]);
-    open_fds.add(pipe_fds[1]);
+    return rc;
+}
+
+size_t Shell::run_in_parallel(std::span<std::shared_ptr<Value> const> items, int& rc)
+{
+    auto output_is_shared = is_output_shared();
+    size_t count = 0;
+    while (count < items.size() && can_run_in_parallel(items[count], m_functions, output_is_shared))
+        count++;
+    if (count < 2)
+        return 0;
 
-    saved_fds.add(STDOUT_FILENO);
+    struct Job {
+        CommandValue const* cmd { nullptr };
+        std::vector<std::string> fields;
+        std::vector<std::pair<std::string, std::string>> assignments;
+        // What the command writes to the shell's standard output and error, which is
+        // passed on once the commands before it are done. When they're shared, the one
+        // capture for standard output takes both.
+        int captures[2] { -1, -1 };
+        pid_t pid { -1 };
+        int pidfd { -1 };
+        bool is_done { false };
+        int status { 0 };
+    };
+
+    // Reading from a pipe, a socket or a file takes the data away from the commands that
+    // come after, unlike reading from a terminal, which has nothing to read until someone
+    // types it, or from /dev/null.
+    struct stat input {};
+    auto is_input_consumed = fstat(STDIN_FILENO, &input) == 0 && (S_ISFIFO(input.st_mode) || S_ISSOCK(input.st_mode) || S_ISREG(input.st_mode));
+
+    // The words are expanded up front, as nothing that runs in between can change them.
+    // A command whose expansions fail ends the ones that can go together: it fails once
+    // those before it are done.
+    std::vector<Job> jobs(count);
+    std::vector<CommandEffects> effects;
+    effects.reserve(count);
+    auto has_failed_expansion = false;
+    for (size_t i = 0; i < count; i++) {
+        auto& job = jobs[i];
+        job.cmd = static_cast<CommandValue const*>(items[i].get());
+
+        Expander expander { *this };
+        job.fields = expander.expand_words(job.cmd->argv);
+        for (auto const& assignment : job.cmd->assignments) {
+            auto equals = assignment.find('=');
+            job.assignments.emplace_back(assignment.substr(0, equals), expander.expand_word(std::string_view { assignment }.substr(equals + 1)));
+        }
+        effects.push_back(effects_of(*job.cmd, expander, is_input_consumed));
 
-    // Redirect stdout to write end of pipe.
-    if (dup2(pipe_fds[1], STDOUT_FILENO) < 0) {
-        perror("dup2");
+        if (expander.has_failed()) {
+            has_failed_expansion = true;
+            count = i;
+            jobs.resize(count);
+            effects.resize(count);
+        }
+    }
+    if (count == 0) {
+        m_last_exit_status = rc = fail_command();
         return 1;
     }
+    auto dependencies = find_dependencies(effects);
+
+    // A command is ready once everything it depends on is done, and the ready ones start
+    // in the order they're written in.
+    std::vector<size_t> waiting_on(count);
+    std::vector<std::vector<size_t>> dependents(count);
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<>> ready;
+    for (size_t i = 0; i < count; i++) {
+        waiting_on[i] = dependencies[i].size();
+        for (auto dependency : dependencies[i])
+            dependents[dependency].push_back(i);
+        if (waiting_on[i] == 0)
+            ready.push(i);
+    }
+
+    auto max_running = m_options.autoparallel_jobs > 0 ? m_options.autoparallel_jobs : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> running;
+    size_t next_to_report = 0;
+    std::vector<pollfd> pollfds;
+
+    auto finish = [&](size_t index, int status) {
+        auto& job = jobs[index];
+        job.is_done = true;
+        job.status = status;
+        for (auto dependent : dependents[index]) {
+            if (--waiting_on[dependent] == 0)
+                ready.push(dependent);
+        }
+    };
+
+    auto reap = [&](size_t index) {
+        auto& job = jobs[index];
+        auto status = wait_for_child(job.pid);
+        if (job.pidfd >= 0)
+            close(job.pidfd);
+        std::erase(running, index);
+        finish(index, WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    };
+
+    auto launch = [&](size_t index) {
+        auto& job = jobs[index];
+        m_statistics.increment(Statistics::Counter::Execs);
+        job.captures[0] = move_to_shell_range(memfd_create("ratsh-output", MFD_CLOEXEC));
+        if (!output_is_shared)
+            job.captures[1] = move_to_shell_range(memfd_create("ratsh-output", MFD_CLOEXEC));
+        auto error_capture = output_is_shared ? job.captures[0] : job.captures[1];
+
+        auto pid = job.captures[0] < 0 || error_capture < 0 ? -1 : fork_shell();
+        if (pid < 0) {
+            perror("fork");
+            finish(index, 1);
+            return;
+        }
 
-    open_fds.clear();
-    close(pipe_fds[1]);
+        if (pid == 0) {
+            SavedFileDescriptions saved_fds;
+            if (dup2(job.captures[0], STDOUT_FILENO) < 0 || dup2(error_capture, STDERR_FILENO) < 0 || !apply_redirections(job.cmd->redirections, saved_fds))
+                _exit(1);
+            for (auto const& [name, value] : job.assignments)
+                setenv(name.c_str(), value.c_str(), 1);
+            execute_process(job.fields);
+        }
 
-    run_command(cmd->argv, cmd->redirections);
+        job.pid = pid;
+        job.pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+        if (job.pidfd >= 0)
+            fcntl(job.pidfd, F_SETFD, FD_CLOEXEC);
+        running.push_back(index);
+    };
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    while (next_to_report < count) {
+        while (!ready.empty() && running.size() < max_running && ready.top() < next_to_report + max_unreported_jobs) {
+            auto index = ready.top();
+            ready.pop();
+            launch(index);
+        }
 
-    // Restore stdout after execution completes.
-    saved_fds.restore();
+        // The output comes out in the order it would have without any of this.
+        for (; next_to_report < count && jobs[next_to_report].is_done; next_to_report++) {
+            auto& job = jobs[next_to_report];
+            for (int fd = STDOUT_FILENO; fd <= STDERR_FILENO; fd++) {
+                auto& capture = job.captures[fd - STDOUT_FILENO];
+                if (capture < 0)
+                    continue;
+                replay_output(capture, fd);
+                close(capture);
+                capture = -1;
+            }
+        }
+        if (running.empty())
+            continue;
 
-    auto next_cmd = cmd->next_in_pipeline;
-    while (next_cmd) {
-        // Save read end of pipe in case we pipe again.
-        auto pipe_read_fd = pipe_fds[0];
+        // Without a pidfd, there's nothing to do but wait for the job itself.
+        if (auto it = std::find_if(running.begin(), running.end(), [&jobs](size_t index) { return jobs[index].pidfd < 0; }); it != running.end()) {
+            reap(*it);
+            continue;
+        }
 
-        // Add read end of pipe to collector in case of errors.
-        open_fds.add(pipe_fds[0]);
+        pollfds.clear();
+        for (auto index : running)
+            pollfds.push_back({ .fd = jobs[index].pidfd, .events = POLLIN, .revents = 0 });
+        if (poll(pollfds.data(), pollfds.size(), -1) < 0 && errno != EINTR) {
+            perror("poll");
+            reap(running.front());
+            continue;
+        }
 
-        // If we aren't the last command, we should pipe again.
-        if (next_cmd->next_in_pipeline != nullptr) {
-            if (pipe2(pipe_fds, O_CLOEXEC) < 0) {
-                perror("pipe");
-                return 1;
-            }
+        // Going backwards keeps the positions of the jobs still to be looked at.
+        for (size_t i = pollfds.size(); i-- > 0;) {
+            if (pollfds[i].revents != 0)
+                reap(running[i]);
+        }
+    }
 
-            open_fds.add(pipe_fds[0]);
-            open_fds.add(pipe_fds[1]);
+    m_last_exit_status = rc = jobs.back().status;
+    if (has_failed_expansion) {
+        m_last_exit_status = rc = fail_command();
+        return count + 1;
+    }
+    return count;
+}
 
-            saved_fds.add(STDOUT_FILENO);
+CommandEffects Shell::effects_of(CommandValue const& cmd, Expander& expander, bool is_input_consumed)
+{
+    CommandEffects effects;
+    auto reads_standard_input = is_input_consumed;
 
-            // Redirect stdout to write end of pipe.
-            if (dup2(pipe_fds[1], STDOUT_FILENO) < 0) {
-                perror("dup2");
-                return 1;
-            }
+    for (auto const& redir : cmd.redirections) {
+        if (redir->io_number == STDIN_FILENO)
+            reads_standard_input = false;
 
-            close(pipe_fds[1]);
+        switch (redir->action) {
+        case RedirectionValue::Action::Open: {
+            auto const& data = std::get<RedirectionValue::PathData>(redir->redir_variant);
+            auto key = file_effect_key(expander.expand_word(data.path), m_working_directory.path());
+            if (!key.has_value())
+                break;
+            if ((data.flags & O_ACCMODE) == O_RDONLY)
+                effects.reads.push_back(std::move(key.value()));
+            else
+                effects.writes.push_back(std::move(key.value()));
+            break;
+        }
+        case RedirectionValue::Action::InputDup:
+        case RedirectionValue::Action::OutputDup: {
+            // Standard output and error are captured for each command on its own. Reading
+            // from any other descriptor moves its offset, so it counts as a write too.
+            auto right_fd = std::get<int>(redir->redir_variant);
+            if (right_fd != STDOUT_FILENO && right_fd != STDERR_FILENO)
+                effects.writes.push_back(fd_effect_key(right_fd));
+            break;
+        }
+        case RedirectionValue::Action::Close:
+            break;
         }
+    }
 
-        saved_fds.add(STDIN_FILENO);
+    // Only one command at a time gets to read what's left of the shell's input.
+    if (reads_standard_input)
+        effects.writes.push_back(fd_effect_key(STDIN_FILENO));
+    return effects;
+}
 
-        // Redirect stdin to read end of pipe.
-        if (dup2(pipe_read_fd, STDIN_FILENO) < 0) {
-            perror("dup2");
+int Shell::run_command(std::shared_ptr<CommandValue> const& cmd)
+{
+    if (!cmd)
+        return 0;
+    if (!m_options.profile)
+        return run_pipeline(cmd);
+
+    // The whole pipeline is charged to the line it starts on.
+    m_profiler.enter_command(cmd->line);
+    auto rc = run_pipeline(cmd);
+    m_profiler.leave_command();
+    return rc;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_02
+int Shell::run_pipeline(std::shared_ptr<CommandValue> const& cmd)
+{
+    if (!cmd->next_in_pipeline)
+        return run_stage(*cmd);
+
+    // Every stage but the last runs in a process of its own, all of them at the same
+    // time so that none blocks on a full pipe. The last stage runs in the shell itself,
+    // which saves a process and lets e.g. "cmd | read x" set x.
+    std::vector<pid_t> pids;
+    auto wait_for_stages = [this, &pids] {
+        for (auto pid : pids)
+            wait_for_child(pid);
+    };
+
+    std::cout.flush();
+
+    auto stage = cmd;
+    int read_fd = -1;
+    for (; stage->next_in_pipeline; stage = stage->next_in_pipeline) {
+        int pipe_fds[2];
+        if (!open_pipe(pipe_fds)) {
+            perror("pipe");
+            if (read_fd >= 0)
+                close(read_fd);
+            wait_for_stages();
             return 1;
         }
 
-        open_fds.clear();
-        close(pipe_read_fd);
+        // A bigger pipe means fewer context switches when a lot of data goes through it.
+        // The kernel may still refuse, e.g. once the user has used up their quota of pipe
+        // buffers, in which case the pipe just keeps its default size.
+        if (m_options.pipe_size > 0)
+            fcntl(pipe_fds[1], F_SETPIPE_SZ, static_cast<int>(m_options.pipe_size));
 
-        // (2.9.2) The exit status shall be the exit status of the last command specified in the pipeline.
-        rc = run_command(next_cmd->argv, next_cmd->redirections);
+        auto pid = fork_shell();
+        if (pid < 0) {
+            perror("fork");
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            if (read_fd >= 0)
+                close(read_fd);
+            wait_for_stages();
+            return 1;
+        }
 
-        saved_fds.restore();
-        next_cmd = next_cmd->next_in_pipeline;
+        if (pid == 0) {
+            close(pipe_fds[0]);
+            if ((read_fd >= 0 && dup2(read_fd, STDIN_FILENO) < 0) || dup2(pipe_fds[1], STDOUT_FILENO) < 0) {
+                perror("dup2");
+                _exit(1);
+            }
+            if (read_fd >= 0)
+                close(read_fd);
+            close(pipe_fds[1]);
+            run_stage_and_exit(*stage);
+        }
+
+        pids.push_back(pid);
+        close(pipe_fds[1]);
+        if (read_fd >= 0)
+            close(read_fd);
+        read_fd = pipe_fds[0];
+    }
+
+    // (2.9.2) The exit status shall be the exit status of the last command specified in the pipeline.
+    int rc = 1;
+    {
+        SavedFileDescriptions saved_fds;
+        saved_fds.add(STDIN_FILENO);
+
+        auto redirected = dup2(read_fd, STDIN_FILENO) >= 0;
+        if (!redirected)
+            perror("dup2");
+        close(read_fd);
+
+        if (redirected)
+            rc = run_stage(*stage);
     }
 
+    wait_for_stages();
     return rc;
 }
 
-int Shell::run_command(std::vector<std::string> const& argv, std::vector<std::shared_ptr<RedirectionValue>> const& redirections)
+int Shell::run_stage(CommandValue const& cmd)
+{
+    if (cmd.compound && cmd.compound->is_subshell())
+        return run_subshell(static_cast<SubshellValue&>(*cmd.compound), cmd.redirections);
+    if (cmd.compound)
+        return run_compound_command(cmd);
+
+    return run_simple_command(cmd);
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_01
+int Shell::run_simple_command(CommandValue const& cmd, LaunchMode mode)
 {
-    FileDescriptionCollector fds;
+    auto start = std::chrono::steady_clock::now();
     SavedFileDescriptions saved_fds;
 
-    if (!apply_redirections(redirections, fds, saved_fds))
+    // The process substitutions are words, so they start before the redirections are
+    // done, and see the shell's own descriptors.
+    std::vector<std::string> substituted_argv;
+    if (!cmd.process_substitutions.empty()) {
+        substituted_argv = cmd.argv;
+
+        std::vector<int> pipe_fds;
+        for (auto const& [index, substitution] : cmd.process_substitutions) {
+            auto pipe_fd = start_process_substitution(*substitution, saved_fds);
+            if (pipe_fd < 0)
+                return 1;
+            pipe_fds.push_back(pipe_fd);
+            substituted_argv[index] = "/dev/fd/" + std::to_string(pipe_fd);
+        }
+
+        // The utility opens the path itself, so its descriptor has to survive exec. It's
+        // only done now so that the substitutions don't hold on to each other's pipes.
+        for (auto pipe_fd : pipe_fds) {
+            if (fcntl(pipe_fd, F_SETFD, 0) < 0) {
+                perror("fcntl");
+                return 1;
+            }
+        }
+    }
+
+    if (!apply_redirections(cmd.redirections, saved_fds)) {
+        // Only a literal name is known to be a special builtin before it's expanded, as
+        // in "exec 9< file".
+        if (!cmd.argv.empty() && cmd.argv[0].find_first_of("$`'\"\\") == std::string::npos) {
+            if (auto const* builtin = find_builtin(cmd.argv[0]); builtin != nullptr && builtin->is_special)
+                return fail_command();
+        }
         return 1;
-    if (auto rc_maybe = run_builtin(argv); rc_maybe.has_value())
-        return rc_maybe.value();
+    }
 
-    auto pid = fork();
+    Expander expander { *this };
+    m_last_substitution_status = 0;
+
+    std::span<std::string const> words = cmd.process_substitutions.empty() ? cmd.argv : substituted_argv;
+
+    // With argbatch, the word that expands to the most fields is the one to split, should
+    // they turn out not to fit, e.g. the files in "cp *.c dir".
+    ExpandedCommand command;
+    auto& fields = command.fields;
+    auto& first_batched = command.first_batched;
+    auto& end_batched = command.end_batched;
+    if (m_options.argbatch) {
+        for (size_t i = 0; i < words.size(); i++) {
+            auto word_fields = expander.expand_words(words.subspan(i, 1));
+            if (word_fields.size() > end_batched - first_batched) {
+                first_batched = fields.size();
+                end_batched = first_batched + word_fields.size();
+            }
+            fields.insert(fields.end(), std::make_move_iterator(word_fields.begin()), std::make_move_iterator(word_fields.end()));
+        }
+    } else {
+        fields = expander.expand_words(words);
+    }
+
+    for (auto const& assignment : cmd.assignments) {
+        auto equals = assignment.find('=');
+        command.assignments.emplace_back(assignment.substr(0, equals), expander.expand_word(std::string_view { assignment }.substr(equals + 1)));
+    }
+
+    if (expander.has_failed())
+        return fail_command();
+
+    // (2.9.1) If no command name results, variable assignments shall affect the current
+    // execution environment.
+    if (fields.empty()) {
+        for (auto& [name, value] : command.assignments)
+            m_variables.set(name, std::move(value));
+        return m_last_substitution_status;
+    }
+
+    if (mode == LaunchMode::Replace && has_work_at_exit())
+        mode = LaunchMode::Fork;
+
+    return run_expanded_command(std::move(command), saved_fds, mode, start);
+}
+
+int Shell::run_expanded_command(ExpandedCommand&& command, SavedFileDescriptions& saved_fds, LaunchMode mode, std::chrono::steady_clock::time_point start)
+{
+    auto& [fields, assignments, first_batched, end_batched] = command;
+
+    // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_01_01
+    auto const* builtin = find_builtin(fields[0]);
+
+    // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#exec
+    // The command replaces the shell, and is never a function or a builtin.
+    auto is_exec = builtin != nullptr && builtin->function == builtin_exec && fields.size() > 1;
+    if (is_exec) {
+        fields.erase(fields.begin());
+        builtin = nullptr;
+        mode = LaunchMode::Replace;
+    }
+
+    std::shared_ptr<CommandValue> function;
+    if (!is_exec && (builtin == nullptr || !builtin->is_special)) {
+        if (auto it = m_functions.find(fields[0]); it != m_functions.end())
+            function = it->second;
+    }
+
+    if (builtin != nullptr || function) {
+        // Otherwise, the assignments only last for the command's execution.
+        std::vector<std::pair<std::string, std::optional<std::string>>> saved_variables;
+        for (auto& [name, value] : assignments) {
+            auto const* variable = m_variables.find(name);
+            saved_variables.emplace_back(name, variable != nullptr ? std::optional { variable->value } : std::nullopt);
+            m_variables.set(name, std::move(value));
+        }
+
+        if (!function)
+            m_statistics.increment(Statistics::Counter::Builtins);
+        auto rc = function ? run_function(*function, std::move(fields)) : builtin->function(*this, fields);
+
+        // (exec) Without a command, the redirections stay in effect for the shell.
+        if (builtin != nullptr && builtin->function == builtin_exec)
+            saved_fds.discard();
+
+        // Make sure the output lands before any redirections are undone. The commands
+        // in a function have already seen to that themselves.
+        if (!function)
+            std::cout.flush();
+
+        for (auto& [name, value] : saved_variables) {
+            if (value.has_value())
+                m_variables.set(name, std::move(value.value()));
+            else
+                m_variables.unset(name);
+        }
+
+        return rc;
+    }
+
+    if (m_options.argbatch && first_batched > 0) {
+        if (auto rc = run_in_batches(fields, first_batched, end_batched, assignments); rc.has_value())
+            return rc.value();
+    }
+
+    m_statistics.increment(Statistics::Counter::Execs);
+
+    auto pid = mode == LaunchMode::Replace ? 0 : fork_shell();
     if (pid < 0) {
         /// NOTE: The POSIX spec does not mention what exit code to return when fork() fails.
         return 1;
     }
+    if (pid > 0)
+        m_statistics.launch_latency().record(std::chrono::steady_clock::now() - start);
 
     if (pid == 0) {
-        fds.collect();
-        return execute_process(argv);
+        // Anything the builtins wrote is still in this process's buffer.
+        if (mode == LaunchMode::Replace)
+            std::cout.flush();
+
+        for (auto const& [name, value] : assignments)
+            setenv(name.c_str(), value.c_str(), 1);
+
+        return execute_process(fields);
     }
 
-    int status {};
-    wait(&status);
+    auto status = wait_for_child(pid);
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+
+    return 0;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/xargs.html
+std::optional<int> Shell::run_in_batches(std::vector<std::string> const& fields, size_t first_batched, size_t end_batched, std::vector<std::pair<std::string, std::string>> const& assignments)
+{
+    // (xargs) 2048 bytes are left over for the utility to modify its environment with.
+    auto limit = static_cast<size_t>(std::max(sysconf(_SC_ARG_MAX), 4096L)) - 2048;
+
+    size_t environment_size = 0;
+    for (auto** variable = environ; *variable != nullptr; variable++)
+        environment_size += argument_size(*variable);
+    for (auto const& [name, value] : assignments)
+        environment_size += name.size() + 1 + argument_size(value);
+
+    ArgumentBatch batched { first_batched, end_batched };
+    auto batches = split_into_batches(fields, batched, environment_size, limit);
+    if (!batches.has_value())
+        return std::nullopt;
+
+    // Runs at the same time would write over each other, so each one's standard output
+    // is held on to until the ones before it are done, along with its standard error if
+    // that's the same file. Otherwise errors come out as they happen, as with xargs -P.
+    auto is_capturing = m_options.argbatch_jobs > 1;
+    auto output_is_shared = is_capturing && is_output_shared();
+
+    std::cout.flush();
+    std::cerr.flush();
+
+    struct Run {
+        pid_t pid { -1 };
+        int capture { -1 };
+    };
+
+    auto launch = [&](ArgumentBatch batch) -> Run {
+        m_statistics.increment(Statistics::Counter::Execs);
+
+        Run run;
+        if (is_capturing) {
+            run.capture = move_to_shell_range(memfd_create("ratsh-output", MFD_CLOEXEC));
+            if (run.capture < 0)
+                return run;
+        }
+
+        run.pid = fork_shell();
+        if (run.pid != 0)
+            return run;
+
+        if (run.capture >= 0 && (dup2(run.capture, STDOUT_FILENO) < 0 || (output_is_shared && dup2(run.capture, STDERR_FILENO) < 0)))
+            _exit(1);
+        for (auto const& [name, value] : assignments)
+            setenv(name.c_str(), value.c_str(), 1);
+        _exit(execute_process(fields_for_batch(fields, batched, batch)));
+    };
+
+    // The runs are waited for in the order they started, which keeps the rest of the
+    // shell's children out of it, and is the order their output is passed on in.
+    BatchStatus status;
+    auto finish = [&](Run const& run) {
+        status.add(wait_for_child(run.pid));
+        if (run.capture >= 0) {
+            replay_output(run.capture, STDOUT_FILENO);
+            close(run.capture);
+        }
+    };
+
+    int rc = 0;
+    std::queue<Run> running;
+    for (auto const& batch : batches.value()) {
+        if (status.should_stop())
+            break;
+        while (running.size() >= std::max(m_options.argbatch_jobs, 1u)) {
+            finish(running.front());
+            running.pop();
+        }
+
+        auto run = launch(batch);
+        if (run.pid < 0) {
+            perror("fork");
+            if (run.capture >= 0)
+                close(run.capture);
+            rc = 1;
+            break;
+        }
+        running.push(run);
+    }
+    for (; !running.empty(); running.pop())
+        finish(running.front());
+
+    return rc != 0 ? rc : status.exit_status();
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_04_01
+int Shell::run_subshell(SubshellValue& subshell, std::vector<std::shared_ptr<RedirectionValue>> const& redirections)
+{
+    // A subshell that only changes state we can cheaply save and restore doesn't need a
+    // process of its own. This is decided once, so loops don't repeat the work.
+    if (!subshell.can_run_in_process.has_value() || subshell.function_generation != m_function_generation) {
+        subshell.can_run_in_process = is_snapshot_safe(subshell.body, m_functions);
+        subshell.function_generation = m_function_generation;
+    }
+
+    if (subshell.can_run_in_process.value()) {
+        if (auto snapshot = take_snapshot(); snapshot.has_value()) {
+            SavedFileDescriptions saved_fds;
+
+            int rc = 1;
+            if (apply_redirections(redirections, saved_fds))
+                rc = run_value(subshell.body);
+            // Exiting, which an expansion error may lead to, only ends the subshell.
+            if (m_exit_code.has_value())
+                rc = *std::exchange(m_exit_code, std::nullopt);
+
+            std::cout.flush();
+            restore_snapshot(std::move(snapshot.value()));
+            return rc;
+        }
+    }
+
+    std::cout.flush();
+
+    auto pid = fork_shell();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+
+    if (pid == 0) {
+        SavedFileDescriptions saved_fds;
+
+        if (!apply_redirections(redirections, saved_fds))
+            _exit(1);
+        run_and_exit(subshell.body);
+    }
+
+    auto status = wait_for_child(pid);
     if (WIFEXITED(status))
         return WEXITSTATUS(status);
+    if (WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
 
     return 0;
 }
 
-int Shell::run_commands(std::vector<std::shared_ptr<CommandValue>> const& commands)
+int Shell::run_compound_command(CommandValue const& cmd)
+{
+    // The redirections are in place for the whole command, however many times its parts
+    // run.
+    SavedFileDescriptions saved_fds;
+
+    if (!apply_redirections(cmd.redirections, saved_fds))
+        return 1;
+
+    int rc = 0;
+    if (cmd.compound->is_brace_group()) {
+        rc = run_value(static_cast<BraceGroupValue const&>(*cmd.compound).body);
+    } else if (cmd.compound->is_function_definition()) {
+        auto const& definition = static_cast<FunctionDefinitionValue const&>(*cmd.compound);
+        define_function(definition.name, definition.body);
+    } else if (cmd.compound->is_for_loop())
+        rc = run_for_loop(static_cast<ForLoopValue const&>(*cmd.compound));
+    else if (cmd.compound->is_while_loop())
+        rc = run_while_loop(static_cast<WhileLoopValue const&>(*cmd.compound));
+
+    if (!cmd.redirections.empty())
+        std::cout.flush();
+    return rc;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_04_03
+int Shell::run_for_loop(ForLoopValue const& loop)
+{
+    // Without any words, the loop goes over the positional parameters as they were when
+    // it started.
+    std::vector<std::string> words;
+    if (loop.words.has_value()) {
+        Expander expander { *this };
+        words = expander.expand_words(loop.words.value());
+        if (expander.has_failed())
+            return fail_command();
+    } else {
+        words = m_positional_parameters;
+    }
+
+    // The body was lowered when the loop was parsed, so every iteration just runs it
+    // again.
+    int rc = 0;
+    m_loop_depth++;
+
+    for (auto& word : words) {
+        m_variables.set(loop.name, std::move(word));
+        rc = run_value(loop.body);
+        if (should_stop_loop())
+            break;
+    }
+
+    m_loop_depth--;
+    return rc;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_04_09
+int Shell::run_while_loop(WhileLoopValue const& loop)
+{
+    int rc = 0;
+    m_loop_depth++;
+
+    while (true) {
+        auto condition = run_value(loop.condition);
+        if (should_stop_loop())
+            break;
+        if ((condition == 0) == loop.is_until)
+            break;
+
+        rc = run_value(loop.body);
+        if (should_stop_loop())
+            break;
+    }
+
+    m_loop_depth--;
+    return rc;
+}
+
+// Takes care of a pending break or continue at the end of an iteration.
+bool Shell::should_stop_loop()
+{
+    if (should_exit() || m_pending_return)
+        return true;
+
+    if (m_pending_breaks > 0) {
+        m_pending_breaks--;
+        return true;
+    }
+
+    // Continuing an outer loop means leaving this one first.
+    if (m_pending_continues > 0) {
+        m_pending_continues--;
+        return m_pending_continues > 0;
+    }
+
+    return false;
+}
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#tag_18_09_05
+int Shell::run_function(CommandValue const& body, std::vector<std::string>&& argv)
+{
+    if (m_function_depth >= max_function_depth) {
+        print_error(argv[0] + ": maximum function nesting level exceeded", Error::General);
+        return 1;
+    }
+
+    // The operands become the positional parameters for the duration of the call, and
+    // loops around the call are out of reach of break and continue.
+    auto is_profiled = m_options.profile;
+    if (is_profiled)
+        m_profiler.enter_function(argv[0]);
+
+    argv.erase(argv.begin());
+    auto saved_parameters = std::exchange(m_positional_parameters, std::move(argv));
+    auto saved_loop_depth = std::exchange(m_loop_depth, 0);
+    m_function_depth++;
+
+    auto rc = run_stage(body);
+    if (m_pending_return) {
+        m_pending_return = false;
+        rc = m_return_code;
+    }
+
+    if (is_profiled)
+        m_profiler.leave_function();
+    m_function_depth--;
+    m_loop_depth = saved_loop_depth;
+    m_positional_parameters = std::move(saved_parameters);
+
+    return rc;
+}
+
+void Shell::define_function(std::string const& name, std::shared_ptr<CommandValue> body)
+{
+    m_functions[name] = std::move(body);
+    m_function_generation++;
+}
+
+void Shell::unset_function(std::string const& name)
+{
+    if (m_functions.erase(name) > 0)
+        m_function_generation++;
+}
+
+int Shell::run_commands(std::vector<std::shared_ptr<CommandValue>> const& commands, LaunchMode mode)
 {
     if (commands.empty())
         return 0;
@@ -270,7 +1445,14 @@ int Shell::run_commands(std::vector<std::shared_ptr<CommandValue>> const& comman
             continue;
         }
 
-        rc = run_command(command);
+        // Nothing can follow the last command once it runs.
+        if (mode == LaunchMode::Replace && command == commands.back() && !command->next_in_pipeline && !command->compound && !has_work_at_exit())
+            rc = run_simple_command(*command, LaunchMode::Replace);
+        else
+            rc = run_command(command);
+        if (is_unwinding())
+            break;
+
         if ((command->op == CommandValue::WithOp::AndIf && rc != 0)
             || (command->op == CommandValue::WithOp::OrIf && rc == 0))
             should_run = false;
@@ -283,19 +1465,51 @@ int Shell::run_commands(std::vector<std::shared_ptr<CommandValue>> const& comman
     return rc;
 }
 
-std::optional<int> Shell::run_builtin(std::vector<std::string> const& argv)
+std::optional<WorkingDirectory> Shell::change_directory(WorkingDirectory&& directory)
 {
-    if (argv.empty())
-        return 0;
+    if (!directory.enter())
+        return std::nullopt;
+
+    auto previous = std::exchange(m_working_directory, std::move(directory));
+
+    m_variables.set("OLDPWD", previous.path());
+    m_variables.export_variable("OLDPWD");
+    m_variables.set("PWD", m_working_directory.path());
+    m_variables.export_variable("PWD");
+
+    return previous;
+}
 
-    auto const& cmd = argv[0];
+std::optional<Shell::Snapshot> Shell::take_snapshot()
+{
+    // Holding on to the directory itself makes restoring it immune to renames.
+    auto working_directory = m_working_directory.duplicate();
+    if (!working_directory.has_value())
+        return std::nullopt;
+
+    return Snapshot {
+        .working_directory = std::move(working_directory.value()),
+        .variables = m_variables,
+        .options = m_options,
+        .positional_parameters = m_positional_parameters,
+        .functions = m_functions,
+    };
+}
+
+void Shell::restore_snapshot(Snapshot&& snapshot)
+{
+    if (!snapshot.working_directory.enter())
+        perror("fchdir");
+    m_working_directory = std::move(snapshot.working_directory);
 
-    if (cmd == "cd")
-        return builtin_cd(argv);
-    if (cmd == "pwd")
-        return builtin_pwd(argv);
+    m_variables.restore(std::move(snapshot.variables));
+    m_options = snapshot.options;
+    m_positional_parameters = std::move(snapshot.positional_parameters);
 
-    return std::nullopt;
+    if (m_functions != snapshot.functions) {
+        m_functions = std::move(snapshot.functions);
+        m_function_generation++;
+    }
 }
 
 void Shell::print_error(std::string const& message, Error error)
@@ -310,10 +1524,119 @@ void Shell::print_error(std::string const& message, Error error)
     }
 }
 
-std::shared_ptr<AST::Node> Shell::parse(std::string_view input) const
+std::shared_ptr<AST::Node> Shell::parse(std::string_view input)
 {
+    auto start = std::chrono::steady_clock::now();
+
     Parser parser { input };
-    return parser.parse();
+    auto node = parser.parse();
+
+    m_statistics.parse_latency().record(std::chrono::steady_clock::now() - start);
+    m_statistics.increment(Statistics::Counter::BytesLexed, input.size());
+    return node;
+}
+
+pid_t Shell::fork_shell()
+{
+    m_statistics.increment(Statistics::Counter::Forks);
+
+    auto pid = fork();
+    if (pid > 0 && m_options.profile)
+        m_profiler.count_fork();
+
+    // Only the shell itself reports at exit, which leaves a child free to exec its last
+    // command.
+    if (pid == 0) {
+        m_statistics.set_report_at_exit(std::nullopt);
+        m_options.profile = false;
+        m_profiler = {};
+    }
+    return pid;
+}
+
+// https://www.gnu.org/software/bash/manual/html_node/Process-Substitution.html
+int Shell::start_process_substitution(ProcessSubstitutionValue const& substitution, SavedFileDescriptions& saved_fds)
+{
+    int pipe_fds[2];
+    if (!open_pipe(pipe_fds)) {
+        perror("pipe");
+        return -1;
+    }
+
+    // "<(list)" reads what the list writes, and ">(list)" writes what the list reads.
+    auto is_input = substitution.direction == ProcessSubstitutionValue::Direction::Input;
+    auto list_fd = is_input ? pipe_fds[1] : pipe_fds[0];
+    auto shell_fd = is_input ? pipe_fds[0] : pipe_fds[1];
+
+    std::cout.flush();
+
+    auto pid = fork_shell();
+    if (pid < 0) {
+        perror("fork");
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        close(shell_fd);
+        if (dup2(list_fd, is_input ? STDOUT_FILENO : STDIN_FILENO) < 0) {
+            perror("dup2");
+            _exit(1);
+        }
+        close(list_fd);
+        run_and_exit(substitution.body);
+    }
+
+    close(list_fd);
+
+    // (2.7) A redirection may take any of 0 through 9 for itself.
+    shell_fd = move_to_shell_range(shell_fd);
+    saved_fds.add_process_substitution(pid, shell_fd);
+    if (shell_fd < 0)
+        perror("fcntl");
+    return shell_fd;
+}
+
+pid_t Shell::start_command(std::vector<std::string> fields)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::cout.flush();
+
+    // Both sides set the process group, so that it's in place whichever runs first.
+    auto pid = fork_shell();
+    if (pid > 0)
+        setpgid(pid, pid);
+    if (pid != 0)
+        return pid;
+
+    setpgid(0, 0);
+
+    // This process is the command's, so there's nothing left to do once it's run.
+    SavedFileDescriptions saved_fds;
+    auto rc = run_expanded_command({ .fields = std::move(fields), .assignments = {} }, saved_fds, LaunchMode::Replace, start);
+    std::cout.flush();
+    _exit(should_exit() ? exit_code() : rc);
+}
+
+int Shell::wait_for_child(pid_t pid)
+{
+    int status {};
+    struct rusage usage {};
+    while (wait4(pid, &status, 0, &usage) < 0) {
+        if (errno != EINTR)
+            return status;
+    }
+
+    if (m_options.profile)
+        m_profiler.add_child_usage(usage);
+    return status;
+}
+
+bool Shell::open_pipe(int fds[2])
+{
+    m_statistics.increment(Statistics::Counter::Pipes);
+    return pipe2(fds, O_CLOEXEC) == 0;
 }
 
 int Shell::execute_process(std::vector<std::string> const& argv)
@@ -7,14 +7,31 @@
 #pragma once
 
 #include "AST.h"
+#include "Arithmetic.h"
+#include "Autoparallel.h"
+#include "Completion.h"
+#include "FileDescription.h"
+#include "Glob.h"
+#include "History.h"
+#include "Profiler.h"
+#include "Statistics.h"
 #include "Value.h"
+#include "Variables.h"
+#include "WorkingDirectory.h"
+#include <chrono>
 #include <memory>
 #include <optional>
+#include <span>
 #include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace RatShell {
 
+class Expander;
+
 class Shell {
 public:
     enum class Error {
@@ -22,19 +39,216 @@ public:
         SyntaxError
     };
 
+    // Function bodies by name, kept in the lowered form they were defined with.
+    using Functions = std::unordered_map<std::string, std::shared_ptr<CommandValue>>;
+
+    // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/V3_chap02.html#set
+    struct Options {
+        bool globstar { false };
+        bool noglob { false };
+        bool profile { false };
+        // Lets the commands of a list whose effects don't overlap run at the same time,
+        // at most autoparallel_jobs at once, where 0 means one per processor.
+        bool autoparallel { false };
+        unsigned autoparallel_jobs { 0 };
+        // Splits the arguments of a utility that wouldn't fit in ARG_MAX over several
+        // runs of it, at most argbatch_jobs at once.
+        bool argbatch { false };
+        unsigned argbatch_jobs { 1 };
+        // The capacity of the pipes between the commands of a pipeline, where 0 leaves
+        // them at the kernel's default.
+        size_t pipe_size { 0 };
+    };
+
+    Shell();
+    ~Shell();
+
     int run_single_line(std::string_view input);
+    // Runs a whole script or command string, whose final command may replace the shell
+    // process. Nothing may be left to do afterwards but exit with the returned status.
+    int run_script(std::string_view input);
+
+    // Runs the given input and returns its output with trailing newlines removed.
+    std::string run_command_substitution(std::string_view input);
 
     void print_error(std::string const& message, Error);
 
+    Options& options() { return m_options; }
+    Glob& glob() { return m_glob; }
+    ArithmeticCache& arithmetic_cache() { return m_arithmetic_cache; }
+    Completion& completion() { return m_completion; }
+    // The history of an interactive shell, if its file could be opened.
+    std::optional<History>& history() { return m_history; }
+    // Opens $HISTFILE, or ~/.ratsh_history, keeping as many entries as $HISTSIZE says.
+    void open_history();
+    Profiler& profiler() { return m_profiler; }
+    Statistics& statistics() { return m_statistics; }
+    Variables& variables() { return m_variables; }
+
+    WorkingDirectory const& working_directory() const { return m_working_directory; }
+    // Enters the directory and updates PWD and OLDPWD, returning the directory that was
+    // left, or nothing if the directory couldn't be entered.
+    std::optional<WorkingDirectory> change_directory(WorkingDirectory&&);
+    // The directories saved by pushd, the most recent last.
+    std::vector<WorkingDirectory>& directory_stack() { return m_directory_stack; }
+
+    // The $0 parameter, and the ones after it.
+    std::string const& name() const { return m_name; }
+    void set_name(std::string name) { m_name = std::move(name); }
+    std::vector<std::string>& positional_parameters() { return m_positional_parameters; }
+
+    Functions const& functions() const { return m_functions; }
+    void define_function(std::string const& name, std::shared_ptr<CommandValue> body);
+    void unset_function(std::string const& name);
+
+    // Starts the command the fields make up, the way a simple command would be run but
+    // always in a child, which leads a process group of its own. Returns its pid, or -1.
+    pid_t start_command(std::vector<std::string> fields);
+    // Waits for a child, returning its wait status.
+    int wait_for_child(pid_t);
+
+    // Whether the shell reads its commands from a terminal, which keeps it going after an
+    // error a non-interactive shell would exit on.
+    bool is_interactive() const { return m_is_interactive; }
+    void set_interactive(bool is_interactive) { m_is_interactive = is_interactive; }
+
+    int last_exit_status() const { return m_last_exit_status; }
+    pid_t pid() const { return m_pid; }
+
+    // Makes the shell stop running commands, e.g. because of the exit builtin.
+    void request_exit(int code) { m_exit_code = code; }
+    bool should_exit() const { return m_exit_code.has_value(); }
+    int exit_code() const { return m_exit_code.value_or(m_last_exit_status); }
+
+    // The number of loops the currently running command is nested in.
+    unsigned loop_depth() const { return m_loop_depth; }
+    // Makes the shell leave the given number of enclosing loops, or skip to the next
+    // iteration of the last of them.
+    void request_break(unsigned levels) { m_pending_breaks = levels; }
+    void request_continue(unsigned levels) { m_pending_continues = levels; }
+
+    // The number of function calls the currently running command is nested in.
+    unsigned function_depth() const { return m_function_depth; }
+    // Makes the shell return from the function that's running.
+    void request_return(int code)
+    {
+        m_return_code = code;
+        m_pending_return = true;
+    }
+
 private:
-    std::shared_ptr<AST::Node> parse(std::string_view) const;
+    enum class LaunchMode {
+        Fork,
+        // There is nothing left for this process to do afterwards, so the utility may
+        // replace it.
+        Replace
+    };
+
+    // The state a subshell may change, so that it can run without forking.
+    struct Snapshot {
+        WorkingDirectory working_directory;
+        Variables variables;
+        Options options;
+        std::vector<std::string> positional_parameters;
+        Functions functions;
+    };
 
+    std::shared_ptr<AST::Node> parse(std::string_view);
+    pid_t fork_shell();
+    bool open_pipe(int fds[2]);
+    // Starts the list of a process substitution on one end of a pipe, and returns the
+    // shell's end, or -1. It's closed and the list waited for once the saved descriptions
+    // are restored.
+    int start_process_substitution(ProcessSubstitutionValue const&, SavedFileDescriptions&);
+
+    // Whether the shell has to outlive its final command, because there's something left
+    // for it to do at exit. There are no traps yet, but an EXIT trap will need this too.
+    bool has_work_at_exit() const { return m_statistics.report_at_exit().has_value() || m_options.profile || !m_profiler.is_empty(); }
+
+    int run_value(std::shared_ptr<Value> const&, LaunchMode = LaunchMode::Fork);
+    [[noreturn]] void run_and_exit(std::shared_ptr<Value> const&);
+    [[noreturn]] void run_stage_and_exit(CommandValue const&);
+    int run_list(ListValue const&, LaunchMode = LaunchMode::Fork);
+    // Runs the items up to the first one that has to run on its own, at the same time as
+    // far as their effects allow, and returns how many ran. Nothing runs unless at least
+    // two items can go together.
+    size_t run_in_parallel(std::span<std::shared_ptr<Value> const> items, int& rc);
+    // What the command reads and writes, as far as its redirections tell. Unless its input
+    // is redirected, it reads the shell's input, which counts as a write when reading it
+    // leaves less for the others. The paths it opens are expanded with the given expander.
+    CommandEffects effects_of(CommandValue const&, Expander&, bool is_input_consumed);
     int run_command(std::shared_ptr<CommandValue> const&);
-    int run_command(std::vector<std::string> const& argv, std::vector<std::shared_ptr<RedirectionValue>> const& redirections);
-    int run_commands(std::vector<std::shared_ptr<CommandValue>> const& commands);
-    std::optional<int> run_builtin(std::vector<std::string> const& argv);
+    int run_pipeline(std::shared_ptr<CommandValue> const&);
+    int run_stage(CommandValue const&);
+    int run_simple_command(CommandValue const&, LaunchMode = LaunchMode::Fork);
+
+    // A simple command once its words are expanded.
+    struct ExpandedCommand {
+        std::vector<std::string> fields;
+        std::vector<std::pair<std::string, std::string>> assignments;
+        // The fields argbatch splits up, should they not fit in ARG_MAX.
+        size_t first_batched { 0 };
+        size_t end_batched { 0 };
+    };
+    // Runs the special builtin, function, builtin or utility the first field names, in
+    // that order, with the redirections already in place. Its launch latency counts from
+    // the given start.
+    int run_expanded_command(ExpandedCommand&&, SavedFileDescriptions&, LaunchMode, std::chrono::steady_clock::time_point start);
+    // Runs the utility once for each batch of the fields from first_batched up to
+    // end_batched that fits in ARG_MAX, with the other fields around every batch, and
+    // returns the status as xargs would. Returns nothing if everything fits at once.
+    std::optional<int> run_in_batches(std::vector<std::string> const& fields, size_t first_batched, size_t end_batched, std::vector<std::pair<std::string, std::string>> const& assignments);
+    int run_subshell(SubshellValue&, std::vector<std::shared_ptr<RedirectionValue>> const& redirections);
+    int run_compound_command(CommandValue const&);
+    int run_for_loop(ForLoopValue const&);
+    int run_while_loop(WhileLoopValue const&);
+    int run_function(CommandValue const& body, std::vector<std::string>&& argv);
+    int run_commands(std::vector<std::shared_ptr<CommandValue>> const& commands, LaunchMode = LaunchMode::Fork);
+
+    // Whether the remaining commands are being skipped because of exit, break, continue or
+    // return.
+    bool is_unwinding() const { return should_exit() || m_pending_breaks > 0 || m_pending_continues > 0 || m_pending_return; }
+    bool should_stop_loop();
+
+    std::optional<Snapshot> take_snapshot();
+    void restore_snapshot(Snapshot&&);
+
+    // Gives up on a command whose expansions failed, or a special builtin whose
+    // redirections failed, which also ends a non-interactive shell, and returns its status.
+    int fail_command();
 
+    bool apply_redirections(std::vector<std::shared_ptr<RedirectionValue>> const& redirections, SavedFileDescriptions& saved_fds);
     int execute_process(std::vector<std::string> const& argv);
+
+    Options m_options;
+    Glob m_glob;
+    ArithmeticCache m_arithmetic_cache;
+    Completion m_completion;
+    std::optional<History> m_history;
+    Profiler m_profiler;
+    Statistics m_statistics;
+    Variables m_variables;
+    WorkingDirectory m_working_directory;
+    std::vector<WorkingDirectory> m_directory_stack;
+    std::string m_name { "ratsh" };
+    std::vector<std::string> m_positional_parameters;
+    Functions m_functions;
+    // Bumped whenever a function changes, which may make a subshell unsafe to run without
+    // forking.
+    unsigned m_function_generation { 0 };
+
+    pid_t m_pid { -1 };
+    bool m_is_interactive { false };
+    int m_last_exit_status { 0 };
+    int m_last_substitution_status { 0 };
+    std::optional<int> m_exit_code;
+
+    unsigned m_loop_depth { 0 };
+    unsigned m_pending_breaks { 0 };
+    unsigned m_pending_continues { 0 };
+    unsigned m_function_depth { 0 };
+    int m_return_code { 0 };
+    bool m_pending_return { false };
 };
 
 } // namespace RatShell
\ No newline at end of file
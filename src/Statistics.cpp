@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Statistics.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace RatShell {
+
+namespace {
+
+constexpr std::pair<std::string_view, double> reported_percentiles[] = {
+    { "p50", 50.0 },
+    { "p90", 90.0 },
+    { "p99", 99.0 },
+    { "p99.9", 99.9 },
+};
+
+void append_text(std::string& out, std::string_view name, LatencyHistogram const& histogram)
+{
+    char label[32];
+    std::snprintf(label, sizeof(label), "%-18s", std::string { name }.c_str());
+    out += label;
+    out += "count " + std::to_string(histogram.count());
+    if (histogram.count() > 0) {
+        out += ", min " + format_duration(histogram.min());
+        out += ", mean " + format_duration(histogram.mean());
+        for (auto const& [percentile_name, percentile] : reported_percentiles) {
+            out += ", ";
+            out += percentile_name;
+            out += " " + format_duration(histogram.percentile(percentile));
+        }
+        out += ", max " + format_duration(histogram.max());
+    }
+    out += "\n";
+}
+
+void append_json(std::string& out, std::string_view name, LatencyHistogram const& histogram)
+{
+    out += "\"";
+    out += name;
+    out += "\":{\"count\":" + std::to_string(histogram.count());
+    out += ",\"min\":" + std::to_string(histogram.min());
+    out += ",\"mean\":" + std::to_string(histogram.mean());
+    for (auto const& [percentile_name, percentile] : reported_percentiles) {
+        out += ",\"";
+        out += percentile_name;
+        out += "\":" + std::to_string(histogram.percentile(percentile));
+    }
+    out += ",\"max\":" + std::to_string(histogram.max()) + "}";
+}
+
+} // namespace
+
+std::string format_duration(uint64_t nanoseconds)
+{
+    char buffer[32];
+    if (nanoseconds < 1000)
+        std::snprintf(buffer, sizeof(buffer), "%lluns", static_cast<unsigned long long>(nanoseconds));
+    else if (nanoseconds < 1000 * 1000)
+        std::snprintf(buffer, sizeof(buffer), "%.1fus", nanoseconds / 1e3);
+    else if (nanoseconds < 1000 * 1000 * 1000)
+        std::snprintf(buffer, sizeof(buffer), "%.1fms", nanoseconds / 1e6);
+    else
+        std::snprintf(buffer, sizeof(buffer), "%.2fs", nanoseconds / 1e9);
+    return buffer;
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+    auto value = static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(duration.count(), 0));
+
+    m_counts[bucket_of(value)]++;
+    m_count++;
+    m_total += value;
+    m_min = std::min(m_min, value);
+    m_max = std::max(m_max, value);
+}
+
+void LatencyHistogram::reset()
+{
+    *this = {};
+}
+
+uint64_t LatencyHistogram::percentile(double percentage) const
+{
+    if (m_count == 0)
+        return 0;
+
+    auto wanted = static_cast<uint64_t>(std::ceil(std::clamp(percentage, 0.0, 100.0) / 100.0 * m_count));
+    wanted = std::max<uint64_t>(wanted, 1);
+
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < bucket_count; bucket++) {
+        seen += m_counts[bucket];
+        if (seen >= wanted)
+            return std::min(highest_value_in(bucket), m_max);
+    }
+    return m_max;
+}
+
+// Values below sub_bucket_count each get a bucket of their own. Above that, the range
+// [2^k, 2^(k+1)) is split into sub_bucket_count buckets of 2^(k - sub_bucket_bits) values.
+size_t LatencyHistogram::bucket_of(uint64_t value)
+{
+    if (value < sub_bucket_count)
+        return value;
+
+    auto magnitude = static_cast<unsigned>(std::bit_width(value)) - 1;
+    auto shift = magnitude - sub_bucket_bits;
+    auto sub_bucket = (value >> shift) - sub_bucket_count;
+    return sub_bucket_count + shift * sub_bucket_count + sub_bucket;
+}
+
+uint64_t LatencyHistogram::highest_value_in(size_t bucket)
+{
+    if (bucket < sub_bucket_count)
+        return bucket;
+
+    auto shift = (bucket - sub_bucket_count) / sub_bucket_count;
+    auto sub_bucket = (bucket - sub_bucket_count) % sub_bucket_count;
+    auto lowest = (sub_bucket_count + sub_bucket) << shift;
+    return lowest + ((uint64_t { 1 } << shift) - 1);
+}
+
+std::string_view Statistics::name_of(Counter counter)
+{
+    switch (counter) {
+    case Counter::Forks:
+        return "forks";
+    case Counter::Execs:
+        return "execs";
+    case Counter::Builtins:
+        return "builtins";
+    case Counter::Redirections:
+        return "redirections";
+    case Counter::Pipes:
+        return "pipes";
+    case Counter::ParseCacheHits:
+        return "parse_cache_hits";
+    case Counter::BytesLexed:
+        return "bytes_lexed";
+    case Counter::Count:
+        break;
+    }
+    return "unknown";
+}
+
+std::string Statistics::report(Format format) const
+{
+    std::string out;
+
+    if (format == Format::Json) {
+        out += "{\"counters\":{";
+        for (size_t i = 0; i < m_counters.size(); i++) {
+            if (i > 0)
+                out += ",";
+            out += "\"";
+            out += name_of(static_cast<Counter>(i));
+            out += "\":" + std::to_string(m_counters[i]);
+        }
+        out += "},";
+        append_json(out, "parse_latency_ns", m_parse_latency);
+        out += ",";
+        append_json(out, "launch_latency_ns", m_launch_latency);
+        out += "}\n";
+        return out;
+    }
+
+    for (size_t i = 0; i < m_counters.size(); i++) {
+        char line[64];
+        std::snprintf(line, sizeof(line), "%-18s%llu\n", std::string { name_of(static_cast<Counter>(i)) }.c_str(), static_cast<unsigned long long>(m_counters[i]));
+        out += line;
+    }
+    append_text(out, "parse_latency", m_parse_latency);
+    append_text(out, "launch_latency", m_launch_latency);
+    return out;
+}
+
+void Statistics::reset()
+{
+    m_counters = {};
+    m_parse_latency.reset();
+    m_launch_latency.reset();
+}
+
+} // namespace RatShell
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace RatShell {
+
+// Formats a duration with a unit that keeps it short, e.g. "1.5ms".
+std::string format_duration(uint64_t nanoseconds);
+
+// A histogram of durations in the manner of HdrHistogram: every power of two is split
+// into the same number of linear buckets, so each value is kept to within about 6% in a
+// fixed amount of memory, and recording one is a few instructions.
+class LatencyHistogram {
+public:
+    void record(std::chrono::nanoseconds);
+    void reset();
+
+    uint64_t count() const { return m_count; }
+    uint64_t min() const { return m_count > 0 ? m_min : 0; }
+    uint64_t max() const { return m_max; }
+    uint64_t mean() const { return m_count > 0 ? m_total / m_count : 0; }
+
+    // The smallest value, in nanoseconds, that the given percentage of recorded values
+    // are no greater than.
+    uint64_t percentile(double) const;
+
+private:
+    static constexpr unsigned sub_bucket_bits = 4;
+    static constexpr size_t sub_bucket_count = size_t { 1 } << sub_bucket_bits;
+    static constexpr size_t bucket_count = sub_bucket_count + (64 - sub_bucket_bits) * sub_bucket_count;
+
+    static size_t bucket_of(uint64_t value);
+    static uint64_t highest_value_in(size_t bucket);
+
+    std::array<uint64_t, bucket_count> m_counts {};
+    uint64_t m_count { 0 };
+    uint64_t m_total { 0 };
+    uint64_t m_min { UINT64_MAX };
+    uint64_t m_max { 0 };
+};
+
+// How much work the shell itself has done. Only this process is counted, so the work
+// done by forked subshells and pipeline stages is left out.
+class Statistics {
+public:
+    enum class Counter {
+        Forks,
+        Execs,
+        Builtins,
+        Redirections,
+        Pipes,
+        ParseCacheHits,
+        BytesLexed,
+        Count,
+    };
+
+    enum class Format {
+        Text,
+        Json,
+    };
+
+    void increment(Counter counter, uint64_t amount = 1) { m_counters[static_cast<size_t>(counter)] += amount; }
+    uint64_t get(Counter counter) const { return m_counters[static_cast<size_t>(counter)]; }
+
+    // From the start of parsing a line to the end of it.
+    LatencyHistogram& parse_latency() { return m_parse_latency; }
+    // From the start of running a simple command to fork(2) returning in the shell.
+    LatencyHistogram& launch_latency() { return m_launch_latency; }
+
+    std::string report(Format) const;
+    void reset();
+
+    // Where the report is written when the shell exits, if anywhere.
+    std::optional<Format> const& report_at_exit() const { return m_report_at_exit; }
+    void set_report_at_exit(std::optional<Format> format) { m_report_at_exit = format; }
+
+    static std::string_view name_of(Counter);
+
+private:
+    std::array<uint64_t, static_cast<size_t>(Counter::Count)> m_counters {};
+    LatencyHistogram m_parse_latency;
+    LatencyHistogram m_launch_latency;
+    std::optional<Format> m_report_at_exit;
+};
+
+} // namespace RatShell
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "SyntaxCheck.h"
+#include "AST.h"
+#include "Parser.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+// What's to be written after the file's name, either ":line: message" for a syntax error
+// or ": message" if it couldn't be read, if there's anything wrong with it.
+std::optional<std::string> check_file(char const* path)
+{
+    auto fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return std::string { ": cannot open file: " } + strerror(errno);
+
+    struct stat st {};
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return ": not a regular file";
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return std::nullopt;
+    }
+
+    // The lexer works on a view of the input, so it can read the mapping in place
+    // without the file ever being copied.
+    auto size = static_cast<size_t>(st.st_size);
+    auto* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return std::string { ": cannot map file: " } + strerror(errno);
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    auto error = check_syntax({ static_cast<char const*>(data), size });
+    munmap(data, size);
+    if (error.has_value())
+        return ":" + error.value();
+    return std::nullopt;
+}
+
+} // namespace
+
+std::optional<std::string> check_syntax(std::string_view script)
+{
+    Parser parser { script };
+    auto node = parser.parse();
+    if (!node || !node->is_syntax_error())
+        return std::nullopt;
+
+    auto const& error = static_cast<AST::SyntaxError const&>(*node);
+    return std::to_string(error.line()) + ": " + error.error_message();
+}
+
+int check_syntax_of_files(std::span<char const* const> paths, size_t thread_count)
+{
+    std::vector<std::optional<std::string>> errors(paths.size());
+
+    // Rather than a task per file, every thread takes the next file as it finishes one,
+    // which keeps the pool's lock out of the way of tens of thousands of small files.
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    thread_count = std::clamp<size_t>(paths.size(), 1, thread_count);
+
+    {
+        ThreadPool pool { thread_count };
+        std::atomic<size_t> next_path { 0 };
+        for (size_t i = 0; i < pool.thread_count(); i++) {
+            pool.enqueue([&] {
+                for (auto index = next_path++; index < paths.size(); index = next_path++)
+                    errors[index] = check_file(paths[index]);
+            });
+        }
+        pool.wait();
+    }
+
+    int rc = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (!errors[i].has_value())
+            continue;
+        std::cerr << paths[i] << errors[i].value() << "\n";
+        rc = 1;
+    }
+    return rc;
+}
+
+} // namespace RatShell
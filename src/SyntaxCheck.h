@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace RatShell {
+
+// https://pubs.opengroup.org/onlinepubs/9699919799/utilities/set.html (-n)
+// Lexes and parses a script without running it, returning "line: message" for the first
+// syntax error, if there is one.
+std::optional<std::string> check_syntax(std::string_view script);
+
+// Checks the files across a pool of thread_count threads, or one per processor if 0, and
+// writes "file:line: message" for each error in the order the files were given. Returns
+// 0 if every file could be read and had no errors, or 1.
+int check_syntax_of_files(std::span<char const* const> paths, size_t thread_count);
+
+} // namespace RatShell
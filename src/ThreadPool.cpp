@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace RatShell {
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    if (thread_count == 0)
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    m_threads.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+        m_threads.emplace_back([this] { run_worker(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_stopping = true;
+    }
+    m_task_available.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard lock { m_mutex };
+        m_tasks.push_back(std::move(task));
+    }
+    m_task_available.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock lock { m_mutex };
+    m_idle.wait(lock, [this] { return m_tasks.empty() && m_busy_workers == 0; });
+}
+
+void ThreadPool::run_worker()
+{
+    while (true) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock lock { m_mutex };
+            m_task_available.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+            if (m_stopping && m_tasks.empty())
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            m_busy_workers++;
+        }
+
+        task();
+
+        {
+            std::lock_guard lock { m_mutex };
+            m_busy_workers--;
+            if (m_tasks.empty() && m_busy_workers == 0)
+                m_idle.notify_all();
+        }
+    }
+}
+
+} // namespace RatShell
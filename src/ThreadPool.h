@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RatShell {
+
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    /// NOTE: Tasks may enqueue further tasks, wait() accounts for them as well.
+    void enqueue(std::function<void()> task);
+
+    // Blocks until every enqueued task has finished running.
+    void wait();
+
+    size_t thread_count() const { return m_threads.size(); }
+
+private:
+    void run_worker();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_task_available;
+    std::condition_variable m_idle;
+    size_t m_busy_workers { 0 };
+    bool m_stopping { false };
+};
+
+} // namespace RatShell
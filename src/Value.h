@@ -7,7 +7,9 @@
 #pragma once
 
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -17,6 +19,28 @@ struct Value {
     virtual bool is_command() const { return false; }
     virtual bool is_redirection() const { return false; }
     virtual bool is_and_or_list() const { return false; }
+    virtual bool is_list() const { return false; }
+    virtual bool is_subshell() const { return false; }
+    virtual bool is_for_loop() const { return false; }
+    virtual bool is_while_loop() const { return false; }
+    virtual bool is_brace_group() const { return false; }
+    virtual bool is_function_definition() const { return false; }
+    virtual bool is_process_substitution() const { return false; }
+};
+
+// https://www.gnu.org/software/bash/manual/html_node/Process-Substitution.html
+struct ProcessSubstitutionValue final : public Value {
+    enum class Direction {
+        // "<(list)": the list's output is read from the pipe.
+        Input,
+        // ">(list)": the list reads what is written to the pipe.
+        Output
+    };
+
+    Direction direction { Direction::Input };
+    std::shared_ptr<Value> body;
+
+    virtual bool is_process_substitution() const override { return true; }
 };
 
 struct RedirectionValue final : public Value {
@@ -30,6 +54,8 @@ struct RedirectionValue final : public Value {
     struct PathData {
         std::string path;
         int flags { -1 };
+        // Takes the place of the path for e.g. "< <(list)".
+        std::shared_ptr<ProcessSubstitutionValue> process_substitution;
     };
 
     int io_number { -1 };
@@ -64,10 +90,27 @@ struct CommandValue final : public Value {
         OrIf
     };
 
+    std::vector<std::string> assignments;
     std::vector<std::string> argv;
     std::vector<std::shared_ptr<RedirectionValue>> redirections;
+    // The process substitutions among the words of argv, by position, whose words are
+    // replaced by the path of their pipe before expansion.
+    std::vector<std::pair<size_t, std::shared_ptr<ProcessSubstitutionValue>>> process_substitutions;
+    // Set when this is a compound command, which is run in place of argv.
+    std::shared_ptr<Value> compound;
     std::shared_ptr<CommandValue> next_in_pipeline;
     WithOp op { WithOp::None };
+    // Where the command starts in the source, counting from 1, or 0 if it isn't known.
+    size_t line { 0 };
+
+    // The stages after this one are let go of one at a time, as destroying them
+    // recursively would take a stack frame for every stage of a long pipeline.
+    ~CommandValue()
+    {
+        auto next = std::move(next_in_pipeline);
+        while (next && next.use_count() == 1)
+            next = std::move(next->next_in_pipeline);
+    }
 
     virtual bool is_command() const override { return true; }
 };
@@ -78,4 +121,52 @@ struct AndOrListValue final : public Value {
     virtual bool is_and_or_list() const override { return true; }
 };
 
+struct ListValue final : public Value {
+    std::vector<std::shared_ptr<Value>> items;
+
+    virtual bool is_list() const override { return true; }
+};
+
+struct SubshellValue final : public Value {
+    std::shared_ptr<Value> body;
+    // Whether the body can run without a fork, worked out the first time it runs and
+    // again only if functions have changed since.
+    std::optional<bool> can_run_in_process;
+    unsigned function_generation { 0 };
+
+    virtual bool is_subshell() const override { return true; }
+};
+
+struct ForLoopValue final : public Value {
+    std::string name;
+    // Without an "in" clause, the loop goes over the positional parameters.
+    std::optional<std::vector<std::string>> words;
+    std::shared_ptr<Value> body;
+
+    virtual bool is_for_loop() const override { return true; }
+};
+
+struct WhileLoopValue final : public Value {
+    std::shared_ptr<Value> condition;
+    std::shared_ptr<Value> body;
+    // An until loop runs for as long as its condition fails instead.
+    bool is_until { false };
+
+    virtual bool is_while_loop() const override { return true; }
+};
+
+struct BraceGroupValue final : public Value {
+    std::shared_ptr<Value> body;
+
+    virtual bool is_brace_group() const override { return true; }
+};
+
+struct FunctionDefinitionValue final : public Value {
+    std::string name;
+    // The compound command along with its redirections, lowered once when defined.
+    std::shared_ptr<CommandValue> body;
+
+    virtual bool is_function_definition() const override { return true; }
+};
+
 }; // namespace RatShell
\ No newline at end of file
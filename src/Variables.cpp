@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "Variables.h"
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace RatShell {
+
+Variables Variables::from_environment()
+{
+    Variables variables;
+
+    for (auto** entry = environ; *entry != nullptr; entry++) {
+        std::string_view definition { *entry };
+        auto equals = definition.find('=');
+        if (equals == std::string_view::npos)
+            continue;
+
+        auto name = std::string { definition.substr(0, equals) };
+        if (!is_valid_name(name))
+            continue;
+
+        variables.m_variables[name] = Variable {
+            .value = std::string { definition.substr(equals + 1) },
+            .is_exported = true,
+        };
+    }
+
+    return variables;
+}
+
+bool Variables::is_valid_name(std::string_view name)
+{
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])) != 0)
+        return false;
+
+    for (auto ch : name) {
+        if (std::isalnum(static_cast<unsigned char>(ch)) == 0 && ch != '_')
+            return false;
+    }
+
+    return true;
+}
+
+Variables::Variable const* Variables::find(std::string const& name) const
+{
+    auto it = m_variables.find(name);
+    if (it == m_variables.end())
+        return nullptr;
+    return &it->second;
+}
+
+void Variables::set(std::string const& name, std::string value)
+{
+    auto& variable = m_variables[name];
+    variable.value = std::move(value);
+    variable.integer.reset();
+
+    if (variable.is_exported)
+        sync_environment(name, &variable);
+}
+
+void Variables::set_integer(std::string const& name, int64_t value)
+{
+    char buffer[24];
+    auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+
+    auto& variable = m_variables[name];
+    variable.value.assign(buffer, result.ptr);
+    variable.integer = value;
+
+    if (variable.is_exported)
+        sync_environment(name, &variable);
+}
+
+void Variables::unset(std::string const& name)
+{
+    auto it = m_variables.find(name);
+    if (it == m_variables.end())
+        return;
+
+    if (it->second.is_exported)
+        sync_environment(name, nullptr);
+    m_variables.erase(it);
+}
+
+void Variables::export_variable(std::string const& name)
+{
+    auto& variable = m_variables[name];
+    variable.is_exported = true;
+    sync_environment(name, &variable);
+}
+
+void Variables::restore(Variables&& snapshot)
+{
+    for (auto const& [name, variable] : m_variables) {
+        if (!variable.is_exported)
+            continue;
+
+        auto const* old_variable = snapshot.find(name);
+        if (old_variable == nullptr || !old_variable->is_exported)
+            sync_environment(name, nullptr);
+    }
+
+    for (auto const& [name, old_variable] : snapshot.m_variables) {
+        if (!old_variable.is_exported)
+            continue;
+
+        auto const* variable = find(name);
+        if (variable == nullptr || !variable->is_exported || variable->value != old_variable.value)
+            sync_environment(name, &old_variable);
+    }
+
+    m_variables = std::move(snapshot.m_variables);
+}
+
+void Variables::sync_environment(std::string const& name, Variable const* variable)
+{
+    if (variable == nullptr)
+        unsetenv(name.c_str());
+    else
+        setenv(name.c_str(), variable->value.c_str(), 1);
+}
+
+} // namespace RatShell
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace RatShell {
+
+// The shell's variables. Exported variables are mirrored into the process environment so
+// that utilities inherit them when they are executed.
+class Variables {
+public:
+    struct Variable {
+        std::string value;
+        bool is_exported { false };
+        // The value as an integer, once arithmetic expansion has had to work it out.
+        mutable std::optional<int64_t> integer {};
+    };
+
+    static Variables from_environment();
+
+    // https://pubs.opengroup.org/onlinepubs/9699919799/basedefs/V1_chap03.html#tag_03_235
+    static bool is_valid_name(std::string_view name);
+
+    Variable const* find(std::string const& name) const;
+    void set(std::string const& name, std::string value);
+    void set_integer(std::string const& name, int64_t value);
+    void unset(std::string const& name);
+    void export_variable(std::string const& name);
+
+    // Replaces every variable with those of an earlier copy, keeping the process
+    // environment in sync.
+    void restore(Variables&& snapshot);
+
+    std::unordered_map<std::string, Variable> const& all() const { return m_variables; }
+
+private:
+    void sync_environment(std::string const& name, Variable const*);
+
+    std::unordered_map<std::string, Variable> m_variables;
+};
+
+} // namespace RatShell
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "WorkingDirectory.h"
+#include "FileDescription.h"
+#include <climits>
+#include <fcntl.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+bool has_dot_components(std::string_view path)
+{
+    for (size_t start = 0; start < path.size();) {
+        auto end = path.find('/', start);
+        if (end == std::string_view::npos)
+            end = path.size();
+
+        auto component = path.substr(start, end - start);
+        if (component == "." || component == "..")
+            return true;
+        start = end + 1;
+    }
+    return false;
+}
+
+} // namespace
+
+WorkingDirectory::WorkingDirectory(WorkingDirectory&& other) noexcept
+    : m_path(std::move(other.m_path))
+    , m_fd(std::exchange(other.m_fd, -1))
+{
+}
+
+WorkingDirectory& WorkingDirectory::operator=(WorkingDirectory&& other) noexcept
+{
+    if (this != &other) {
+        if (m_fd >= 0)
+            close(m_fd);
+        m_path = std::move(other.m_path);
+        m_fd = std::exchange(other.m_fd, -1);
+    }
+    return *this;
+}
+
+WorkingDirectory::~WorkingDirectory()
+{
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+std::optional<WorkingDirectory> WorkingDirectory::current(std::optional<std::string_view> logical_path)
+{
+    auto fd = move_to_shell_range(::open(".", O_PATH | O_DIRECTORY | O_CLOEXEC));
+    if (fd < 0)
+        return std::nullopt;
+
+    // (2.5.3) PWD names the working directory if it is an absolute pathname with no dot
+    // components that leads to the same directory.
+    if (logical_path.has_value() && logical_path->starts_with('/') && !has_dot_components(logical_path.value())) {
+        struct stat current {};
+        struct stat logical {};
+        auto path = std::string { logical_path.value() };
+
+        if (fstat(fd, &current) == 0 && stat(path.c_str(), &logical) == 0 && current.st_dev == logical.st_dev && current.st_ino == logical.st_ino)
+            return WorkingDirectory { std::move(path), fd };
+    }
+
+    auto directory = WorkingDirectory { {}, fd };
+    auto path = directory.physical_path();
+    if (!path.has_value())
+        return std::nullopt;
+
+    directory.m_path = std::move(path.value());
+    return directory;
+}
+
+std::optional<WorkingDirectory> WorkingDirectory::open(std::string const& path, std::optional<std::string> logical_path) const
+{
+    auto fd = move_to_shell_range(openat(m_fd < 0 ? AT_FDCWD : m_fd, path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC));
+    if (fd < 0)
+        return std::nullopt;
+
+    auto directory = WorkingDirectory { {}, fd };
+    if (!logical_path.has_value()) {
+        logical_path = directory.physical_path();
+        if (!logical_path.has_value())
+            return std::nullopt;
+    }
+
+    directory.m_path = std::move(logical_path.value());
+    return directory;
+}
+
+std::optional<WorkingDirectory> WorkingDirectory::duplicate() const
+{
+    auto fd = fcntl(m_fd, F_DUPFD_CLOEXEC, min_shell_fd);
+    if (fd < 0)
+        return std::nullopt;
+
+    return WorkingDirectory { m_path, fd };
+}
+
+bool WorkingDirectory::enter() const
+{
+    return fchdir(m_fd) == 0;
+}
+
+std::optional<std::string> WorkingDirectory::physical_path() const
+{
+    // The kernel already knows the path of an open directory, so there's no need to walk
+    // up the tree like realpath(3) does.
+    auto link = "/proc/self/fd/" + std::to_string(m_fd);
+    std::string path(PATH_MAX, '\0');
+
+    auto length = readlink(link.c_str(), path.data(), path.size());
+    if (length <= 0 || static_cast<size_t>(length) == path.size() || path[0] != '/')
+        return std::nullopt;
+
+    path.resize(length);
+    return path;
+}
+
+std::string WorkingDirectory::canonicalize_lexically(std::string_view path)
+{
+    std::vector<std::string_view> components;
+
+    for (size_t start = 0; start <= path.size();) {
+        auto end = path.find('/', start);
+        if (end == std::string_view::npos)
+            end = path.size();
+
+        auto component = path.substr(start, end - start);
+        start = end + 1;
+
+        if (component.empty() || component == ".")
+            continue;
+        if (component == "..") {
+            if (!components.empty())
+                components.pop_back();
+            continue;
+        }
+        components.push_back(component);
+    }
+
+    if (components.empty())
+        return "/";
+
+    std::string result;
+    for (auto component : components) {
+        result += '/';
+        result += component;
+    }
+    return result;
+}
+
+} // namespace RatShell
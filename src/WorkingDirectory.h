@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace RatShell {
+
+// A directory the shell may work in: its logical pathname, as $PWD shows it, together
+// with an O_PATH descriptor for the directory itself. Going back to it is a fchdir(2)
+// away, and paths relative to it can be opened with openat(2) without walking the
+// logical pathname again.
+class WorkingDirectory {
+public:
+    WorkingDirectory() = default;
+    WorkingDirectory(WorkingDirectory&&) noexcept;
+    WorkingDirectory& operator=(WorkingDirectory&&) noexcept;
+    ~WorkingDirectory();
+
+    WorkingDirectory(WorkingDirectory const&) = delete;
+    WorkingDirectory& operator=(WorkingDirectory const&) = delete;
+
+    // The directory the process is in, which keeps the given logical pathname if it
+    // names that same directory.
+    static std::optional<WorkingDirectory> current(std::optional<std::string_view> logical_path);
+
+    // Opens a directory, where a relative path is taken relative to this one. The
+    // logical pathname is left as the caller says, since only it knows how it got there,
+    // and is the physical one if it says nothing.
+    std::optional<WorkingDirectory> open(std::string const& path, std::optional<std::string> logical_path) const;
+    std::optional<WorkingDirectory> duplicate() const;
+
+    // Makes this the working directory of the process.
+    bool enter() const;
+
+    std::string const& path() const { return m_path; }
+    int fd() const { return m_fd; }
+
+    // The pathname of the directory with no symbolic links, as the kernel knows it.
+    std::optional<std::string> physical_path() const;
+
+    // (cd, step 8) Removes dot components, and dot-dot components along with the one
+    // before them, from an absolute pathname without looking at the file system.
+    static std::string canonicalize_lexically(std::string_view path);
+
+private:
+    WorkingDirectory(std::string path, int fd)
+        : m_path(std::move(path))
+        , m_fd(fd)
+    {
+    }
+
+    std::string m_path;
+    int m_fd { -1 };
+};
+
+} // namespace RatShell
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2023, Kemal Zebari <kemalzebra@gmail.com>.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "ForkServer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <unistd.h>
+
+using namespace RatShell;
+
+// Stands in for "ratsh -c" in front of a fork server, whose socket is named by
+// RATSH_SERVER. Being small and linked on its own is what makes it start faster than the
+// shell would.
+int main(int argc, char** argv)
+{
+    if (argc < 3 || std::string_view { argv[1] } != "-c") {
+        dprintf(STDERR_FILENO, "usage: %s -c command_string [command_name [argument...]]\n", argv[0]);
+        return 2;
+    }
+
+    auto const* socket_path = getenv("RATSH_SERVER");
+    if (socket_path == nullptr || *socket_path == '\0') {
+        dprintf(STDERR_FILENO, "ratsh: RATSH_SERVER is not set\n");
+        return 127;
+    }
+
+    auto rc = run_fork_client(socket_path, { argv + 2, argv + argc });
+    if (!rc.has_value()) {
+        dprintf(STDERR_FILENO, "ratsh: %s: cannot reach the server\n", socket_path);
+        return 127;
+    }
+    return rc.value();
+}
@@ -4,31 +4,133 @@
  * SPDX-License-Identifier: BSD-2-Clause
  */
 
+#include "ForkServer.h"
 #include "Shell.h"
+#include "SyntaxCheck.h"
+#include <charconv>
+#include <clocale>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace RatShell;
 
-int main()
+namespace {
+
+// Runs a whole script at once, so that compound commands may span several lines.
+int run_script(Shell& shell, std::string input)
+{
+    input.push_back('\n');
+    return shell.run_script(input);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
 {
+    // Pathname expansion sorts according to the locale's collating sequence.
+    std::setlocale(LC_ALL, "");
+
+    // These come before anything else, as starting a shell is what the client saves.
+    if (argc > 1 && std::string_view { argv[1] } == "--server") {
+        if (argc != 3) {
+            std::cerr << "ratsh: --server: usage: ratsh --server socket\n";
+            return 2;
+        }
+        return run_fork_server(argv[2]);
+    }
+
+    // ratsh --client socket -c command_string [command_name [argument...]]
+    if (argc > 1 && std::string_view { argv[1] } == "--client") {
+        if (argc < 5 || std::string_view { argv[3] } != "-c") {
+            std::cerr << "ratsh: --client: usage: ratsh --client socket -c command_string [command_name [argument...]]\n";
+            return 2;
+        }
+        if (auto rc = run_fork_client(argv[2], { argv + 4, argv + argc }); rc.has_value())
+            return rc.value();
+
+        // Without a server, the command runs here, as "ratsh -c" would run it.
+        argv += 2;
+        argc -= 2;
+    }
+
+    // ratsh -n [-j jobs] file...
+    // Checks the files' syntax without running them, which needs no shell at all.
+    if (argc > 1 && std::string_view { argv[1] } == "-n") {
+        size_t jobs = 0;
+        int first_file = 2;
+        if (argc > 2 && std::string_view { argv[2] }.starts_with("-j")) {
+            std::string_view count = argv[2] + 2;
+            first_file = 3;
+            if (count.empty() && argc > 3)
+                count = argv[first_file++];
+            auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), jobs);
+            if (error != std::errc {} || end != count.data() + count.size() || jobs == 0) {
+                std::cerr << "ratsh: -j: number of jobs required\n";
+                return 2;
+            }
+        }
+        if (first_file == argc) {
+            std::cerr << "ratsh: -n: usage: ratsh -n [-j jobs] file...\n";
+            return 2;
+        }
+        return check_syntax_of_files({ argv + first_file, argv + argc }, jobs);
+    }
+
     auto shell = std::make_unique<Shell>();
+
+    // https://pubs.opengroup.org/onlinepubs/9699919799/utilities/sh.html
+    if (argc > 1 && std::string_view { argv[1] } == "-c") {
+        if (argc < 3) {
+            std::cerr << "ratsh: -c: option requires an argument\n";
+            return 2;
+        }
+
+        // sh -c command_string [command_name [argument...]]
+        if (argc > 3)
+            shell->set_name(argv[3]);
+        if (argc > 4)
+            shell->positional_parameters().assign(argv + 4, argv + argc);
+        return run_script(*shell, argv[2]);
+    }
+
+    if (argc > 1) {
+        std::ifstream file { argv[1] };
+        if (!file) {
+            std::cerr << "ratsh: " << argv[1] << ": cannot open file\n";
+            return 127;
+        }
+
+        shell->set_name(argv[1]);
+        shell->positional_parameters().assign(argv + 2, argv + argc);
+
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return run_script(*shell, std::move(contents).str());
+    }
+
     std::string input;
+    shell->set_interactive(true);
+    shell->open_history();
 
     while (true) {
         std::cerr << "ratsh> ";
         getline(std::cin, input);
-        if (input == "exit")
-            return 0;
 
         if (std::cin.fail()) {
             shell->print_error("unknown error", Shell::Error::General);
             return 1;
         }
+        if (auto& history = shell->history(); history.has_value())
+            history->append(input);
         input.push_back('\n'); // Add this so that newlines can be lexed.
         auto code = shell->run_single_line(input);
+        if (shell->should_exit())
+            return shell->exit_code();
 
         if (code != 0)
             shell->print_error("code " + std::to_string(code), Shell::Error::General);
@@ -0,0 +1,22 @@
+#include <BuiltinABI.h>
+
+// A shared object from some other version of the shell, which enable -f must refuse.
+
+namespace {
+
+int mismatched(ratsh_builtin_context const*, int, char const* const*)
+{
+    return 0;
+}
+
+ratsh_builtin const builtins[] = {
+    { .name = "mismatched", .function = mismatched },
+};
+
+} // namespace
+
+extern "C" ratsh_builtin_table const ratsh_builtins = {
+    .abi_version = RATSH_BUILTIN_ABI_VERSION + 1,
+    .count = 1,
+    .builtins = builtins,
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+namespace RatShell {
+
+// A directory for a test to make files in, which is removed along with them once it's
+// destroyed.
+class TemporaryDirectory {
+public:
+    // Creates /tmp/ratsh-<name>-XXXXXX, or leaves the path empty if it can't.
+    explicit TemporaryDirectory(std::string const& name)
+    {
+        auto path_template = "/tmp/ratsh-" + name + "-XXXXXX";
+        if (mkdtemp(path_template.data()) != nullptr)
+            m_path = path_template;
+    }
+
+    ~TemporaryDirectory()
+    {
+        if (!m_path.empty())
+            std::filesystem::remove_all(m_path);
+    }
+
+    TemporaryDirectory(TemporaryDirectory const&) = delete;
+    TemporaryDirectory& operator=(TemporaryDirectory const&) = delete;
+
+    std::filesystem::path const& path() const { return m_path; }
+
+private:
+    std::filesystem::path m_path;
+};
+
+} // namespace RatShell
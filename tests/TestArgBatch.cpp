@@ -0,0 +1,85 @@
+#include <ArgBatch.h>
+#include <csignal>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/wait.h>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+// Every one-letter field takes the same room: the letter, its terminator and a pointer.
+constexpr size_t letter_size = 2 + sizeof(char*);
+
+} // namespace
+
+TEST(ArgBatch, EverythingThatFitsRunsAtOnce)
+{
+    std::vector<std::string> fields { "cp", "a", "b", "c", "d", "dir" };
+    auto fixed_size = argument_size("cp") + argument_size("dir") + 2 * sizeof(char*) + 100;
+
+    EXPECT_EQ(std::nullopt, split_into_batches(fields, { 1, 5 }, 100, fixed_size + 4 * letter_size));
+}
+
+TEST(ArgBatch, BatchesTakeAsManyFieldsAsFit)
+{
+    std::vector<std::string> fields { "cp", "a", "b", "c", "d", "e", "dir" };
+    auto fixed_size = argument_size("cp") + argument_size("dir") + 2 * sizeof(char*) + 100;
+
+    auto batches = split_into_batches(fields, { 1, 6 }, 100, fixed_size + 2 * letter_size + 1);
+    ASSERT_TRUE(batches.has_value());
+    EXPECT_EQ((std::vector<ArgumentBatch> { { 1, 3 }, { 3, 5 }, { 5, 6 } }), batches.value());
+
+    // The fields that weren't batched go around every batch.
+    EXPECT_EQ((std::vector<std::string> { "cp", "a", "b", "dir" }), fields_for_batch(fields, { 1, 6 }, { 1, 3 }));
+    EXPECT_EQ((std::vector<std::string> { "cp", "e", "dir" }), fields_for_batch(fields, { 1, 6 }, { 5, 6 }));
+}
+
+TEST(ArgBatch, AFieldTooLargeOnItsOwnStillGetsABatch)
+{
+    std::vector<std::string> fields { "echo", "a", std::string(1000, 'x'), "b" };
+    auto fixed_size = argument_size("echo") + 2 * sizeof(char*);
+
+    auto batches = split_into_batches(fields, { 1, 4 }, 0, fixed_size + 2 * letter_size);
+    ASSERT_TRUE(batches.has_value());
+    EXPECT_EQ((std::vector<ArgumentBatch> { { 1, 2 }, { 2, 3 }, { 3, 4 } }), batches.value());
+
+    // Nothing fits next to the fixed fields, so every field goes on its own.
+    batches = split_into_batches(fields, { 1, 4 }, 0, fixed_size);
+    ASSERT_TRUE(batches.has_value());
+    EXPECT_EQ(3, batches->size());
+}
+
+TEST(ArgBatch, StatusIsWhatXargsWouldGive)
+{
+    BatchStatus status;
+    status.add(W_EXITCODE(0, 0));
+    EXPECT_EQ(0, status.exit_status());
+    EXPECT_FALSE(status.should_stop());
+
+    // An ordinary failure lets the others run, and later successes don't hide it.
+    status.add(W_EXITCODE(1, 0));
+    status.add(W_EXITCODE(0, 0));
+    EXPECT_EQ(123, status.exit_status());
+    EXPECT_FALSE(status.should_stop());
+
+    BatchStatus exited_with_255;
+    exited_with_255.add(W_EXITCODE(255, 0));
+    EXPECT_EQ(124, exited_with_255.exit_status());
+    EXPECT_TRUE(exited_with_255.should_stop());
+
+    BatchStatus killed;
+    killed.add(W_EXITCODE(0, SIGKILL));
+    EXPECT_EQ(125, killed.exit_status());
+    EXPECT_TRUE(killed.should_stop());
+
+    for (auto code : { 126, 127 }) {
+        BatchStatus cannot_run;
+        cannot_run.add(W_EXITCODE(code, 0));
+        EXPECT_EQ(code, cannot_run.exit_status());
+        EXPECT_TRUE(cannot_run.should_stop());
+    }
+}
+
+} // namespace RatShell
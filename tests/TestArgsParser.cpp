@@ -5,6 +5,7 @@
  */
 
 #include "ArgsParser.h"
+#include <array>
 #include <gtest/gtest.h>
 #include <string>
 #include <vector>
@@ -122,4 +123,87 @@ TEST_F(ArgsParserTest, AddStringOperandOptionalMissing)
 
     ASSERT_TRUE(parser.parse(argv));
     ASSERT_EQ("", file_path);
-}
\ No newline at end of file
+}
+
+TEST_F(ArgsParserTest, AddLongOptions)
+{
+    RatShell::ArgsParser parser;
+    std::vector<std::string> argv = { "prog", "--verbose", "--format=json", "--output", "out.txt", "operand" };
+    bool verbose = false;
+    std::string format;
+    std::string output;
+    std::string operand;
+
+    parser.add_option(verbose, "print more", "verbose", 0);
+    parser.add_option_argument(format, "choose file format", "format", 'f');
+    parser.add_option_argument(output, "choose output file", "output", 0);
+    parser.add_operand(operand, "an operand", "operand");
+
+    ASSERT_TRUE(parser.parse(argv));
+    ASSERT_TRUE(verbose);
+    ASSERT_EQ("json", format);
+    ASSERT_EQ("out.txt", output);
+    ASSERT_EQ("operand", operand);
+}
+
+namespace {
+
+enum TestOption {
+    All,
+    Long,
+    Width,
+};
+
+constexpr std::array<RatShell::OptionSpec, 3> test_options { {
+    { .short_name = 'a', .long_name = "all" },
+    { .short_name = 'l' },
+    { .short_name = 'w', .long_name = "width", .has_argument = true },
+} };
+
+} // namespace
+
+TEST(StaticArgsParserTest, GroupedShortOptions)
+{
+    std::vector<std::string> argv = { "ls", "-law80", "-a", "file" };
+    auto options = RatShell::parse_options<test_options>(argv);
+
+    ASSERT_TRUE(options.has_value());
+    ASSERT_EQ(3, options->first_operand);
+    ASSERT_EQ(4, (*options)[All].position);
+    ASSERT_EQ(1, (*options)[Long].position);
+    ASSERT_EQ("80", (*options)[Width].argument);
+}
+
+TEST(StaticArgsParserTest, OptionArgumentsAndDelimiters)
+{
+    std::vector<std::string> argv = { "ls", "-w", "-a", "--width=", "--", "-l" };
+    auto options = RatShell::parse_options<test_options>(argv);
+
+    ASSERT_TRUE(options.has_value());
+    ASSERT_EQ(5, options->first_operand);
+    ASSERT_FALSE((*options)[All].is_present());
+    ASSERT_FALSE((*options)[Long].is_present());
+    ASSERT_EQ("", (*options)[Width].argument);
+
+    // A lone "-" is an operand, and so is everything after the first operand.
+    argv = { "ls", "--all", "-", "-l" };
+    options = RatShell::parse_options<test_options>(argv);
+    ASSERT_TRUE(options.has_value());
+    ASSERT_EQ(2, options->first_operand);
+    ASSERT_TRUE((*options)[All].is_present());
+    ASSERT_FALSE((*options)[Long].is_present());
+}
+
+TEST(StaticArgsParserTest, InvalidOptions)
+{
+    for (auto argv : std::vector<std::vector<std::string>> {
+             { "ls", "-x" },
+             { "ls", "--long" },
+             { "ls", "--al" },
+             { "ls", "--all=yes" },
+             { "ls", "-aw" },
+             { "ls", "--width" },
+         }) {
+        ASSERT_FALSE(RatShell::parse_options<test_options>(argv).has_value()) << argv[1];
+    }
+}
@@ -0,0 +1,99 @@
+#include <Arithmetic.h>
+#include <Variables.h>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <optional>
+#include <string>
+
+namespace RatShell {
+
+namespace {
+
+std::optional<int64_t> evaluate(std::string_view expression, Variables& variables)
+{
+    std::string error;
+    auto compiled = ArithmeticExpression::compile(expression, error);
+    if (!compiled)
+        return std::nullopt;
+    return compiled->evaluate(variables, error);
+}
+
+std::optional<int64_t> evaluate(std::string_view expression)
+{
+    Variables variables;
+    return evaluate(expression, variables);
+}
+
+} // namespace
+
+TEST(Arithmetic, OperatorPrecedence)
+{
+    EXPECT_EQ(7, evaluate("1 + 2 * 3"));
+    EXPECT_EQ(9, evaluate("(1 + 2) * 3"));
+    EXPECT_EQ(-4, evaluate("1 - 2 - 3"));
+    EXPECT_EQ(1, evaluate("1 | 2 & 0"));
+    EXPECT_EQ(16, evaluate("1 << 2 + 2"));
+    EXPECT_EQ(1, evaluate("1 < 2 == 1"));
+    EXPECT_EQ(-1, evaluate("-7 % 3"));
+    EXPECT_EQ(0, evaluate("!5 || 0 && 1"));
+    EXPECT_EQ(3, evaluate("0 ? 1 : 1 ? 3 : 4"));
+    EXPECT_EQ(39, evaluate("0x1f + 010"));
+}
+
+TEST(Arithmetic, ConstantsAreFolded)
+{
+    std::string error;
+    auto compiled = ArithmeticExpression::compile("(1 + 2) * 3 - (4 > 2 ? 10 : 20)", error);
+    ASSERT_NE(nullptr, compiled);
+    ASSERT_TRUE(compiled->is_constant());
+
+    compiled = ArithmeticExpression::compile("x + 2 * 3", error);
+    ASSERT_NE(nullptr, compiled);
+    ASSERT_FALSE(compiled->is_constant());
+    ASSERT_EQ(3, compiled->code().size());
+
+    // Division by zero is left for evaluation to report.
+    compiled = ArithmeticExpression::compile("1 / 0", error);
+    ASSERT_NE(nullptr, compiled);
+    ASSERT_FALSE(compiled->is_constant());
+}
+
+TEST(Arithmetic, VariablesAreReadAndWritten)
+{
+    Variables variables;
+    variables.set("x", "5");
+
+    EXPECT_EQ(11, evaluate("x * 2 + unset_variable + 1", variables));
+    EXPECT_EQ(10, evaluate("x *= 2", variables));
+    EXPECT_EQ("10", variables.find("x")->value);
+    EXPECT_EQ(3, evaluate("y = z = 3", variables));
+    EXPECT_EQ("3", variables.find("y")->value);
+
+    // The right-hand side of a logical operator is only evaluated if needed.
+    EXPECT_EQ(1, evaluate("1 || (w = 1)", variables));
+    EXPECT_EQ(nullptr, variables.find("w"));
+
+    variables.set("x", "abc");
+    EXPECT_EQ(std::nullopt, evaluate("x + 1", variables));
+}
+
+TEST(Arithmetic, SignedIntegersWrapAround)
+{
+    EXPECT_EQ(INT64_MIN, evaluate("9223372036854775807 + 1"));
+    EXPECT_EQ(INT64_MIN, evaluate("(-9223372036854775807 - 1) / -1"));
+    EXPECT_EQ(0, evaluate("(-9223372036854775807 - 1) % -1"));
+}
+
+TEST(Arithmetic, ErrorsAreReported)
+{
+    for (auto const* expression : { "1 +", "(1", "1 2", "x = ", "09", "1 @ 2", "1 ? 2", "" }) {
+        std::string error;
+        EXPECT_EQ(nullptr, ArithmeticExpression::compile(expression, error)) << expression;
+        EXPECT_FALSE(error.empty()) << expression;
+    }
+
+    EXPECT_EQ(std::nullopt, evaluate("1 / 0"));
+    EXPECT_EQ(std::nullopt, evaluate("1 % (2 - 2)"));
+}
+
+} // namespace RatShell
@@ -0,0 +1,65 @@
+#include "TemporaryDirectory.h"
+#include <Autoparallel.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace RatShell {
+
+TEST(Autoparallel, CommandsWaitOnlyForWhatTheyConflictWith)
+{
+    std::vector<CommandEffects> commands {
+        { .reads = {}, .writes = { "/a" } },
+        { .reads = {}, .writes = { "/b" } },
+        { .reads = { "/a" }, .writes = { "/c" } },
+        { .reads = { "/a" }, .writes = { "/d" } },
+        { .reads = {}, .writes = { "/a" } },
+        { .reads = { "/b", "/c" }, .writes = {} },
+    };
+
+    auto dependencies = find_dependencies(commands);
+    ASSERT_EQ(6, dependencies.size());
+    EXPECT_TRUE(dependencies[0].empty());
+    EXPECT_TRUE(dependencies[1].empty());
+    EXPECT_EQ((std::vector<size_t> { 0 }), dependencies[2]);
+    EXPECT_EQ((std::vector<size_t> { 0 }), dependencies[3]);
+    // Writing /a again has to wait for the last write and for everyone reading it.
+    EXPECT_EQ((std::vector<size_t> { 0, 2, 3 }), dependencies[4]);
+    EXPECT_EQ((std::vector<size_t> { 1, 2 }), dependencies[5]);
+}
+
+TEST(Autoparallel, ReadersDontWaitForEachOther)
+{
+    std::vector<CommandEffects> commands {
+        { .reads = { "/input" }, .writes = { "/x" } },
+        { .reads = { "/input" }, .writes = { "/y" } },
+        { .reads = { "/input", "/input" }, .writes = { "/input" } },
+    };
+
+    auto dependencies = find_dependencies(commands);
+    EXPECT_TRUE(dependencies[1].empty());
+    EXPECT_EQ((std::vector<size_t> { 0, 1 }), dependencies[2]);
+}
+
+TEST(Autoparallel, FilesHaveOneKeyWhateverTheyreCalled)
+{
+    TemporaryDirectory temporary_directory { "autoparallel" };
+    auto const& directory = temporary_directory.path();
+    ASSERT_FALSE(directory.empty());
+    std::ofstream { directory / "file" } << "contents\n";
+    std::filesystem::create_symlink(directory / "file", directory / "link");
+
+    auto key = file_effect_key("file", directory.string());
+    ASSERT_TRUE(key.has_value());
+    EXPECT_EQ(key, file_effect_key((directory / "link").string(), "/"));
+    EXPECT_EQ(key, file_effect_key("./sub/../file", directory.string() + "/"));
+
+    // A file that doesn't exist yet goes by its absolute path.
+    EXPECT_EQ(directory / "new", file_effect_key("new", directory.string()));
+    EXPECT_FALSE(file_effect_key("/dev/null", "/").has_value());
+
+}
+
+} // namespace RatShell
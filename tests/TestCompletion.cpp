@@ -0,0 +1,121 @@
+#include "TemporaryDirectory.h"
+#include <Completion.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+class CompletionTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_FALSE(m_directory.path().empty());
+    }
+
+    std::filesystem::path const& directory() const { return m_directory.path(); }
+
+    void create_file(std::string const& name, bool is_executable)
+    {
+        std::ofstream { directory() / name } << "#!/bin/sh\n";
+        auto permissions = std::filesystem::perms::owner_read | std::filesystem::perms::owner_write;
+        if (is_executable)
+            permissions |= std::filesystem::perms::owner_exec;
+        std::filesystem::permissions(directory() / name, permissions);
+    }
+
+private:
+    TemporaryDirectory m_directory { "completion" };
+};
+
+} // namespace
+
+TEST(PrefixTrie, CollectsNamesInOrder)
+{
+    PrefixTrie trie;
+    for (auto const* name : { "git", "gcc", "g++", "grep", "gitk", "ls" })
+        trie.insert(name);
+
+    std::vector<std::string> names;
+    trie.collect("g", names, SIZE_MAX);
+    EXPECT_EQ((std::vector<std::string> { "g++", "gcc", "git", "gitk", "grep" }), names);
+
+    names.clear();
+    trie.collect("gi", names, 1);
+    EXPECT_EQ((std::vector<std::string> { "git" }), names);
+
+    names.clear();
+    trie.collect("x", names, SIZE_MAX);
+    EXPECT_TRUE(names.empty());
+    EXPECT_EQ(6, trie.size());
+}
+
+TEST(PrefixTrie, NamesAreCountedUntilEveryCopyIsErased)
+{
+    PrefixTrie trie;
+    trie.insert("python3");
+    trie.insert("python3");
+    trie.insert("python");
+
+    trie.erase("python3");
+    EXPECT_TRUE(trie.contains("python3"));
+    trie.erase("python3");
+    EXPECT_FALSE(trie.contains("python3"));
+    EXPECT_TRUE(trie.contains("python"));
+    EXPECT_FALSE(trie.contains("pyth"));
+
+    std::vector<std::string> names;
+    trie.collect("py", names, SIZE_MAX);
+    EXPECT_EQ((std::vector<std::string> { "python" }), names);
+    EXPECT_EQ(1, trie.size());
+}
+
+TEST_F(CompletionTest, CommandsFollowThePathDirectories)
+{
+    create_file("ratsh-tool", true);
+    create_file("ratsh-data", false);
+    std::filesystem::create_directory(directory() / "ratsh-dir");
+
+    Completion completion;
+    auto path = directory().string() + ":relative/bin";
+    completion.update(path);
+    EXPECT_EQ((std::vector<std::string> { "ratsh-tool" }), completion.complete_command("ratsh-"));
+    EXPECT_EQ((std::vector<std::string> { "echo" }), completion.complete_command("ech"));
+
+    // The changes come in through inotify, without another scan.
+    create_file("ratsh-new", true);
+    std::filesystem::permissions(directory() / "ratsh-tool", std::filesystem::perms::owner_read);
+    completion.update(path);
+    EXPECT_EQ((std::vector<std::string> { "ratsh-new" }), completion.complete_command("ratsh-"));
+
+    std::filesystem::rename(directory() / "ratsh-new", directory() / "ratsh-renamed");
+    completion.update(path);
+    EXPECT_EQ((std::vector<std::string> { "ratsh-renamed" }), completion.complete_command("ratsh-"));
+
+    std::filesystem::remove(directory() / "ratsh-renamed");
+    completion.update(path);
+    EXPECT_TRUE(completion.complete_command("ratsh-").empty());
+}
+
+TEST_F(CompletionTest, PathnamesMarkDirectoriesAndHideDotFiles)
+{
+    create_file("alpha.txt", false);
+    create_file("alps", false);
+    create_file(".alpine", false);
+    std::filesystem::create_directory(directory() / "albums");
+
+    Completion completion;
+    auto prefix = directory().string() + "/al";
+    EXPECT_EQ((std::vector<std::string> { prefix + "bums/", prefix + "pha.txt", prefix + "ps" }), completion.complete_pathname(prefix));
+    EXPECT_EQ((std::vector<std::string> { directory().string() + "/.alpine" }), completion.complete_pathname(directory().string() + "/.al"));
+
+    // A directory that changed is read again.
+    create_file("alpaca", false);
+    EXPECT_EQ(4, completion.complete_pathname(prefix).size());
+}
+
+} // namespace RatShell
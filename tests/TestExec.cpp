@@ -0,0 +1,111 @@
+#include "TemporaryDirectory.h"
+#include <Shell.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace RatShell {
+
+namespace {
+
+class ExecTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_FALSE(m_directory.path().empty());
+    }
+
+    std::string path(std::string const& name) const { return m_directory.path() / name; }
+
+    std::string read_file(std::string const& name) const
+    {
+        std::stringstream contents;
+        contents << std::ifstream { path(name) }.rdbuf();
+        return contents.str();
+    }
+
+    // Runs the script in a child, as the whole of a shell would, and returns the child's
+    // pid and exit status. The script can write its own pid with "echo $$", as the shell
+    // only knows its own.
+    std::pair<pid_t, int> run_script_in_child(std::string const& script, bool has_work_at_exit = false)
+    {
+        auto pid = fork();
+        if (pid == 0) {
+            Shell shell;
+            if (has_work_at_exit)
+                shell.statistics().set_report_at_exit(Statistics::Format::Text);
+            _exit(shell.run_script(script));
+        }
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        return { pid, WIFEXITED(status) ? WEXITSTATUS(status) : -1 };
+    }
+
+private:
+    TemporaryDirectory m_directory { "exec" };
+};
+
+} // namespace
+
+TEST_F(ExecTest, TheFinalCommandOfAScriptReplacesTheShell)
+{
+    auto [pid, status] = run_script_in_child("true; sh -c 'echo $$ > " + path("pid") + "; exit 3'\n");
+    EXPECT_EQ(3, status);
+    EXPECT_EQ(std::to_string(pid) + "\n", read_file("pid"));
+}
+
+TEST_F(ExecTest, WorkAtExitKeepsTheShellAround)
+{
+    auto [pid, status] = run_script_in_child("true; sh -c 'echo $$ > " + path("pid") + "; exit 3'\n", true);
+    EXPECT_EQ(3, status);
+    EXPECT_NE(std::to_string(pid) + "\n", read_file("pid"));
+    EXPECT_FALSE(read_file("pid").empty());
+}
+
+TEST_F(ExecTest, ExecReplacesTheShellAndSkipsTheRest)
+{
+    auto [pid, status] = run_script_in_child("exec sh -c 'echo $$ > " + path("pid") + "; exit 4'; echo after > " + path("after") + "\n");
+    EXPECT_EQ(4, status);
+    EXPECT_EQ(std::to_string(pid) + "\n", read_file("pid"));
+    EXPECT_FALSE(std::filesystem::exists(path("after")));
+}
+
+
+TEST_F(ExecTest, RedirectionsWithoutACommandPersist)
+{
+    auto [pid, status] = run_script_in_child("exec 3> " + path("out") + "; echo one >&3; echo two >&3\n");
+    EXPECT_EQ(0, status);
+    EXPECT_EQ("one\ntwo\n", read_file("out"));
+
+    // Once closed, writing to it fails like writing to any other descriptor that isn't open.
+    std::tie(pid, status) = run_script_in_child("exec 3> " + path("closed") + "; exec 3>&-; echo one >&3 || echo failed > " + path("status") + "\n");
+    EXPECT_EQ(0, status);
+    EXPECT_EQ("", read_file("closed"));
+    EXPECT_EQ("failed\n", read_file("status"));
+}
+
+TEST_F(ExecTest, ARedirectionErrorOnASpecialBuiltinEndsTheShell)
+{
+    auto [pid, status] = run_script_in_child("exec 9< " + path("nonexistent") + "; echo still > " + path("after") + "\n");
+    EXPECT_EQ(1, status);
+    EXPECT_FALSE(std::filesystem::exists(path("after")));
+
+    // Any other utility only fails.
+    std::tie(pid, status) = run_script_in_child("cat < " + path("nonexistent") + "; echo $? > " + path("after") + "\n");
+    EXPECT_EQ(0, status);
+    EXPECT_EQ("1\n", read_file("after"));
+
+    // And so does a special builtin in an interactive shell.
+    Shell shell;
+    shell.set_interactive(true);
+    EXPECT_EQ(1, shell.run_single_line("exec 9< " + path("nonexistent") + "\n"));
+    EXPECT_FALSE(shell.should_exit());
+}
+
+} // namespace RatShell
@@ -0,0 +1,187 @@
+#include "TemporaryDirectory.h"
+#include <FileCopy.h>
+#include <array>
+#include <csignal>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+class FileCopyTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_FALSE(m_directory.path().empty());
+    }
+
+    std::string path(std::string const& name) const { return m_directory.path() / name; }
+
+    std::string read_file(std::string const& name) const
+    {
+        std::stringstream contents;
+        contents << std::ifstream { path(name) }.rdbuf();
+        return contents.str();
+    }
+
+private:
+    TemporaryDirectory m_directory { "filecopy" };
+};
+
+// Longer than a pipe holds, and different at every offset that matters.
+std::string make_data(size_t size)
+{
+    std::string data;
+    data.reserve(size);
+    for (size_t i = 0; data.size() < size; i++)
+        data += std::to_string(i) + '\n';
+    data.resize(size);
+    return data;
+}
+
+// Reads whatever comes out of the pipe until all writers are gone, on another thread.
+std::thread drain(int fd, std::string& output)
+{
+    return std::thread([fd, &output] {
+        char buffer[4096];
+        ssize_t count;
+        while ((count = read(fd, buffer, sizeof(buffer))) > 0)
+            output.append(buffer, count);
+        close(fd);
+    });
+}
+
+std::thread feed(int fd, std::string const& data)
+{
+    return std::thread([fd, &data] {
+        EXPECT_EQ(data.size(), write(fd, data.data(), data.size()));
+        close(fd);
+    });
+}
+
+} // namespace
+
+TEST_F(FileCopyTest, CopiesBetweenFilesAndPipes)
+{
+    auto data = make_data(3'000'000);
+    std::ofstream { path("in") } << data;
+
+    auto in_fd = open(path("in").c_str(), O_RDONLY | O_CLOEXEC);
+    auto out_fd = open(path("out").c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    auto result = copy_data(in_fd, std::array { out_fd });
+    EXPECT_NE(CopyMethod::None, result.method);
+    EXPECT_EQ(0, result.read_error);
+    EXPECT_EQ(std::vector { 0 }, result.write_errors);
+    close(out_fd);
+    EXPECT_EQ(data, read_file("out"));
+
+    // From a file into a pipe, and from there into a file.
+    int pipe_fds[2];
+    ASSERT_EQ(0, pipe2(pipe_fds, O_CLOEXEC));
+    std::string piped;
+    auto reader = drain(pipe_fds[0], piped);
+    ASSERT_EQ(0, lseek(in_fd, 0, SEEK_SET));
+    result = copy_data(in_fd, std::array { pipe_fds[1] });
+    close(pipe_fds[1]);
+    reader.join();
+    close(in_fd);
+    EXPECT_EQ(CopyMethod::Splice, result.method);
+    EXPECT_EQ(data, piped);
+
+    ASSERT_EQ(0, pipe2(pipe_fds, O_CLOEXEC));
+    auto writer = feed(pipe_fds[1], data);
+    out_fd = open(path("out").c_str(), O_WRONLY | O_TRUNC | O_CLOEXEC);
+    result = copy_data(pipe_fds[0], std::array { out_fd });
+    writer.join();
+    close(pipe_fds[0]);
+    close(out_fd);
+    EXPECT_EQ(CopyMethod::Splice, result.method);
+    EXPECT_EQ(data, read_file("out"));
+}
+
+TEST_F(FileCopyTest, FansAPipeOutToEveryOutput)
+{
+    auto data = make_data(3'000'000);
+
+    int in_fds[2];
+    int out_pipe_fds[2];
+    ASSERT_EQ(0, pipe2(in_fds, O_CLOEXEC));
+    ASSERT_EQ(0, pipe2(out_pipe_fds, O_CLOEXEC));
+    auto first_fd = open(path("first").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+    // Appending can't be spliced to, so that one has to go through a buffer.
+    auto appended_fd = open(path("appended").c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0666);
+
+    std::string piped;
+    auto reader = drain(out_pipe_fds[0], piped);
+    auto writer = feed(in_fds[1], data);
+    auto result = copy_data(in_fds[0], std::array { first_fd, out_pipe_fds[1], appended_fd });
+    writer.join();
+    close(out_pipe_fds[1]);
+    reader.join();
+    close(in_fds[0]);
+    close(first_fd);
+    close(appended_fd);
+
+    EXPECT_EQ(CopyMethod::Tee, result.method);
+    EXPECT_EQ(0, result.read_error);
+    EXPECT_EQ((std::vector { 0, 0, 0 }), result.write_errors);
+    EXPECT_EQ(data, read_file("first"));
+    EXPECT_EQ(data, piped);
+    EXPECT_EQ(data, read_file("appended"));
+}
+
+TEST_F(FileCopyTest, OtherInputsAreReadIntoABuffer)
+{
+    auto data = make_data(500'000);
+
+    int socket_fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, socket_fds));
+    auto first_fd = open(path("first").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+    auto second_fd = open(path("second").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+
+    auto writer = feed(socket_fds[1], data);
+    auto result = copy_data(socket_fds[0], std::array { first_fd, second_fd });
+    writer.join();
+    close(socket_fds[0]);
+    close(first_fd);
+    close(second_fd);
+
+    EXPECT_EQ(CopyMethod::ReadWrite, result.method);
+    EXPECT_EQ(data, read_file("first"));
+    EXPECT_EQ(data, read_file("second"));
+}
+
+TEST_F(FileCopyTest, AFailedOutputIsDroppedAndTheOthersCarryOn)
+{
+    auto data = make_data(1'000'000);
+    auto* saved_handler = signal(SIGPIPE, SIG_IGN);
+
+    int in_fds[2];
+    int closed_fds[2];
+    ASSERT_EQ(0, pipe2(in_fds, O_CLOEXEC));
+    ASSERT_EQ(0, pipe2(closed_fds, O_CLOEXEC));
+    close(closed_fds[0]);
+    auto out_fd = open(path("out").c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0666);
+
+    auto writer = feed(in_fds[1], data);
+    auto result = copy_data(in_fds[0], std::array { closed_fds[1], out_fd });
+    writer.join();
+    close(in_fds[0]);
+    close(closed_fds[1]);
+    close(out_fd);
+    signal(SIGPIPE, saved_handler);
+
+    EXPECT_EQ((std::vector { EPIPE, 0 }), result.write_errors);
+    EXPECT_EQ(data, read_file("out"));
+}
+
+} // namespace RatShell
@@ -0,0 +1,121 @@
+#include "TemporaryDirectory.h"
+#include <ForkServer.h>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace RatShell {
+
+namespace {
+
+class ForkServerTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_FALSE(directory().empty());
+        m_socket_path = (directory() / "socket").string();
+
+        m_server = fork();
+        ASSERT_LE(0, m_server);
+        if (m_server == 0)
+            _exit(run_fork_server(m_socket_path));
+
+        for (int i = 0; i < 500 && !std::filesystem::exists(m_socket_path); i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds { 10 });
+    }
+
+    void TearDown() override
+    {
+        kill(m_server, SIGKILL);
+        waitpid(m_server, nullptr, 0);
+    }
+
+    std::filesystem::path const& directory() const { return m_directory.path(); }
+    std::string const& socket_path() const { return m_socket_path; }
+
+    std::string read_file(std::string const& name) const
+    {
+        std::ifstream file { directory() / name };
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+private:
+    TemporaryDirectory m_directory { "fork-server" };
+    std::string m_socket_path;
+    pid_t m_server { -1 };
+};
+
+} // namespace
+
+TEST_F(ForkServerTest, RunsWithTheClientsArgumentsAndEnvironment)
+{
+    auto out = (directory() / "out").string();
+    auto script = "echo $0 $1 $RATSH_TEST_VALUE >" + out + "; exit 5";
+    char const* arguments[] { script.c_str(), "name", "argument" };
+
+    // The environment is sent as it is when the client runs.
+    setenv("RATSH_TEST_VALUE", "from the client", 1);
+    auto rc = run_fork_client(socket_path(), arguments);
+    unsetenv("RATSH_TEST_VALUE");
+
+    ASSERT_TRUE(rc.has_value());
+    EXPECT_EQ(5, rc.value());
+    EXPECT_EQ("name argument from the client\n", read_file("out"));
+}
+
+TEST_F(ForkServerTest, ReportsSignalsLikeTheShellDoes)
+{
+    char const* arguments[] { "kill -TERM $$" };
+    EXPECT_EQ(128 + SIGTERM, run_fork_client(socket_path(), arguments));
+}
+
+TEST_F(ForkServerTest, NothingIsRunWithoutAServer)
+{
+    char const* arguments[] { "true" };
+    EXPECT_FALSE(run_fork_client((directory() / "missing").string(), arguments).has_value());
+}
+
+
+TEST_F(ForkServerTest, OnlyItsUserMayConnect)
+{
+    struct stat st {};
+    ASSERT_EQ(0, stat(socket_path().c_str(), &st));
+    EXPECT_EQ(0600u, st.st_mode & 07777);
+
+    // Even with the socket opened up to everyone, someone else's requests aren't run.
+    if (geteuid() != 0)
+        GTEST_SKIP() << "another user is needed";
+    ASSERT_EQ(0, chmod(directory().c_str(), 0755));
+    ASSERT_EQ(0, chmod(socket_path().c_str(), 0666));
+
+    auto out = (directory() / "out").string();
+    auto script = "echo ran >" + out;
+    auto client = fork();
+    ASSERT_LE(0, client);
+    if (client == 0) {
+        if (setuid(65534) < 0)
+            _exit(100);
+        char const* arguments[] { script.c_str() };
+        _exit(run_fork_client(socket_path(), arguments).value_or(100));
+    }
+
+    int status = 0;
+    waitpid(client, &status, 0);
+    // The client finds the connection closed on it.
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(1, WEXITSTATUS(status));
+    EXPECT_FALSE(std::filesystem::exists(out));
+}
+
+} // namespace RatShell
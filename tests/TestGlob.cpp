@@ -0,0 +1,128 @@
+#include "TemporaryDirectory.h"
+#include <Glob.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace RatShell {
+
+class GlobTest : public ::testing::Test {
+protected:
+    virtual void SetUp()
+    {
+        m_root = m_directory.path();
+        ASSERT_FALSE(m_root.empty());
+
+        for (auto const* dir : { "src", "src/lib", "src/lib/deep", ".hidden" })
+            std::filesystem::create_directory(m_root / dir);
+        for (auto const* file : { "a.o", "b.o", "c.txt", ".dot.o", "src/main.o", "src/lib/util.o", "src/lib/deep/x.o", ".hidden/h.o" })
+            close(open((m_root / file).c_str(), O_CREAT | O_WRONLY, 0644));
+
+        m_old_cwd = std::filesystem::current_path();
+        std::filesystem::current_path(m_root);
+    }
+
+    virtual void TearDown()
+    {
+        std::filesystem::current_path(m_old_cwd);
+    }
+
+    TemporaryDirectory m_directory { "glob" };
+    std::filesystem::path m_root;
+    std::filesystem::path m_old_cwd;
+    Glob m_glob;
+};
+
+TEST(GlobPattern, MatchesWildcards)
+{
+    ASSERT_TRUE(GlobPattern::compile("*.o").matches("main.o"));
+    ASSERT_FALSE(GlobPattern::compile("*.o").matches("main.c"));
+    ASSERT_TRUE(GlobPattern::compile("ma?n.*").matches("main.o"));
+    ASSERT_TRUE(GlobPattern::compile("*a*b*c").matches("xaxxbxxxc"));
+    ASSERT_FALSE(GlobPattern::compile("*a*b*c").matches("xaxxcxxxb"));
+    ASSERT_TRUE(GlobPattern::compile("lib*").matches("libfoo"));
+}
+
+TEST(GlobPattern, MatchesBracketExpressions)
+{
+    ASSERT_TRUE(GlobPattern::compile("[abc].o").matches("b.o"));
+    ASSERT_FALSE(GlobPattern::compile("[!abc].o").matches("b.o"));
+    ASSERT_TRUE(GlobPattern::compile("[a-z][0-9]").matches("q7"));
+    ASSERT_TRUE(GlobPattern::compile("[[:upper:]]*").matches("Makefile"));
+    ASSERT_FALSE(GlobPattern::compile("[[:upper:]]*").matches("makefile"));
+    ASSERT_TRUE(GlobPattern::compile("[]]").matches("]"));
+
+    // An unterminated bracket is an ordinary character.
+    ASSERT_TRUE(GlobPattern::compile("[ab").matches("[ab"));
+}
+
+TEST(GlobPattern, LeadingPeriodMustBeExplicit)
+{
+    ASSERT_FALSE(GlobPattern::compile("*").matches(".profile"));
+    ASSERT_FALSE(GlobPattern::compile("?profile").matches(".profile"));
+    ASSERT_TRUE(GlobPattern::compile(".*").matches(".profile"));
+}
+
+TEST(GlobPattern, EscapedCharactersAreLiteral)
+{
+    ASSERT_FALSE(GlobPattern::has_magic("\\*.o"));
+    ASSERT_TRUE(GlobPattern::compile("\\*.o").matches("*.o"));
+    ASSERT_FALSE(GlobPattern::compile("\\*.o").matches("a.o"));
+}
+
+TEST_F(GlobTest, ExpandsAndSortsMatches)
+{
+    auto paths = m_glob.expand("*.o", {});
+    ASSERT_EQ((std::vector<std::string> { "a.o", "b.o" }), paths);
+
+    paths = m_glob.expand("src/*/*.o", {});
+    ASSERT_EQ((std::vector<std::string> { "src/lib/util.o" }), paths);
+
+    paths = m_glob.expand("*/", {});
+    ASSERT_EQ((std::vector<std::string> { "src/" }), paths);
+
+    ASSERT_TRUE(m_glob.expand("*.c", {}).empty());
+    ASSERT_TRUE(m_glob.expand("*/missing", {}).empty());
+}
+
+TEST_F(GlobTest, ExpandsRecursivelyWithGlobstar)
+{
+    auto paths = m_glob.expand("**/*.o", { .globstar = true });
+    ASSERT_EQ((std::vector<std::string> { "a.o", "b.o", "src/lib/deep/x.o", "src/lib/util.o", "src/main.o" }), paths);
+
+    // Without globstar, "**" behaves just like "*".
+    paths = m_glob.expand("**/*.o", {});
+    ASSERT_EQ((std::vector<std::string> { "src/main.o" }), paths);
+}
+
+TEST_F(GlobTest, GlobstarStillWorksAfterAFork)
+{
+    auto paths = m_glob.expand("**/*.o", { .globstar = true });
+    ASSERT_EQ(5u, paths.size());
+
+    // The child inherits the pool the walk used, but not its threads.
+    auto pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        alarm(10);
+        _exit(m_glob.expand("**/*.o", { .globstar = true }) == paths ? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+}
+
+TEST_F(GlobTest, CachedListingsStayValid)
+{
+    ASSERT_EQ(2u, m_glob.expand("*.o", {}).size());
+    close(open((m_root / "d.o").c_str(), O_CREAT | O_WRONLY, 0644));
+    ASSERT_EQ(3u, m_glob.expand("*.o", {}).size());
+}
+
+} // namespace RatShell
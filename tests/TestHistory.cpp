@@ -0,0 +1,148 @@
+#include "TemporaryDirectory.h"
+#include <History.h>
+#include <cstdint>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+class HistoryTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_FALSE(m_directory.path().empty());
+    }
+
+    std::string path() const { return (m_directory.path() / "history").string(); }
+
+    std::vector<std::string> entries(History& history)
+    {
+        history.refresh();
+        std::vector<std::string> result;
+        for (size_t i = 0; i < history.size(); i++)
+            result.push_back(history.entry(i));
+        return result;
+    }
+
+private:
+    TemporaryDirectory m_directory { "history" };
+};
+
+} // namespace
+
+TEST_F(HistoryTest, EntriesSurviveReopening)
+{
+    {
+        auto history = History::open(path(), 0);
+        ASSERT_TRUE(history.has_value());
+        EXPECT_TRUE(history->append("echo one"));
+        EXPECT_TRUE(history->append("echo one"));
+        EXPECT_TRUE(history->append("   "));
+        EXPECT_TRUE(history->append("printf 'a\\\\b\nc'"));
+    }
+
+    auto history = History::open(path(), 0);
+    ASSERT_TRUE(history.has_value());
+    EXPECT_EQ((std::vector<std::string> { "echo one", "printf 'a\\\\b\nc'" }), entries(*history));
+}
+
+TEST_F(HistoryTest, SessionsSeeEachOthersEntries)
+{
+    auto first = History::open(path(), 0);
+    auto second = History::open(path(), 0);
+    ASSERT_TRUE(first.has_value());
+    ASSERT_TRUE(second.has_value());
+
+    first->append("ls");
+    second->append("pwd");
+    first->append("cd /tmp");
+
+    EXPECT_EQ((std::vector<std::string> { "ls", "pwd", "cd /tmp" }), entries(*second));
+}
+
+TEST_F(HistoryTest, ConcurrentAppendsKeepWholeEntries)
+{
+    constexpr int session_count = 4;
+    constexpr int entry_count = 500;
+
+    std::vector<std::thread> sessions;
+    for (int session = 0; session < session_count; session++) {
+        sessions.emplace_back([this, session] {
+            auto history = History::open(path(), 0);
+            ASSERT_TRUE(history.has_value());
+            for (int i = 0; i < entry_count; i++)
+                history->append("session " + std::to_string(session) + " entry " + std::to_string(i));
+        });
+    }
+    for (auto& session : sessions)
+        session.join();
+
+    auto history = History::open(path(), 0);
+    ASSERT_TRUE(history.has_value());
+    auto all = entries(*history);
+    ASSERT_EQ(session_count * entry_count, all.size());
+    for (auto const& entry : all)
+        EXPECT_TRUE(entry.starts_with("session ")) << entry;
+}
+
+TEST_F(HistoryTest, SearchFindsTheLatestMatchFirst)
+{
+    auto history = History::open(path(), 0);
+    ASSERT_TRUE(history.has_value());
+    for (auto const* entry : { "make -j8", "ssh host1", "git status", "ssh host2", "make test", "ls" })
+        history->append(entry);
+
+    EXPECT_EQ(3, history->search_backward("ssh", SIZE_MAX));
+    EXPECT_EQ(1, history->search_backward("ssh", 3));
+    EXPECT_EQ(std::nullopt, history->search_backward("ssh", 1));
+    EXPECT_EQ(std::nullopt, history->search_backward("rsync", SIZE_MAX));
+    // Too short for the trigrams, so every entry is looked at.
+    EXPECT_EQ(5, history->search_backward("s", SIZE_MAX));
+    EXPECT_EQ(2, history->search_backward("t st", SIZE_MAX));
+}
+
+TEST_F(HistoryTest, PrefixesGiveDistinctEntries)
+{
+    auto history = History::open(path(), 0);
+    ASSERT_TRUE(history.has_value());
+    for (auto const* entry : { "make", "make test", "cmake .", "make", "ls", "make test" })
+        history->append(entry);
+
+    EXPECT_EQ((std::vector<size_t> { 5, 3 }), history->with_prefix("make", SIZE_MAX));
+    EXPECT_EQ((std::vector<size_t> { 5 }), history->with_prefix("ma", 1));
+    EXPECT_EQ((std::vector<size_t> { 2 }), history->with_prefix("c", SIZE_MAX));
+    EXPECT_EQ(4, history->with_prefix("", SIZE_MAX).size());
+
+    // Entries appended after the index was built are found too.
+    history->append("mandb");
+    EXPECT_EQ((std::vector<size_t> { 6 }), history->with_prefix("man", SIZE_MAX));
+}
+
+TEST_F(HistoryTest, CompactionKeepsTheLatestDistinctEntries)
+{
+    auto history = History::open(path(), 4);
+    auto other = History::open(path(), 0);
+    ASSERT_TRUE(history.has_value());
+    ASSERT_TRUE(other.has_value());
+
+    for (auto const* entry : { "a", "b", "a", "c", "d" })
+        history->append(entry);
+    EXPECT_EQ(5, history->size());
+
+    // Going over the cap by more than a quarter compacts the file.
+    history->append("e");
+    EXPECT_EQ((std::vector<std::string> { "a", "c", "d", "e" }), entries(*history));
+
+    // The other session moves on to the new file.
+    other->append("f");
+    EXPECT_EQ((std::vector<std::string> { "a", "c", "d", "e", "f" }), entries(*other));
+    EXPECT_EQ((std::vector<std::string> { "a", "c", "d", "e", "f" }), entries(*history));
+    EXPECT_EQ(std::nullopt, other->search_backward("b", SIZE_MAX));
+}
+
+} // namespace RatShell
@@ -1,5 +1,6 @@
 #include <Lexer.h>
 #include <gtest/gtest.h>
+#include <vector>
 
 namespace RatShell {
 
@@ -58,4 +59,64 @@ TEST(Lexer, BatchNextShouldNotCreateIoNumbers)
     ASSERT_EQ("30", batched_tokens[0].value);
 }
 
-} // namespace RatShell
\ No newline at end of file
+TEST(Lexer, BatchNextKeepsExpansionsInOneToken)
+{
+    auto lexer = Lexer { "$(echo a | tr a b)x " };
+    auto batched_tokens = lexer.batch_next();
+    ASSERT_EQ(1, batched_tokens.size());
+    ASSERT_EQ(Token::Type::Token, batched_tokens[0].type);
+    ASSERT_EQ("$(echo a | tr a b)x", batched_tokens[0].value);
+
+    lexer = Lexer { "$(echo $(echo ')') \")\")>" };
+    batched_tokens = lexer.batch_next();
+    ASSERT_EQ(1, batched_tokens.size());
+    ASSERT_EQ("$(echo $(echo ')') \")\")", batched_tokens[0].value);
+}
+
+TEST(Lexer, BatchNextKeepsDoubleQuotedStringsInOneToken)
+{
+    auto lexer = Lexer { "\"a | b $(echo \"c\")\" " };
+    auto batched_tokens = lexer.batch_next();
+    ASSERT_EQ(1, batched_tokens.size());
+    ASSERT_EQ(Token::Type::Token, batched_tokens[0].type);
+    ASSERT_EQ("\"a | b $(echo \"c\")\"", batched_tokens[0].value);
+}
+
+TEST(Lexer, BatchNextOnlyStartsCommentsAtTokenBoundaries)
+{
+    auto lexer = Lexer { "$# a#b # comment" };
+    auto batched_tokens = lexer.batch_next();
+    ASSERT_EQ(1, batched_tokens.size());
+    ASSERT_EQ("$#", batched_tokens[0].value);
+
+    batched_tokens = lexer.batch_next();
+    ASSERT_EQ(1, batched_tokens.size());
+    ASSERT_EQ("a#b", batched_tokens[0].value);
+
+    batched_tokens = lexer.batch_next();
+    ASSERT_EQ(1, batched_tokens.size());
+    ASSERT_EQ(Token::Type::Eof, batched_tokens[0].type);
+}
+
+TEST(Lexer, BatchNextRecognizesProcessSubstitutions)
+{
+    auto lexer = Lexer { "<(a) >(b) 2<(c)" };
+    std::vector<Token::Type> types;
+    while (true) {
+        auto batched_tokens = lexer.batch_next();
+        if (batched_tokens.empty())
+            break;
+        for (auto const& token : batched_tokens)
+            types.push_back(token.type);
+    }
+
+    // The digits before a process substitution aren't an IO_NUMBER.
+    ASSERT_EQ((std::vector<Token::Type> {
+                  Token::Type::LessParen, Token::Type::Token, Token::Type::CloseParen,
+                  Token::Type::GreatParen, Token::Type::Token, Token::Type::CloseParen,
+                  Token::Type::Token, Token::Type::LessParen, Token::Type::Token, Token::Type::CloseParen,
+                  Token::Type::Eof }),
+        types);
+}
+
+} // namespace RatShell
@@ -0,0 +1,186 @@
+#include "TemporaryDirectory.h"
+#include <LineReader.h>
+#include <Shell.h>
+#include <fcntl.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+class LineReaderTest : public ::testing::Test {
+protected:
+    void SetUp() override
+    {
+        ASSERT_FALSE(m_directory.path().empty());
+    }
+
+    // Opens a regular file with the contents, which read takes in blocks.
+    int open_file(std::string const& contents)
+    {
+        auto path = m_directory.path() / ("input" + std::to_string(m_files++));
+        std::ofstream { path } << contents;
+        return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+
+    // Opens a pipe with the contents written to it, which read takes a byte at a time.
+    static int open_pipe(std::string const& contents)
+    {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) < 0)
+            return -1;
+        if (write(fds[1], contents.data(), contents.size()) != static_cast<ssize_t>(contents.size()))
+            return -1;
+        close(fds[1]);
+        return fds[0];
+    }
+
+    static std::string read_rest(int fd)
+    {
+        std::string rest;
+        char buffer[256];
+        ssize_t nread;
+        while ((nread = read(fd, buffer, sizeof(buffer))) > 0)
+            rest.append(buffer, nread);
+        return rest;
+    }
+
+    std::string path(std::string const& name) const { return m_directory.path() / name; }
+
+private:
+    TemporaryDirectory m_directory { "line-reader" };
+    int m_files { 0 };
+};
+
+ReadLine line_of(std::string text, std::vector<size_t> escaped = {})
+{
+    return { .text = std::move(text), .escaped = std::move(escaped), .found_delimiter = true };
+}
+
+} // namespace
+
+TEST_F(LineReaderTest, BackslashNewlineJoinsLinesUnlessRaw)
+{
+    for (auto fd : { open_file("one \\\ntwo\\ three\nnext\n"), open_pipe("one \\\ntwo\\ three\nnext\n") }) {
+        ASSERT_GE(fd, 0);
+        auto line = read_line(fd, '\n', false);
+        ASSERT_TRUE(line.has_value());
+        EXPECT_EQ("one two three", line->text);
+        EXPECT_EQ(std::vector<size_t> { 7 }, line->escaped);
+        EXPECT_TRUE(line->found_delimiter);
+        close(fd);
+    }
+
+    auto fd = open_file("one \\\ntwo\\ three\n");
+    auto line = read_line(fd, '\n', true);
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ("one \\", line->text);
+    EXPECT_TRUE(line->escaped.empty());
+    close(fd);
+}
+
+TEST_F(LineReaderTest, OtherDelimitersAreKeptWhenEscaped)
+{
+    auto fd = open_pipe("a\\,b,c");
+    auto line = read_line(fd, ',', false);
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ("a,b", line->text);
+    EXPECT_EQ(std::vector<size_t> { 1 }, line->escaped);
+
+    // The rest ends at the end of the input instead of a delimiter.
+    line = read_line(fd, ',', false);
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ("c", line->text);
+    EXPECT_FALSE(line->found_delimiter);
+    close(fd);
+
+    fd = open_file(std::string { "first\0second", 12 });
+    line = read_line(fd, '\0', true);
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ("first", line->text);
+    close(fd);
+}
+
+TEST_F(LineReaderTest, APartialLineAtTheEndIsStillRead)
+{
+    auto fd = open_file("partial");
+    auto line = read_line(fd, '\n', false);
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ("partial", line->text);
+    EXPECT_FALSE(line->found_delimiter);
+
+    // A backslash just before the end of the input continues nothing.
+    close(fd);
+    fd = open_file("partial\\");
+    line = read_line(fd, '\n', false);
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ("partial", line->text);
+    EXPECT_FALSE(line->found_delimiter);
+    close(fd);
+}
+
+TEST_F(LineReaderTest, TheRestOfAFileIsLeftForWhateverReadsItNext)
+{
+    std::string contents = "first\n" + std::string(2000, 'x') + "\nthird\n";
+    auto fd = open_file(contents);
+    auto line = read_line(fd, '\n', false);
+    ASSERT_TRUE(line.has_value());
+    EXPECT_EQ("first", line->text);
+    EXPECT_EQ(contents.substr(6), read_rest(fd));
+    close(fd);
+
+    std::ofstream { path("script-input") } << "first line\nsecond line\nthird line\n";
+    Shell shell;
+    testing::internal::CaptureStdout();
+    auto rc = shell.run_single_line("{ read a; cat; } < " + path("script-input") + "\n");
+    auto output = testing::internal::GetCapturedStdout();
+    EXPECT_EQ(0, rc);
+    EXPECT_EQ("second line\nthird line\n", output);
+}
+
+TEST(LineReader, SplitsOnIfsWhiteSpace)
+{
+    EXPECT_EQ((std::vector<std::string> { "a", "b" }), split_line(line_of("  a \t b  "), " \t\n", 2));
+    // The last field gets the rest of the line, without the IFS white space around it.
+    EXPECT_EQ((std::vector<std::string> { "a", "b  c d" }), split_line(line_of(" a b  c d "), " \t\n", 2));
+    // Fields that aren't there are empty.
+    EXPECT_EQ((std::vector<std::string> { "a", "", "" }), split_line(line_of("a"), " \t\n", 3));
+    EXPECT_EQ((std::vector<std::string> { " a b " }), split_line(line_of(" a b "), "", 1));
+}
+
+TEST(LineReader, OtherIfsCharactersDelimitEmptyFields)
+{
+    EXPECT_EQ((std::vector<std::string> { "a", "", "b" }), split_line(line_of("a,,b"), ",", 3));
+    EXPECT_EQ((std::vector<std::string> { "a", "", "b" }), split_line(line_of("a , , b"), ", ", 3));
+    EXPECT_EQ((std::vector<std::string> { "", "a" }), split_line(line_of(",a"), ",", 2));
+    EXPECT_EQ((std::vector<std::string> { "a", "b,c" }), split_line(line_of("a,b,c"), ",", 2));
+}
+
+TEST(LineReader, EscapedCharactersDontSplit)
+{
+    // As read from "a\ b c" and "a\,b,c".
+    EXPECT_EQ((std::vector<std::string> { "a b", "c" }), split_line(line_of("a b c", { 1 }), " \t\n", 2));
+    EXPECT_EQ((std::vector<std::string> { "a,b", "c" }), split_line(line_of("a,b,c", { 1 }), ",", 2));
+}
+
+TEST_F(LineReaderTest, ReadAssignsTheFieldsAndFailsAtTheEnd)
+{
+    std::ofstream { path("fields") } << "1,,3\\4,5\n";
+    std::ofstream { path("partial") } << "partial";
+
+    Shell shell;
+    EXPECT_EQ(0, shell.run_single_line("IFS=, read -r a b c < " + path("fields") + "\n"));
+    EXPECT_EQ("1", shell.variables().find("a")->value);
+    EXPECT_EQ("", shell.variables().find("b")->value);
+    EXPECT_EQ("3\\4,5", shell.variables().find("c")->value);
+
+    // What was read before the end of the input is still assigned.
+    EXPECT_EQ(1, shell.run_single_line("read x < " + path("partial") + "\n"));
+    EXPECT_EQ("partial", shell.variables().find("x")->value);
+}
+
+} // namespace RatShell
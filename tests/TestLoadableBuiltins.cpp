@@ -0,0 +1,105 @@
+#include <Builtins.h>
+#include <LoadableBuiltins.h>
+#include <Shell.h>
+#include <cstdlib>
+#include <dlfcn.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace RatShell {
+
+namespace {
+
+// Whether the shared object is still open, without opening it otherwise.
+bool is_open(char const* path)
+{
+    auto* handle = dlopen(path, RTLD_NOW | RTLD_NOLOAD);
+    if (handle == nullptr)
+        return false;
+    dlclose(handle);
+    return true;
+}
+
+std::string value_of(Shell& shell, std::string const& name)
+{
+    auto const* variable = shell.variables().find(name);
+    return variable != nullptr ? variable->value : "(unset)";
+}
+
+} // namespace
+
+TEST(LoadableBuiltins, LoadedBuiltinsRunLikeAnyOther)
+{
+    char path_template[] = "/tmp/ratsh-kvget-XXXXXX";
+    auto fd = mkstemp(path_template);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    std::ofstream { path_template } << "host=example.org\nport=8080\nportal=no\n";
+
+    Shell shell;
+    EXPECT_EQ(0, shell.run_single_line(std::string { "enable -f " } + EXAMPLE_BUILTINS_PATH + " kvget counter\n"));
+    ASSERT_NE(nullptr, find_builtin("kvget"));
+    ASSERT_NE(nullptr, find_builtin("counter"));
+
+    EXPECT_EQ(0, shell.run_single_line(std::string { "kvget " } + path_template + " port\n"));
+    EXPECT_EQ("8080", value_of(shell, "port"));
+    EXPECT_EQ(0, shell.run_single_line(std::string { "kvget " } + path_template + " host server\n"));
+    EXPECT_EQ("example.org", value_of(shell, "server"));
+    EXPECT_EQ(1, shell.run_single_line(std::string { "kvget " } + path_template + " user\n"));
+
+    EXPECT_EQ(0, shell.run_single_line("counter hits; counter hits; counter hits 40\n"));
+    EXPECT_EQ("42", value_of(shell, "hits"));
+
+    // A name that's already taken is refused, along with the rest of the command.
+    EXPECT_EQ(1, shell.run_single_line(std::string { "enable -f " } + EXAMPLE_BUILTINS_PATH + " counter\n"));
+    EXPECT_EQ(1, shell.run_single_line(std::string { "enable -f " } + EXAMPLE_BUILTINS_PATH + " echo\n"));
+
+    EXPECT_EQ(0, shell.run_single_line("enable -d kvget counter\n"));
+    std::filesystem::remove(path_template);
+}
+
+TEST(LoadableBuiltins, TheObjectIsClosedWithItsLastBuiltin)
+{
+    std::vector<std::string> names { "kvget", "counter" };
+    ASSERT_EQ(std::nullopt, load_builtins(EXAMPLE_BUILTINS_PATH, names));
+    EXPECT_TRUE(is_open(EXAMPLE_BUILTINS_PATH));
+
+    EXPECT_TRUE(unload_builtin("kvget"));
+    EXPECT_EQ(nullptr, find_builtin("kvget"));
+    EXPECT_NE(nullptr, find_builtin("counter"));
+    EXPECT_TRUE(is_open(EXAMPLE_BUILTINS_PATH));
+
+    EXPECT_TRUE(unload_builtin("counter"));
+    EXPECT_EQ(nullptr, find_builtin("counter"));
+    EXPECT_FALSE(is_open(EXAMPLE_BUILTINS_PATH));
+
+    // Only loaded builtins can be removed.
+    EXPECT_FALSE(unload_builtin("counter"));
+    EXPECT_FALSE(unload_builtin("echo"));
+    EXPECT_NE(nullptr, find_builtin("echo"));
+}
+
+TEST(LoadableBuiltins, NothingIsLoadedOnAnError)
+{
+    std::vector<std::string> names { "mismatched" };
+    auto error = load_builtins(MISMATCHED_BUILTINS_PATH, names);
+    ASSERT_TRUE(error.has_value());
+    EXPECT_NE(std::string::npos, error->find("ABI version")) << error.value();
+    EXPECT_EQ(nullptr, find_builtin("mismatched"));
+    EXPECT_FALSE(is_open(MISMATCHED_BUILTINS_PATH));
+
+    names = { "kvget", "missing" };
+    error = load_builtins(EXAMPLE_BUILTINS_PATH, names);
+    ASSERT_TRUE(error.has_value());
+    EXPECT_NE(std::string::npos, error->find("missing")) << error.value();
+    EXPECT_EQ(nullptr, find_builtin("kvget"));
+    EXPECT_FALSE(is_open(EXAMPLE_BUILTINS_PATH));
+
+    names = { "kvget" };
+    EXPECT_TRUE(load_builtins("/nonexistent/libnothing.so", names).has_value());
+}
+
+} // namespace RatShell
@@ -0,0 +1,275 @@
+#include <AST.h>
+#include <Parser.h>
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <memory>
+#include <new>
+#include <pthread.h>
+#include <string>
+
+namespace {
+
+// What the current thread has allocated, which unlike time is the same on every run.
+thread_local size_t allocation_count = 0;
+thread_local size_t allocated_bytes = 0;
+
+} // namespace
+
+void* operator new(size_t size)
+{
+    allocation_count++;
+    allocated_bytes += size;
+    if (auto* pointer = std::malloc(size == 0 ? 1 : size))
+        return pointer;
+    throw std::bad_alloc {};
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace RatShell {
+
+namespace {
+
+struct Allocations {
+    size_t count { 0 };
+    size_t bytes { 0 };
+};
+
+// Runs the function on a thread with a small stack, so that any recursion on the length of
+// its input overflows it.
+template<typename Function>
+void run_with_small_stack(Function function)
+{
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, 256 * 1024);
+
+    pthread_t thread;
+    auto start = [](void* argument) -> void* {
+        (*static_cast<Function*>(argument))();
+        return nullptr;
+    };
+    ASSERT_EQ(0, pthread_create(&thread, &attributes, start, &function));
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attributes);
+}
+
+// Parses, evaluates and destroys an and-or list of the given number of commands, the first
+// half of which are the stages of a single pipeline, and returns what that allocated.
+Allocations parse_chain(size_t length)
+{
+    auto stages = length / 2;
+    std::string input = "a";
+    for (size_t i = 1; i < length; i++)
+        input += i < stages ? " | a" : " && a";
+
+    Allocations allocations;
+    run_with_small_stack([&] {
+        allocation_count = 0;
+        allocated_bytes = 0;
+        {
+            auto parser = Parser { input };
+            auto node = parser.parse();
+            ASSERT_NE(nullptr, node);
+            ASSERT_EQ(AST::Node::Kind::AndOrIf, node->kind());
+
+            auto value = node->eval();
+            ASSERT_TRUE(value->is_and_or_list());
+            auto const& commands = std::static_pointer_cast<AndOrListValue>(value)->commands;
+            ASSERT_EQ(length - stages + 1, commands.size());
+
+            size_t count = 0;
+            for (auto* command = commands.front().get(); command; command = command->next_in_pipeline.get())
+                count++;
+            ASSERT_EQ(stages, count);
+        }
+        allocations = { allocation_count, allocated_bytes };
+    });
+    return allocations;
+}
+
+} // namespace
+
+TEST(Parser, ParseListOfCommands)
+{
+    auto parser = Parser { "echo a; echo b\necho c\n" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_EQ(AST::Node::Kind::List, node->kind());
+
+    auto list = std::static_pointer_cast<AST::List>(node);
+    ASSERT_EQ(3, list->nodes().size());
+}
+
+TEST(Parser, ParseSubshellWithRedirections)
+{
+    auto parser = Parser { "(cd dir && make) > log 2>&1" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_EQ(AST::Node::Kind::CompoundCommand, node->kind());
+
+    auto command = std::static_pointer_cast<AST::CompoundCommand>(node);
+    ASSERT_EQ(AST::Node::Kind::Subshell, command->body()->kind());
+    ASSERT_EQ(2, command->redirections().size());
+
+    auto subshell = std::static_pointer_cast<AST::Subshell>(command->body());
+    ASSERT_EQ(AST::Node::Kind::AndOrIf, subshell->body()->kind());
+}
+
+TEST(Parser, ParseUnterminatedSubshell)
+{
+    auto parser = Parser { "(echo a" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_TRUE(node->is_syntax_error());
+
+    parser = Parser { "echo a )" };
+    node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_TRUE(node->is_syntax_error());
+}
+
+TEST(Parser, ParseAssignmentsBeforeCommandName)
+{
+    auto parser = Parser { "A=1 B=2 env C=3" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+
+    auto value = node->eval();
+    ASSERT_TRUE(value->is_command());
+
+    auto command = std::static_pointer_cast<CommandValue>(value);
+    ASSERT_EQ((std::vector<std::string> { "A=1", "B=2" }), command->assignments);
+    ASSERT_EQ((std::vector<std::string> { "env", "C=3" }), command->argv);
+}
+
+TEST(Parser, ParseForLoop)
+{
+    auto parser = Parser { "for i in a \"b c\" $d\ndo\n  echo $i; echo done\ndone > out" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_EQ(AST::Node::Kind::CompoundCommand, node->kind());
+
+    auto command = std::static_pointer_cast<AST::CompoundCommand>(node);
+    ASSERT_EQ(1, command->redirections().size());
+    ASSERT_EQ(AST::Node::Kind::ForLoop, command->body()->kind());
+
+    auto loop = std::static_pointer_cast<AST::ForLoop>(command->body());
+    ASSERT_EQ("i", loop->name());
+    ASSERT_EQ((std::vector<std::string> { "a", "\"b c\"", "$d" }), loop->words());
+    ASSERT_EQ(AST::Node::Kind::List, loop->body()->kind());
+}
+
+TEST(Parser, ParseWhileAndUntilLoops)
+{
+    auto parser = Parser { "while read line; do echo \"$line\"; done < in" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_EQ(AST::Node::Kind::CompoundCommand, node->kind());
+
+    auto command = std::static_pointer_cast<AST::CompoundCommand>(node);
+    ASSERT_EQ(AST::Node::Kind::WhileLoop, command->body()->kind());
+    ASSERT_EQ(AST::WhileLoop::Type::While, std::static_pointer_cast<AST::WhileLoop>(command->body())->type());
+
+    parser = Parser { "until false; do break; done" };
+    node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_EQ(AST::Node::Kind::CompoundCommand, node->kind());
+
+    command = std::static_pointer_cast<AST::CompoundCommand>(node);
+    ASSERT_EQ(AST::WhileLoop::Type::Until, std::static_pointer_cast<AST::WhileLoop>(command->body())->type());
+}
+
+TEST(Parser, ParseMalformedLoops)
+{
+    for (auto const* input : { "for i in a b do echo $i; done", "while true; do echo", "for 1x in a; do :; done", "while; do :; done", "done" }) {
+        auto parser = Parser { input };
+        auto node = parser.parse();
+        ASSERT_NE(nullptr, node) << input;
+        ASSERT_TRUE(node->is_syntax_error()) << input;
+    }
+}
+
+TEST(Parser, ParseFunctionDefinition)
+{
+    auto parser = Parser { "greet()\n{ echo hello \"$1\"; } > out" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_EQ(AST::Node::Kind::FunctionDefinition, node->kind());
+
+    auto definition = std::static_pointer_cast<AST::FunctionDefinition>(node);
+    ASSERT_EQ("greet", definition->name());
+    ASSERT_EQ(AST::Node::Kind::CompoundCommand, definition->body()->kind());
+
+    auto body = std::static_pointer_cast<AST::CompoundCommand>(definition->body());
+    ASSERT_EQ(AST::Node::Kind::BraceGroup, body->body()->kind());
+    ASSERT_EQ(1, body->redirections().size());
+}
+
+TEST(Parser, ParseMalformedFunctionDefinitions)
+{
+    for (auto const* input : { "f() echo a", "f()", "1f() { :; }", "f() { echo a; ", "{ }" }) {
+        auto parser = Parser { input };
+        auto node = parser.parse();
+        ASSERT_NE(nullptr, node) << input;
+        ASSERT_TRUE(node->is_syntax_error()) << input;
+    }
+}
+
+TEST(Parser, ParseProcessSubstitutions)
+{
+    auto parser = Parser { "diff <(sort a) -u >(cat) < <(echo b)" };
+    auto node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_FALSE(node->is_syntax_error());
+
+    auto value = node->eval();
+    ASSERT_TRUE(value->is_command());
+
+    auto command = std::static_pointer_cast<CommandValue>(value);
+    ASSERT_EQ((std::vector<std::string> { "diff", "", "-u", "" }), command->argv);
+    ASSERT_EQ(2, command->process_substitutions.size());
+    EXPECT_EQ(1, command->process_substitutions[0].first);
+    EXPECT_EQ(ProcessSubstitutionValue::Direction::Input, command->process_substitutions[0].second->direction);
+    EXPECT_EQ(3, command->process_substitutions[1].first);
+    EXPECT_EQ(ProcessSubstitutionValue::Direction::Output, command->process_substitutions[1].second->direction);
+
+    ASSERT_EQ(1, command->redirections.size());
+    auto const& data = std::get<RedirectionValue::PathData>(command->redirections[0]->redir_variant);
+    ASSERT_NE(nullptr, data.process_substitution);
+    EXPECT_TRUE(data.process_substitution->body->is_command());
+
+    parser = Parser { "cat <(echo a" };
+    node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_TRUE(node->is_syntax_error());
+
+    parser = Parser { "cat <()" };
+    node = parser.parse();
+    ASSERT_NE(nullptr, node);
+    ASSERT_TRUE(node->is_syntax_error());
+}
+
+TEST(Parser, LongChainsTakeLinearTimeAndConstantStack)
+{
+    // Far more commands than the small stack could hold a frame for each of.
+    auto small = parse_chain(100'000);
+    auto large = parse_chain(1'000'000);
+    ASSERT_FALSE(HasFatalFailure());
+
+    // Ten times the commands should take about ten times the work, where e.g. copying the
+    // commands so far for each one would take a hundred times. The vectors holding them
+    // grow in powers of two, which leaves the bytes less even.
+    EXPECT_LT(large.count, small.count * 11);
+    EXPECT_LT(large.bytes, small.bytes * 15);
+}
+
+} // namespace RatShell
@@ -0,0 +1,56 @@
+#include <Builtins.h>
+#include <Shell.h>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace RatShell {
+
+TEST(PipeSize, ParsesSizes)
+{
+    EXPECT_EQ(65536u, parse_size("65536"));
+    EXPECT_EQ(64u * 1024, parse_size("64K"));
+    EXPECT_EQ(64u * 1024, parse_size("64k"));
+    EXPECT_EQ(1024u * 1024, parse_size("1M"));
+    EXPECT_EQ(2u * 1024 * 1024, parse_size("2m"));
+    EXPECT_EQ(1024u * 1024 * 1024, parse_size("1G"));
+    EXPECT_EQ(0u, parse_size("0"));
+
+    for (auto const* text : { "", "K", "-1", "1x", "1KB", "1.5M", " 1M", "99999999999999999999", "99999999999G" })
+        EXPECT_EQ(std::nullopt, parse_size(text)) << text;
+}
+
+TEST(PipeSize, IsSetWithTheOption)
+{
+    Shell shell;
+    EXPECT_EQ(0, shell.run_single_line("set -o pipesize=64K\n"));
+    EXPECT_EQ(64u * 1024, shell.options().pipe_size);
+    EXPECT_EQ(0, shell.run_single_line("set +o pipesize\n"));
+    EXPECT_EQ(0u, shell.options().pipe_size);
+}
+
+TEST(PipeSize, IsCappedAtTheLargestAllowed)
+{
+    Shell shell;
+    EXPECT_EQ(0, shell.run_single_line("set -o pipesize=1G\n"));
+    EXPECT_EQ(pipe_max_size(), shell.options().pipe_size);
+    EXPECT_LT(pipe_max_size(), 1024u * 1024 * 1024);
+}
+
+TEST(PipeSize, BadSizesAreReported)
+{
+    Shell shell;
+    EXPECT_EQ(0, shell.run_single_line("set -o pipesize=64K\n"));
+
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(2, shell.run_single_line("set -o pipesize=1x\n"));
+    EXPECT_EQ("set: pipesize: invalid size: 1x\n", testing::internal::GetCapturedStderr());
+
+    testing::internal::CaptureStderr();
+    EXPECT_EQ(2, shell.run_single_line("set -o pipesize\n"));
+    EXPECT_EQ("set: pipesize: size required, e.g. pipesize=1M\n", testing::internal::GetCapturedStderr());
+
+    // The size that was set is kept.
+    EXPECT_EQ(64u * 1024, shell.options().pipe_size);
+}
+
+} // namespace RatShell
@@ -0,0 +1,113 @@
+#include <Parser.h>
+#include <Profiler.h>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace RatShell {
+
+using namespace std::chrono_literals;
+
+TEST(Profiler, NestedCommandsAreChargedTheirOwnTime)
+{
+    Profiler profiler;
+    Profiler::Clock::time_point start {};
+
+    // A loop on line 1 whose body, on line 2, runs twice.
+    profiler.enter_command(1, start);
+    profiler.enter_command(2, start + 1ms);
+    profiler.count_fork();
+    profiler.leave_command(start + 4ms);
+    profiler.enter_command(2, start + 4ms);
+    profiler.leave_command(start + 6ms);
+    profiler.leave_command(start + 10ms);
+
+    auto const& lines = profiler.lines();
+    ASSERT_EQ(2, lines.size());
+
+    EXPECT_EQ(1, lines.at(1).calls);
+    EXPECT_EQ(10ms, lines.at(1).total);
+    EXPECT_EQ(5ms, lines.at(1).self);
+    EXPECT_EQ(0, lines.at(1).forks);
+
+    EXPECT_EQ(2, lines.at(2).calls);
+    EXPECT_EQ(5ms, lines.at(2).total);
+    EXPECT_EQ(5ms, lines.at(2).self);
+    EXPECT_EQ(1, lines.at(2).forks);
+}
+
+TEST(Profiler, ChildUsageGoesToTheRunningCommand)
+{
+    Profiler profiler;
+    Profiler::Clock::time_point start {};
+
+    struct rusage usage {};
+    usage.ru_utime.tv_usec = 1500;
+    usage.ru_stime.tv_sec = 1;
+
+    // Nothing is running yet, so this is dropped.
+    profiler.add_child_usage(usage);
+
+    profiler.enter_command(3, start);
+    profiler.add_child_usage(usage);
+    profiler.leave_command(start + 2s);
+
+    EXPECT_EQ(1001500us, profiler.lines().at(3).child_cpu);
+}
+
+TEST(Profiler, FoldedStacksFollowFunctionCalls)
+{
+    Profiler profiler;
+    Profiler::Clock::time_point start {};
+
+    // "f" is called on line 5, and runs the command on line 2.
+    profiler.enter_command(5, start);
+    profiler.enter_function("f");
+    profiler.enter_command(2, start + 1ms);
+    profiler.leave_command(start + 3ms);
+    profiler.leave_function();
+    profiler.leave_command(start + 4ms);
+
+    EXPECT_EQ("main:5 2000\nmain:5;f:2 2000\n", profiler.folded_stacks());
+}
+
+TEST(Profiler, ReportQuotesTheSlowestLinesFirst)
+{
+    Profiler profiler;
+    Profiler::Clock::time_point start {};
+    profiler.set_source("script.sh", "true\n  sleep 1\n");
+
+    profiler.enter_command(1, start);
+    profiler.leave_command(start + 1ms);
+    profiler.enter_command(2, start + 1ms);
+    profiler.leave_command(start + 1s);
+
+    auto report = profiler.report();
+    EXPECT_EQ(0, report.find("# script.sh: "));
+
+    auto sleep = report.find("sleep 1\n");
+    auto truth = report.find("true\n");
+    ASSERT_NE(std::string::npos, sleep);
+    ASSERT_NE(std::string::npos, truth);
+    EXPECT_LT(sleep, truth);
+}
+
+TEST(Profiler, CommandsKnowTheLineTheyStartOn)
+{
+    Parser parser { "echo one\n\nfor i in a\ndo\n  echo \"two\nthree\"\ndone\n" };
+    auto value = parser.parse()->eval();
+    ASSERT_TRUE(value->is_list());
+
+    auto const& items = static_cast<ListValue const&>(*value).items;
+    ASSERT_EQ(2, items.size());
+    EXPECT_EQ(1, static_cast<CommandValue const&>(*items[0]).line);
+
+    auto const& loop = static_cast<CommandValue const&>(*items[1]);
+    EXPECT_EQ(3, loop.line);
+    ASSERT_TRUE(loop.compound->is_for_loop());
+    auto const& body = static_cast<ForLoopValue const&>(*loop.compound).body;
+    ASSERT_TRUE(body->is_command());
+    EXPECT_EQ(5, static_cast<CommandValue const&>(*body).line);
+}
+
+} // namespace RatShell
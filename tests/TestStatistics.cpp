@@ -0,0 +1,59 @@
+#include <Statistics.h>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace RatShell {
+
+TEST(LatencyHistogram, SmallValuesAreExact)
+{
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 10; i++)
+        histogram.record(std::chrono::nanoseconds { i });
+
+    EXPECT_EQ(10, histogram.count());
+    EXPECT_EQ(1, histogram.min());
+    EXPECT_EQ(10, histogram.max());
+    EXPECT_EQ(5, histogram.mean());
+    EXPECT_EQ(5, histogram.percentile(50));
+    EXPECT_EQ(9, histogram.percentile(90));
+    EXPECT_EQ(10, histogram.percentile(100));
+}
+
+TEST(LatencyHistogram, LargeValuesAreKeptToWithinBucketPrecision)
+{
+    LatencyHistogram histogram;
+    for (uint64_t i = 1; i <= 1000; i++)
+        histogram.record(std::chrono::microseconds { i });
+
+    // Each power of two is split into 16 buckets, so a value is off by at most 1/16.
+    for (double percentile : { 50.0, 90.0, 99.0, 99.9 }) {
+        auto expected = static_cast<double>(percentile * 10'000);
+        auto actual = static_cast<double>(histogram.percentile(percentile));
+        EXPECT_GE(actual, expected) << percentile;
+        EXPECT_LE(actual, expected * (1.0 + 1.0 / 16)) << percentile;
+    }
+    EXPECT_EQ(1'000'000, histogram.percentile(100));
+
+    histogram.reset();
+    EXPECT_EQ(0, histogram.count());
+    EXPECT_EQ(0, histogram.percentile(50));
+}
+
+TEST(Statistics, ReportsAsJson)
+{
+    Statistics statistics;
+    statistics.increment(Statistics::Counter::Forks);
+    statistics.increment(Statistics::Counter::BytesLexed, 42);
+    statistics.parse_latency().record(std::chrono::nanoseconds { 7 });
+
+    auto json = statistics.report(Statistics::Format::Json);
+    EXPECT_NE(std::string::npos, json.find("\"forks\":1,"));
+    EXPECT_NE(std::string::npos, json.find("\"bytes_lexed\":42}"));
+    EXPECT_NE(std::string::npos, json.find("\"parse_latency_ns\":{\"count\":1,\"min\":7,"));
+
+    statistics.reset();
+    EXPECT_EQ(0, statistics.get(Statistics::Counter::Forks));
+}
+
+} // namespace RatShell
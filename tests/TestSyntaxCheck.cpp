@@ -0,0 +1,52 @@
+#include "TemporaryDirectory.h"
+#include <SyntaxCheck.h>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace RatShell {
+
+TEST(SyntaxCheck, ReportsTheLineOfTheError)
+{
+    EXPECT_EQ(std::nullopt, check_syntax("for x in a b; do\n    echo $x\ndone\n"));
+    EXPECT_EQ(std::nullopt, check_syntax(""));
+    EXPECT_EQ("2: unexpected token ')'", check_syntax("echo a\necho b )\necho c\n"));
+    // An error at the end of the script is on its last line.
+    EXPECT_EQ("2: missing 'done' to close loop", check_syntax("while true; do\n    echo a\n"));
+}
+
+TEST(SyntaxCheck, ChecksEveryFileInOrder)
+{
+    TemporaryDirectory temporary_directory { "syntax-check" };
+    auto const& directory = temporary_directory.path();
+    ASSERT_FALSE(directory.empty());
+
+    std::vector<std::string> paths;
+    for (int i = 0; i < 64; i++) {
+        paths.push_back((directory / ("script" + std::to_string(i))).string());
+        std::ofstream { paths.back() } << (i % 2 == 0 ? "echo ok\n" : "echo a\n(echo b\n");
+    }
+    std::ofstream { directory / "empty" };
+    paths.push_back((directory / "empty").string());
+
+    std::vector<char const*> arguments;
+    for (auto const& path : paths)
+        arguments.push_back(path.c_str());
+
+    testing::internal::CaptureStderr();
+    auto rc = check_syntax_of_files(arguments, 4);
+    auto output = testing::internal::GetCapturedStderr();
+    auto rc_of_one = check_syntax_of_files(std::span { arguments }.first(1), 0);
+
+    EXPECT_EQ(1, rc);
+    std::string expected;
+    for (int i = 1; i < 64; i += 2)
+        expected += paths[i] + ":2: missing ')' to close subshell\n";
+    EXPECT_EQ(expected, output);
+    EXPECT_EQ(0, rc_of_one);
+}
+
+} // namespace RatShell
@@ -0,0 +1,72 @@
+#include <Builtins.h>
+#include <Shell.h>
+#include <chrono>
+#include <csignal>
+#include <gtest/gtest.h>
+
+namespace RatShell {
+
+using namespace std::chrono_literals;
+
+TEST(Timeout, ParsesDurations)
+{
+    EXPECT_EQ(1500ms, parse_duration("1.5"));
+    EXPECT_EQ(30s, parse_duration("30s"));
+    EXPECT_EQ(2min, parse_duration("2m"));
+    EXPECT_EQ(90min, parse_duration("1.5h"));
+    EXPECT_EQ(24h, parse_duration("1d"));
+    EXPECT_EQ(0s, parse_duration("0"));
+    // A fraction of a nanosecond still has to run out.
+    EXPECT_EQ(1ns, parse_duration("0.0000000001"));
+    EXPECT_EQ(std::chrono::nanoseconds::max(), parse_duration("1e300d"));
+
+    for (auto const* text : { "", "s", "-1", "1x", "1ss", "one", "1 s" })
+        EXPECT_EQ(std::nullopt, parse_duration(text)) << text;
+}
+
+TEST(Timeout, ParsesSignals)
+{
+    EXPECT_EQ(SIGKILL, parse_signal("9"));
+    EXPECT_EQ(SIGKILL, parse_signal("KILL"));
+    EXPECT_EQ(SIGTERM, parse_signal("SIGTERM"));
+
+    for (auto const* text : { "", "0", "65", "SIG", "NOPE", "kill" })
+        EXPECT_EQ(std::nullopt, parse_signal(text)) << text;
+}
+
+TEST(Timeout, BadArgumentsGive125)
+{
+    Shell shell;
+    EXPECT_EQ(125, shell.run_single_line("timeout 1x true\n"));
+    EXPECT_EQ(125, shell.run_single_line("timeout -s NOPE 1 true\n"));
+    EXPECT_EQ(125, shell.run_single_line("timeout -k soon 1 true\n"));
+    EXPECT_EQ(125, shell.run_single_line("timeout 1\n"));
+}
+
+TEST(Timeout, CommandsAreFoundAsUsual)
+{
+    Shell shell;
+    EXPECT_EQ(0, shell.run_single_line("timeout 10 true\n"));
+    EXPECT_EQ(3, shell.run_single_line("timeout 10 sh -c 'exit 3'\n"));
+    EXPECT_EQ(7, shell.run_single_line("seven() { return 7; }; timeout 10 seven\n"));
+    EXPECT_EQ(127, shell.run_single_line("timeout 10 /nonexistent/utility\n"));
+}
+
+TEST(Timeout, ExpiryGives124)
+{
+    Shell shell;
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(124, shell.run_single_line("timeout 0.1 sleep 10\n"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+TEST(Timeout, KillAfterGives137)
+{
+    // The ignored signal stays ignored for the sleep too, so only SIGKILL ends them.
+    Shell shell;
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(128 + SIGKILL, shell.run_single_line("timeout -k 0.1 0.1 sh -c 'trap \"\" TERM; sleep 10'\n"));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+}
+
+} // namespace RatShell
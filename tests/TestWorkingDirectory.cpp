@@ -0,0 +1,46 @@
+#include "TemporaryDirectory.h"
+#include <WorkingDirectory.h>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+
+namespace RatShell {
+
+TEST(WorkingDirectory, CanonicalizeLexically)
+{
+    EXPECT_EQ("/", WorkingDirectory::canonicalize_lexically("/"));
+    EXPECT_EQ("/", WorkingDirectory::canonicalize_lexically("/.."));
+    EXPECT_EQ("/a/c", WorkingDirectory::canonicalize_lexically("/a/./b/../c/"));
+    EXPECT_EQ("/a/b", WorkingDirectory::canonicalize_lexically("//a//b//."));
+    EXPECT_EQ("/b", WorkingDirectory::canonicalize_lexically("/a/../../b"));
+    EXPECT_EQ("/link", WorkingDirectory::canonicalize_lexically("/link/sub/.."));
+}
+
+TEST(WorkingDirectory, OpenKeepsLogicalPathname)
+{
+    TemporaryDirectory temporary_directory { "cwd" };
+    auto const& root = temporary_directory.path();
+    ASSERT_FALSE(root.empty());
+
+    std::filesystem::create_directories(root / "real" / "sub");
+    std::filesystem::create_directory_symlink("real", root / "link");
+
+    auto current = WorkingDirectory::current(std::nullopt);
+    ASSERT_TRUE(current.has_value());
+
+    auto logical = (root / "link" / "sub").string();
+    auto directory = current->open(logical, logical);
+    ASSERT_TRUE(directory.has_value());
+    EXPECT_EQ(logical, directory->path());
+    EXPECT_EQ((root / "real" / "sub").string(), directory->physical_path());
+
+    // Without a logical pathname, the physical one is used.
+    auto parent = directory->open("..", std::nullopt);
+    ASSERT_TRUE(parent.has_value());
+    EXPECT_EQ((root / "real").string(), parent->path());
+
+    EXPECT_FALSE(current->open((root / "missing").string(), std::nullopt).has_value());
+
+}
+
+} // namespace RatShell